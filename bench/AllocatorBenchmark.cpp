@@ -0,0 +1,180 @@
+// Microbenchmark for Allocator<T> under the access pattern of Octree::shape:
+// every task allocates nodes and child blocks, converts pointers to indices,
+// resolves child indices many times (getNodeAt/getChildren/iterateBorder)
+// and frees a fraction of the nodes again (ChildBlock::clear).
+// The legacy allocator (one shared_mutex, linear getIndex) is kept here as a baseline.
+//
+// make bench_allocator && ./bin/allocator_bench [maxThreads] [tasksPerThread]
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "../space/Allocator.hpp"
+
+struct alignas(16) BenchNode {
+    float payload[22];
+    uint id;
+    uint8_t bits;
+};
+
+struct BenchBlock {
+    uint children[8];
+};
+
+std::atomic<uint> benchSink{0};
+
+template <typename T>
+class LegacyAllocator {
+    struct Block {
+        T* data;
+        size_t startIndex;
+    };
+    std::vector<Block> blocks;
+    std::vector<T*> freeList;
+    const size_t blockSize;
+    size_t totalAllocated = 0;
+    mutable std::shared_mutex mutex;
+
+    void allocateBlock() {
+        T* data = static_cast<T*>(std::malloc(blockSize * sizeof(T)));
+        if (!data) throw std::bad_alloc();
+        blocks.push_back({ data, totalAllocated });
+        for (size_t i = 0; i < blockSize; ++i) freeList.push_back(&data[i]);
+        totalAllocated += blockSize;
+    }
+
+public:
+    LegacyAllocator(size_t blockSize) : blockSize(blockSize) {}
+    ~LegacyAllocator() { for (auto &b : blocks) std::free(b.data); }
+
+    T* allocate() {
+        std::unique_lock lock(mutex);
+        if (freeList.empty()) allocateBlock();
+        T* ptr = freeList.back();
+        freeList.pop_back();
+        return ptr;
+    }
+
+    void deallocate(T* ptr) {
+        std::unique_lock lock(mutex);
+        freeList.push_back(ptr);
+    }
+
+    uint getIndex(T* ptr) {
+        std::shared_lock lock(mutex);
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+            if (ptr >= it->data && ptr < it->data + blockSize) {
+                return static_cast<uint>(it->startIndex + (ptr - it->data));
+            }
+        }
+        throw std::runtime_error("Pointer does not belong to allocator");
+    }
+
+    T* getFromIndex(uint index) {
+        if (index == UINT_MAX) return nullptr;
+        std::shared_lock lock(mutex);
+        return blocks[index / blockSize].data + index % blockSize;
+    }
+
+    void getFromIndices(T * nodes[8], uint indices[8]) {
+        std::shared_lock lock(mutex);
+        for (int i = 0; i < 8; ++i) {
+            nodes[i] = indices[i] == UINT_MAX ? NULL : blocks[indices[i] / blockSize].data + indices[i] % blockSize;
+        }
+    }
+};
+
+template <template <typename> class A>
+struct BenchAllocators {
+    A<BenchNode> nodes = A<BenchNode>(131072);
+    A<BenchBlock> children = A<BenchBlock>(131072);
+};
+
+template <template <typename> class A>
+long runTask(BenchAllocators<A> &allocators, int seed) {
+    const int lookupsPerNode = 16;
+    long ops = 0;
+    std::vector<BenchNode*> parents;
+    parents.reserve(512);
+
+    for (int k = 0; k < 512; ++k) {
+        BenchNode * parent = allocators.nodes.allocate();
+        BenchBlock * block = allocators.children.allocate();
+        parent->id = allocators.children.getIndex(block);
+        for (int i = 0; i < 8; ++i) {
+            BenchNode * child = allocators.nodes.allocate();
+            child->bits = (uint8_t) (seed + i);
+            block->children[i] = allocators.nodes.getIndex(child);
+        }
+        ops += 11;
+        parents.push_back(parent);
+    }
+
+    uint8_t checksum = 0;
+    for (int l = 0; l < lookupsPerNode; ++l) {
+        for (BenchNode * parent : parents) {
+            BenchBlock * block = allocators.children.getFromIndex(parent->id);
+            BenchNode * children[8];
+            allocators.nodes.getFromIndices(children, block->children);
+            checksum ^= children[l & 7]->bits;
+            ops += 2;
+        }
+    }
+
+    for (size_t k = 0; k < parents.size(); k += 2) {
+        BenchNode * parent = parents[k];
+        BenchBlock * block = allocators.children.getFromIndex(parent->id);
+        for (int i = 0; i < 8; ++i) {
+            allocators.nodes.deallocate(allocators.nodes.getFromIndex(block->children[i]));
+        }
+        allocators.children.deallocate(block);
+        allocators.nodes.deallocate(parent);
+        ops += 18;
+    }
+    // keep the lookups alive
+    benchSink += checksum;
+    return ops;
+}
+
+template <template <typename> class A>
+double run(int threads, int tasks, long * totalOps) {
+    BenchAllocators<A> allocators;
+    std::vector<std::thread> workers;
+    std::atomic<long> ops{0};
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&allocators, &ops, tasks, t]() {
+            long local = 0;
+            for (int i = 0; i < tasks; ++i) {
+                local += runTask(allocators, t * tasks + i);
+            }
+            ops += local;
+        });
+    }
+    for (std::thread &w : workers) w.join();
+    auto end = std::chrono::steady_clock::now();
+    *totalOps = ops.load();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char ** argv) {
+    int maxThreads = argc > 1 ? std::stoi(argv[1]) : (int) std::thread::hardware_concurrency();
+    int tasks = argc > 2 ? std::stoi(argv[2]) : 64;
+
+    std::printf("{\"benchmark\": \"allocator\", \"tasksPerThread\": %d, \"runs\": [\n", tasks);
+    bool first = true;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        long legacyOps = 0, ops = 0;
+        double legacyMs = run<LegacyAllocator>(threads, tasks, &legacyOps);
+        double ms = run<Allocator>(threads, tasks, &ops);
+        std::printf("%s  {\"threads\": %d, \"legacyMs\": %.3f, \"legacyMops\": %.3f, \"ms\": %.3f, \"mops\": %.3f, \"speedup\": %.2f}",
+            first ? "" : ",\n", threads,
+            legacyMs, legacyOps / legacyMs / 1000.0,
+            ms, ops / ms / 1000.0,
+            legacyMs / ms);
+        first = false;
+        if (threads < maxThreads && threads * 2 > maxThreads) threads = maxThreads / 2;
+    }
+    std::printf("\n]}\n");
+    return 0;
+}
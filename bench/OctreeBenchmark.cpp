@@ -0,0 +1,499 @@
+// Headless benchmark of the octree pipeline, no GL/ImGui required.
+// Checks the FastNoise2 perlin against stb_perlin first (exit code 1 when out of NOISE_TOLERANCE).
+// Reproduces Scene::generate (heightmap + brushes), then times tesselation per chunk,
+// visibility traversal with fixed matrices, a raycast packet, point
+// location one by one against Octree::locate, OctreeFile save/load (also paged), and tesselation
+// and save again after Octree::compact.
+// Every phase is reported as JSON (time, nodes, allocator blocks, peak RSS).
+//
+// make bench && ./bin/bench [--tiles 256] [--iterations 10] [--folder bench_data] [--json bench.json]
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <sys/resource.h>
+#include "../space/space.hpp"
+
+// tools/ depends on GL, so the brushes used by generate() are replaced by constant painters
+class BenchPainter : public TexturePainter {
+	int brush;
+	public:
+	BenchPainter(int brush) : brush(brush) {}
+	int paint(const Vertex &vertex, glm::vec4 translate, glm::vec4 scale) const override {
+		return brush;
+	}
+};
+
+class BenchChangeHandler : public OctreeChangeHandler {
+	public:
+	std::atomic<long> created{0};
+	std::atomic<long> updated{0};
+	std::atomic<long> erased{0};
+	void create(OctreeNode* node) override { ++created; }
+	void update(OctreeNode* node) override { ++updated; }
+	void erase(OctreeNode* node) override { ++erased; }
+};
+
+// Collects the chunk nodes with surface, the same ones the visibility checker hands to Scene::processSpace
+class ChunkCollector : public IteratorHandler {
+	public:
+	std::vector<OctreeNodeData> chunks;
+	void before(const Octree &tree, OctreeNodeData &params) override {}
+	void after(const Octree &tree, OctreeNodeData &params) override {}
+	bool test(const Octree &tree, OctreeNodeData &params) override {
+		if(params.node->isChunk()) {
+			if(params.node->getType() == SpaceType::Surface) {
+				chunks.push_back(params);
+			}
+			return false;
+		}
+		return true;
+	}
+	void getOrder(const Octree &tree, OctreeNodeData &params, uint8_t order[8]) override {
+		for(int i = 0 ; i < 8 ; ++i) {
+			order[i] = i;
+		}
+	}
+};
+
+struct BenchPhase {
+	std::string name;
+	double ms;
+	long nodes;
+	size_t nodeBlocks;
+	size_t childBlocks;
+	size_t payloadBlocks;
+	long peakRssKb;
+	std::vector<std::pair<std::string, double>> extra;
+};
+
+// deque keeps references returned by measure() valid
+static std::deque<BenchPhase> phases;
+
+static long peakRss() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static long countNodes(Octree &tree) {
+	if(tree.root == NULL) {
+		return 0;
+	}
+	long count = 0;
+	std::vector<OctreeNode*> stack;
+	stack.push_back(tree.root);
+	while(!stack.empty()) {
+		OctreeNode * node = stack.back();
+		stack.pop_back();
+		++count;
+		OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+		node->getChildren(*tree.allocator, children);
+		for(int i = 0 ; i < 8 ; ++i) {
+			if(children[i] != NULL) {
+				stack.push_back(children[i]);
+			}
+		}
+	}
+	return count;
+}
+
+template <typename F> static BenchPhase &measure(std::string name, Octree &tree, F &&function) {
+	auto start = std::chrono::steady_clock::now();
+	function();
+	auto end = std::chrono::steady_clock::now();
+	BenchPhase phase;
+	phase.name = name;
+	phase.ms = std::chrono::duration<double, std::milli>(end - start).count();
+	phase.nodes = countNodes(tree);
+	phase.nodeBlocks = tree.allocator->nodeAllocator.getAllocatedBlocksCount();
+	phase.childBlocks = tree.allocator->childAllocator.getAllocatedBlocksCount();
+	phase.payloadBlocks = tree.allocator->payloadAllocator.getAllocatedBlocksCount();
+	phase.peakRssKb = peakRss();
+	phases.push_back(phase);
+	std::cout << "[bench] " << name << " " << phase.ms << "ms nodes=" << phase.nodes << std::endl;
+	return phases.back();
+}
+
+static void generate(Octree &solidSpace, Octree &liquidSpace, Simplifier &simplifier, BenchChangeHandler * handler, int tiles) {
+	int sizePerTile = 30;
+	int height = 2048;
+	float minSize = 30;
+	glm::vec4 translate(0.0f);
+	glm::vec4 scale(1.0f);
+	BoundingBox mapBox = BoundingBox(glm::vec3(-sizePerTile*tiles*0.5,-height*0.5,-sizePerTile*tiles*0.5), glm::vec3(sizePerTile*tiles*0.5,height*0.5,sizePerTile*tiles*0.5));
+
+	measure("add:heightmap", solidSpace, [&]() {
+		Transformation model = Transformation();
+		GradientPerlinSurface heightFunction = GradientPerlinSurface(height, 1.0/(256.0f*sizePerTile), -64);
+		CachedHeightMapSurface cache = CachedHeightMapSurface(heightFunction, mapBox, sizePerTile);
+		HeightMap heightMap = HeightMap(cache, mapBox, sizePerTile);
+		HeightMapDistanceFunction function = HeightMapDistanceFunction(&heightMap);
+		WrappedHeightMap wrappedFunction = WrappedHeightMap(&function);
+		solidSpace.add(&wrappedFunction, model, translate, scale, BenchPainter(0), minSize, simplifier, handler);
+	});
+
+	measure("add:box", solidSpace, [&]() {
+		glm::vec3 min = glm::vec3(1500,0,500);
+		BoundingBox box = BoundingBox(min,min+glm::vec3(512.0f));
+		BoxDistanceFunction function = BoxDistanceFunction();
+		Transformation model = Transformation(box.getLength()*0.5f, box.getCenter(), 0, 0, 0);
+		WrappedBox wrappedFunction = WrappedBox(&function);
+		solidSpace.add(&wrappedFunction, model, translate, scale, BenchPainter(9), minSize*2.0f, simplifier, handler);
+	});
+
+	measure("add:sphere", solidSpace, [&]() {
+		glm::vec3 min = glm::vec3(1500,0,500);
+		BoundingSphere sphere = BoundingSphere(min+3.0f*glm::vec3(512.0f)/4.0f, 256);
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		solidSpace.add(&wrappedFunction, model, translate, scale, BenchPainter(7), minSize*0.5f, simplifier, handler);
+	});
+
+	measure("del:sphere", solidSpace, [&]() {
+		glm::vec3 min = glm::vec3(1500,0,500);
+		BoundingSphere sphere = BoundingSphere(min+glm::vec3(512.0f), 128);
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		solidSpace.del(&wrappedFunction, model, translate, scale, BenchPainter(5), minSize*0.25f, simplifier, handler);
+	});
+
+	measure("del:capsule", solidSpace, [&]() {
+		Transformation model = Transformation();
+		CapsuleDistanceFunction function(glm::vec3(0,0, -3000), glm::vec3(0,500,0), 256.0f);
+		WrappedCapsule wrappedFunction = WrappedCapsule(&function);
+		WrappedPerlinDistortDistanceEffect distortedFunction = WrappedPerlinDistortDistanceEffect(&wrappedFunction, 64.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
+		solidSpace.del(&distortedFunction, model, translate, scale, BenchPainter(5), minSize, simplifier, handler);
+	});
+
+	measure("add:liquidSphere", liquidSpace, [&]() {
+		glm::vec3 min = glm::vec3(1500,0,500);
+		BoundingSphere sphere = BoundingSphere(min+glm::vec3(512.0f), 64);
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		liquidSpace.add(&wrappedFunction, model, translate, scale, BenchPainter(1), minSize*0.1f, simplifier, handler);
+	});
+
+	measure("add:perlinDistort", solidSpace, [&]() {
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model(glm::vec3(200.0f), glm::vec3(512,512,0), 0,0,0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		WrappedPerlinDistortDistanceEffect distortedFunction = WrappedPerlinDistortDistanceEffect(&wrappedFunction, 48.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
+		solidSpace.add(&distortedFunction, model, translate, scale, BenchPainter(5), minSize*0.25f, simplifier, handler);
+	});
+
+	measure("add:perlinCarve", solidSpace, [&]() {
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model(glm::vec3(200.0f), glm::vec3(512,512,512), 0,0,0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		WrappedPerlinCarveDistanceEffect carvedFunction = WrappedPerlinCarveDistanceEffect(&wrappedFunction, 64.0f, 0.1f/32.0f, 0.1f, glm::vec3(0), 0.0f, 1.0f);
+		solidSpace.add(&carvedFunction, model, translate, scale, BenchPainter(5), minSize*0.2f, simplifier, handler);
+	});
+
+	measure("add:voronoiCarve", solidSpace, [&]() {
+		SphereDistanceFunction function = SphereDistanceFunction();
+		Transformation model(glm::vec3(200.0f), glm::vec3(512,512,512*3), 0,0,0);
+		WrappedSphere wrappedFunction = WrappedSphere(&function);
+		WrappedVoronoiCarveDistanceEffect distortFunction = WrappedVoronoiCarveDistanceEffect(&wrappedFunction, 64.0f, 64.0f, glm::vec3(0), 0.0f, 1.0f);
+		solidSpace.add(&distortFunction, model, translate, scale, BenchPainter(5), minSize*0.25f, simplifier, handler);
+	});
+
+	measure("add:boxFine", solidSpace, [&]() {
+		glm::vec3 min = glm::vec3(2500,0,-1000);
+		BoundingBox box = BoundingBox(min,min+glm::vec3(512.0f));
+		BoxDistanceFunction function = BoxDistanceFunction();
+		Transformation model = Transformation(box.getLength()*0.5f, box.getCenter(), 0, 0, 0);
+		WrappedBox wrappedFunction = WrappedBox(&function);
+		solidSpace.add(&wrappedFunction, model, translate, scale, BenchPainter(9), minSize*0.25, simplifier, handler);
+	});
+}
+
+static void tesselate(Octree &tree, ThreadPool &threadPool, long * triangles, long * chunks) {
+	ChunkCollector collector;
+	tree.iterate(collector);
+	*chunks = collector.chunks.size();
+
+	std::vector<std::future<long>> futures;
+	futures.reserve(collector.chunks.size());
+	for(OctreeNodeData &chunk : collector.chunks) {
+		futures.emplace_back(threadPool.enqueue([&tree, &threadPool, chunk]() {
+			OctreeNodeData data = chunk;
+			long count = 0;
+			ThreadContext context = ThreadContext(data.cube);
+			Tesselator tesselator(&count, &context);
+			std::vector<OctreeNodeTriangleHandler*> handlers;
+			handlers.emplace_back(&tesselator);
+			Processor processor(&count, threadPool, &context, &handlers);
+			processor.iterateFlatIn(tree, data);
+			long result = tesselator.geometry->indices.size() / 3;
+			delete tesselator.geometry;
+			return result;
+		}));
+	}
+	for(std::future<long> &f : futures) {
+		*triangles += f.get();
+	}
+}
+
+static void writeJson(std::ostream &out) {
+	out << "{\"benchmark\": \"octree\", \"phases\": [" << std::endl;
+	for(size_t i = 0 ; i < phases.size() ; ++i) {
+		BenchPhase &p = phases[i];
+		out << "  {\"name\": \"" << p.name << "\", \"ms\": " << p.ms
+			<< ", \"nodes\": " << p.nodes
+			<< ", \"nodeBlocks\": " << p.nodeBlocks
+			<< ", \"childBlocks\": " << p.childBlocks
+			<< ", \"payloadBlocks\": " << p.payloadBlocks
+			<< ", \"peakRssKb\": " << p.peakRssKb;
+		for(auto &e : p.extra) {
+			out << ", \"" << e.first << "\": " << e.second;
+		}
+		out << "}" << (i + 1 < phases.size() ? "," : "") << std::endl;
+	}
+	out << "]}" << std::endl;
+}
+
+int main(int argc, char ** argv) {
+	int tiles = 256;
+	int iterations = 10;
+	std::string folder = "bench_data";
+	std::string json = "";
+	for(int i = 1 ; i + 1 < argc ; i += 2) {
+		std::string arg = argv[i];
+		if(arg == "--tiles") tiles = std::stoi(argv[i+1]);
+		else if(arg == "--iterations") iterations = std::stoi(argv[i+1]);
+		else if(arg == "--folder") folder = argv[i+1];
+		else if(arg == "--json") json = argv[i+1];
+	}
+
+	Octree solidSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9));
+	Octree liquidSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9));
+	Simplifier simplifier(0.99f, 0.1f, true);
+	BenchChangeHandler handler;
+	ThreadPool &threadPool = ThreadPool::shared();
+
+	// PerlinNoise (FastNoise2) against stb_perlin on the same points. The values at a point
+	// differ, the spread and the mean have to stay within NOISE_TOLERANCE
+	std::vector<float> noiseX, noiseY, noiseZ;
+	for(int i = 0 ; i < 64 ; ++i) {
+		for(int j = 0 ; j < 64 ; ++j) {
+			for(int k = 0 ; k < 64 ; ++k) {
+				noiseX.push_back(100.0f + i * 0.173f);
+				noiseY.push_back(-50.0f + j * 0.219f);
+				noiseZ.push_back(20.0f + k * 0.157f);
+			}
+		}
+	}
+	std::vector<float> fastNoise(noiseX.size()), stbNoise(noiseX.size());
+	PerlinNoise perlin(0);
+	BenchPhase &noise = measure("noise", solidSpace, [&]() {
+		perlin.get(noiseX.data(), noiseY.data(), noiseZ.data(), fastNoise.data(), fastNoise.size());
+	});
+	auto referenceStart = std::chrono::steady_clock::now();
+	perlin.getReference(noiseX.data(), noiseY.data(), noiseZ.data(), stbNoise.data(), stbNoise.size());
+	auto referenceEnd = std::chrono::steady_clock::now();
+	double fastSum = 0.0, stbSum = 0.0, fastSquares = 0.0, stbSquares = 0.0;
+	for(size_t i = 0 ; i < fastNoise.size() ; ++i) {
+		fastSum += fastNoise[i];
+		stbSum += stbNoise[i];
+		fastSquares += fastNoise[i] * fastNoise[i];
+		stbSquares += stbNoise[i] * stbNoise[i];
+	}
+	double rmsRatio = std::sqrt(fastSquares / stbSquares);
+	double meanDelta = std::abs(fastSum - stbSum) / fastNoise.size() / std::sqrt(stbSquares / stbNoise.size());
+	bool noiseOk = std::abs(rmsRatio - 1.0) <= NOISE_TOLERANCE && meanDelta <= NOISE_TOLERANCE;
+	noise.extra.push_back({"points", (double) fastNoise.size()});
+	noise.extra.push_back({"referenceMs", std::chrono::duration<double, std::milli>(referenceEnd - referenceStart).count()});
+	noise.extra.push_back({"rmsRatio", rmsRatio});
+	noise.extra.push_back({"meanDelta", meanDelta});
+	noise.extra.push_back({"withinTolerance", noiseOk ? 1.0 : 0.0});
+	if(!noiseOk) {
+		std::cerr << "[bench] noise out of tolerance: rmsRatio=" << rmsRatio << " meanDelta=" << meanDelta << std::endl;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	generate(solidSpace, liquidSpace, simplifier, &handler, tiles);
+	auto end = std::chrono::steady_clock::now();
+	BenchPhase &total = measure("generate", solidSpace, [](){});
+	total.ms = std::chrono::duration<double, std::milli>(end - start).count();
+	total.extra.push_back({"chunkUpdates", (double) handler.updated.load()});
+	total.extra.push_back({"chunkErases", (double) handler.erased.load()});
+
+	long triangles = 0, chunks = 0;
+	BenchPhase &mesh = measure("tesselate", solidSpace, [&]() {
+		tesselate(solidSpace, threadPool, &triangles, &chunks);
+	});
+	mesh.extra.push_back({"chunks", (double) chunks});
+	mesh.extra.push_back({"triangles", (double) triangles});
+
+	// fixed camera above the map looking at the brushes, same clip planes as main.cpp
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 512000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(-2000.0f, 1500.0f, -2000.0f), glm::vec3(1000.0f, 0.0f, 1000.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = projection * view;
+	OctreeVisibilityChecker checker;
+	size_t visible = 0;
+	BenchPhase &visibility = measure("visibility", solidSpace, [&]() {
+		for(int i = 0 ; i < iterations ; ++i) {
+			checker.visibleNodes.clear();
+			checker.sortPosition = glm::vec3(-2000.0f, 1500.0f, -2000.0f);
+			checker.update(viewProjection);
+			solidSpace.iterateParallel(checker);
+			visible = checker.visibleNodes.size();
+		}
+	});
+	visibility.ms /= iterations;
+	visibility.extra.push_back({"visibleChunks", (double) visible});
+
+	// a packet of rays straight down over the map, like ground probes of gameplay code
+	OctreeQuery query(&solidSpace);
+	std::vector<OctreeRay> rays;
+	for(int x = 0 ; x < 64 ; ++x) {
+		for(int z = 0 ; z < 64 ; ++z) {
+			glm::vec3 origin = glm::vec3(-3000.0f + x * 6000.0f / 64, 1500.0f, -3000.0f + z * 6000.0f / 64);
+			rays.push_back({origin, glm::vec3(0.0f, -1.0f, 0.0f), 4000.0f});
+		}
+	}
+	std::vector<OctreeHit> hits;
+	BenchPhase &raycast = measure("raycast", solidSpace, [&]() {
+		for(int i = 0 ; i < iterations ; ++i) {
+			query.raycast(rays, hits);
+		}
+	});
+	raycast.ms /= iterations;
+	raycast.extra.push_back({"rays", (double) rays.size()});
+	raycast.extra.push_back({"hits", (double) std::count_if(hits.begin(), hits.end(), [](const OctreeHit &hit) { return hit.hit; })});
+
+	// the same lattice of points around the ground located one by one and as a batch
+	std::vector<glm::vec3> points;
+	for(int x = 0 ; x < 128 ; ++x) {
+		for(int y = 0 ; y < 8 ; ++y) {
+			for(int z = 0 ; z < 128 ; ++z) {
+				points.push_back(glm::vec3(-3000.0f + x * 6000.0f / 128, -200.0f + y * 50.0f, -3000.0f + z * 6000.0f / 128));
+			}
+		}
+	}
+	std::vector<OctreePointLocation> single(points.size());
+	BenchPhase &locatePoints = measure("locate:points", solidSpace, [&]() {
+		for(int i = 0 ; i < iterations ; ++i) {
+			for(size_t k = 0 ; k < points.size() ; ++k) {
+				OctreeNodeLevel nodeLevel = solidSpace.getNodeAt(points[k], INT_MAX, false);
+				single[k] = OctreePointLocation{nodeLevel.node, nodeLevel.level, solidSpace.getSdfAt(points[k])};
+			}
+		}
+	});
+	locatePoints.ms /= iterations;
+	locatePoints.extra.push_back({"points", (double) points.size()});
+	std::vector<OctreePointLocation> batch;
+	BenchPhase &locateBatch = measure("locate:batch", solidSpace, [&]() {
+		for(int i = 0 ; i < iterations ; ++i) {
+			solidSpace.locate(points, INT_MAX, false, batch);
+		}
+	});
+	locateBatch.ms /= iterations;
+	locateBatch.extra.push_back({"points", (double) points.size()});
+	size_t mismatches = 0;
+	for(size_t k = 0 ; k < points.size() ; ++k) {
+		bool sameSdf = single[k].sdf == batch[k].sdf || (std::isinf(single[k].sdf) && std::isinf(batch[k].sdf));
+		if(single[k].node != batch[k].node || single[k].level != batch[k].level || !sameSdf) {
+			++mismatches;
+		}
+	}
+	locateBatch.extra.push_back({"mismatches", (double) mismatches});
+
+	measure("save", solidSpace, [&]() {
+		OctreeFile saver(&solidSpace, "solid");
+		saver.save(folder, 4096);
+	});
+
+	Octree loadedSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9));
+	measure("load", loadedSpace, [&]() {
+		OctreeFile loader(&loadedSpace, "solid");
+		loader.load(folder, 4096);
+	});
+
+	// the same tree split at its own chunk size and read back through a pager, every chunk is
+	// faulted by the tesselation, a quarter of them stay after the trim and the rest is faulted again
+	std::string pagedFolder = folder + "/paged";
+	measure("save:chunks", solidSpace, [&]() {
+		OctreeFile saver(&solidSpace, "solid");
+		saver.save(pagedFolder, solidSpace.chunkSize);
+	});
+
+	Octree pagedSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9));
+	OctreePager pager(&pagedSpace, pagedFolder, "solid", 0);
+	pagedSpace.pager = &pager;
+	measure("load:paged", pagedSpace, [&]() {
+		OctreeFile loader(&pagedSpace, "solid");
+		loader.load(pagedFolder, pagedSpace.chunkSize);
+	});
+
+	long pagedTriangles = 0, pagedChunks = 0;
+	BenchPhase &pagedMesh = measure("tesselate:paged", pagedSpace, [&]() {
+		tesselate(pagedSpace, threadPool, &pagedTriangles, &pagedChunks);
+	});
+	pagedMesh.extra.push_back({"chunks", (double) pagedChunks});
+	pagedMesh.extra.push_back({"triangles", (double) pagedTriangles});
+	pagedMesh.extra.push_back({"residentBytes", (double) pager.getResidentBytes()});
+	std::cout << "[bench] pager " << pager.getStats() << std::endl;
+
+	BenchPhase &trim = measure("trim:paged", pagedSpace, [&]() {
+		pager.setBudget(pager.getResidentBytes() / 4);
+		pager.trim();
+	});
+	trim.extra.push_back({"residentBytes", (double) pager.getResidentBytes()});
+
+	long refaultedTriangles = 0, refaultedChunks = 0;
+	BenchPhase &refaultedMesh = measure("tesselate:refaulted", pagedSpace, [&]() {
+		tesselate(pagedSpace, threadPool, &refaultedTriangles, &refaultedChunks);
+	});
+	refaultedMesh.extra.push_back({"triangles", (double) refaultedTriangles});
+	std::cout << "[bench] pager " << pager.getStats() << std::endl;
+
+	// evicted chunks are copied from their files
+	pager.trim();
+	measure("save:paged", pagedSpace, [&]() {
+		OctreeFile saver(&pagedSpace, "solid");
+		saver.save(pagedFolder, pagedSpace.chunkSize);
+	});
+	pagedSpace.pager = NULL;
+
+	measure("saveImage", solidSpace, [&]() {
+		OctreeImage saver(&solidSpace, "solid");
+		saver.save(folder, false);
+	});
+
+	Octree imageSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9));
+	measure("loadImage", imageSpace, [&]() {
+		OctreeImage loader(&imageSpace, "solid");
+		loader.load(folder);
+	});
+
+	// the same traversals once the edited tree is laid out again
+	size_t moved = 0;
+	BenchPhase &compact = measure("compact", solidSpace, [&]() {
+		moved = solidSpace.compact();
+	});
+	compact.extra.push_back({"movedNodes", (double) moved});
+
+	long compactedTriangles = 0, compactedChunks = 0;
+	BenchPhase &compactedMesh = measure("tesselate:compacted", solidSpace, [&]() {
+		tesselate(solidSpace, threadPool, &compactedTriangles, &compactedChunks);
+	});
+	compactedMesh.extra.push_back({"chunks", (double) compactedChunks});
+	compactedMesh.extra.push_back({"triangles", (double) compactedTriangles});
+
+	measure("save:compacted", solidSpace, [&]() {
+		OctreeFile saver(&solidSpace, "solid");
+		saver.save(folder, 4096);
+	});
+
+	writeJson(std::cout);
+	if(json.size()) {
+		std::ofstream file(json);
+		writeJson(file);
+	}
+	return noiseOk ? 0 : 1;
+}
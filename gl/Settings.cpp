@@ -24,4 +24,8 @@ Settings::Settings() {
     this->showBrushVolume = false;
     this->ambientColor = glm::vec3(0.2f,0.2f,0.2f);
     this->ambientIntensity = 1.0f;
+    this->pagingBudget = 0;
+    this->remeshBudget = 4.0f;
+    this->remeshInFlight = 0;
+    this->journalBudget = 256;
 }
@@ -368,6 +368,10 @@ class Settings {
         bool showBrushVolume;
         glm::vec3 ambientColor;
         float ambientIntensity;
+        uint pagingBudget; // MB of chunks kept in memory, 0 keeps the whole world resident
+        float remeshBudget; // ms of remesh work started per frame and pool thread
+        uint remeshInFlight; // max remesh jobs in the pool, 0 is twice the thread count
+        uint journalBudget; // MB of undo history of the solid space, 0 keeps none
         Settings();
 
 };
@@ -124,6 +124,7 @@ public:
 
 		std::cout << "sizeof(Vertex) = " << sizeof(Vertex) << std::endl; 
 		std::cout << "sizeof(OctreeNode) = " << sizeof(OctreeNode) << std::endl; 
+		std::cout << "sizeof(OctreeNodePayload) = " << sizeof(OctreeNodePayload) << std::endl; 
 		std::cout << "sizeof(ChildBlock) = " << sizeof(ChildBlock) << std::endl; 
 		std::cout << "sizeof(OctreeNodeSerialized) = " << sizeof(OctreeNodeSerialized) << std::endl; 
 		std::cout << "sizeof(OctreeNodeCubeSerialized) = " << sizeof(OctreeNodeCubeSerialized) << std::endl; 
@@ -778,6 +779,10 @@ public:
 			glUseProgram(programDebug);
 			UniformBlock::uniform(0, &uniformBlock, sizeof(UniformBlock), *uniformBlockData);
 			mainScene->draw3dOctree(camera.position, mainScene->solidRenderer);
+			// the explorer nodes are read straight from the tree, they may be gone after a brush edit
+			if(mainScene->brushWorker.isEditing()) {
+				octreeExplorer->openNodes.clear();
+			}
 			mainScene->draw3dNodes(&octreeExplorer->openNodes, &boxGeometry);
 			//mainScene->draw3dNodes2(mainScene->solidRenderer ,&boxGeometry);
 		}
@@ -942,6 +947,20 @@ public:
 				ImGuiFileDialog::Instance()->Close();
 			}
 
+			if (ImGui::BeginMenu("Edit")) {
+				if (ImGui::MenuItem("Undo", NULL, false, mainScene->solidSpace.journal->canUndo())) {
+					mainScene->undo();
+				}
+				if (ImGui::MenuItem("Redo", NULL, false, mainScene->solidSpace.journal->canRedo())) {
+					mainScene->redo();
+				}
+				ImGui::Separator();
+				if (ImGui::MenuItem("Compact Octrees")) {
+					mainScene->compact();
+				}
+				ImGui::EndMenu();
+			}
+
 			// Edit Menu
 			if (ImGui::BeginMenu("Tools")) {
 				if (ImGui::MenuItem("Animated Textures", "Ctrl+A")) {
@@ -1027,7 +1046,7 @@ public:
 			size_t allocatedChildren = mainScene->solidSpace.allocator->childAllocator.getAllocatedBlocksCount();
 			size_t childrenSize = mainScene->solidSpace.allocator->childAllocator.getBlockSize();
 
-			ImGui::Text("%ld (%ld KB) allocatted nodes",  allocatedBlocks*blockSize, allocatedBlocks*blockSize* sizeof(OctreeNode)/1024);
+			ImGui::Text("%ld (%ld KB) allocatted nodes",  allocatedBlocks*blockSize, allocatedBlocks*blockSize* (sizeof(OctreeNode) + sizeof(OctreeNodePayload))/1024);
 			ImGui::Text("%ld (%ld KB) allocatted children",  allocatedChildren*childrenSize, allocatedChildren*childrenSize* sizeof(ChildBlock)/1024);
 
 			if (glfwJoystickIsGamepad(GLFW_JOYSTICK_1)) {
@@ -1053,7 +1072,11 @@ public:
 		atlasPainter->draw2dIfOpen(time);
 		textureViewer->draw2dIfOpen(time);
 		impostorViewer->draw2dIfOpen(time);
-		octreeExplorer->draw2dIfOpen(time);
+		if(mainScene->brushWorker.isEditing()) {
+			octreeExplorer->openNodes.clear();
+		} else {
+			octreeExplorer->draw2dIfOpen(time);
+		}
 
 		if(demo) {
 			ImGui::ShowDemoWindow(&demo);
@@ -1,51 +1,138 @@
 #include "math.hpp"
 
-CachedHeightMapSurface::CachedHeightMapSurface(const HeightFunction &function, BoundingBox box, float delta) {
+CachedHeightMapSurface::CachedHeightMapSurface(const HeightFunction &function, BoundingBox box, float delta, ThreadPool * pool, std::function<void(int, int)> progress) {
     this->box = box;
     glm::vec3 len = box.getLength();
     
     
     this->width = len.x/delta;
     this->height = len.z/delta;
-    this->data = std::vector<std::vector<float>>(width, std::vector<float>(height)); 
-
-    for(int i=0; i<width; ++i) {
-        for(int j=0; j<height; ++j) {
-            float x = i * delta + box.getMinX();
-            float z = j * delta + box.getMinZ();
-            this->data[i][j] = function.getHeightAt(x, z);
-        }	
+    this->tilesX = (width + HEIGHTMAP_CACHE_TILE - 1) / HEIGHTMAP_CACHE_TILE;
+    this->tilesZ = (height + HEIGHTMAP_CACHE_TILE - 1) / HEIGHTMAP_CACHE_TILE;
+    this->tileRanges.resize((size_t) tilesX * tilesZ);
+
+    size_t bytes = sizeof(float) * (size_t) width * (size_t) height;
+    bytes = (bytes + 63) & ~((size_t) 63);
+    this->data = static_cast<float*>(std::aligned_alloc(64, std::max<size_t>(bytes, 64)));
+    if(this->data == NULL) {
+        throw std::bad_alloc();
     }
-}
 
+    if(pool == NULL) {
+        pool = &ThreadPool::shared();
+    }
 
+    // each tile asks the function for one column of the tile at a time
+    auto fillTile = [this, &function, &box, delta](int i0, int j0) {
+        float x[HEIGHTMAP_CACHE_TILE], z[HEIGHTMAP_CACHE_TILE];
+        int i1 = std::min(i0 + HEIGHTMAP_CACHE_TILE, width);
+        int j1 = std::min(j0 + HEIGHTMAP_CACHE_TILE, height);
+        for(int j=j0; j<j1; ++j) {
+            z[j-j0] = j * delta + box.getMinZ();
+        }
+        for(int i=i0; i<i1; ++i) {
+            std::fill(x, x + (j1-j0), i * delta + box.getMinX());
+            function.getHeightsAt(x, z, this->data + (size_t) i * height + j0, j1-j0);
+        }
+        glm::vec2 range = glm::vec2(INFINITY, -INFINITY);
+        for(int i=i0; i<i1; ++i) {
+            for(int j=j0; j<j1; ++j) {
+                float h = this->data[(size_t) i * height + j];
+                range = glm::vec2(glm::min(range.x, h), glm::max(range.y, h));
+            }
+        }
+        tileRanges[(size_t) (i0 / HEIGHTMAP_CACHE_TILE) * tilesZ + j0 / HEIGHTMAP_CACHE_TILE] = range;
+    };
+
+    std::vector<std::future<void>> tiles;
+    for(int i=0; i<width; i+=HEIGHTMAP_CACHE_TILE) {
+        for(int j=0; j<height; j+=HEIGHTMAP_CACHE_TILE) {
+            tiles.push_back(pool->enqueue(fillTile, i, j));
+        }
+    }
+
+    int total = tiles.size();
+    for(int t = 0; t < total; ++t) {
+        tiles[t].get();
+        if(progress) {
+            progress(t+1, total);
+        }
+    }
+}
+
+CachedHeightMapSurface::~CachedHeightMapSurface() {
+    std::free(this->data);
+}
 
 float CachedHeightMapSurface::getData(int x, int z) const {
-    return this->data[Math::clamp(x, 0, this->width-1)][Math::clamp(z, 0, this->height-1)];
+    return this->data[(size_t) Math::clamp(x, 0, this->width-1) * height + Math::clamp(z, 0, this->height-1)];
 }
 
-float CachedHeightMapSurface::getHeightAt(float x, float z) const  {
-    // bilinear interpolation
-    glm::vec3 len = box.getLength();
-    
-    float px = Math::clamp((x-box.getMinX())/len.x, 0.0, 1.0);
-    float pz = Math::clamp((z-box.getMinZ())/len.z, 0.0, 1.0);
-    int ix = floor(px * width);
-    int iz = floor(pz * height);
+// px and pz are the normalized [0,1] coordinates inside the box
+static inline float bilinear(const CachedHeightMapSurface &map, float px, float pz) {
+    int ix = floor(px * map.width);
+    int iz = floor(pz * map.height);
 
-    float qx = (px * width) - ix;
-    float qz = (pz * height) - iz;
+    float qx = (px * map.width) - ix;
+    float qz = (pz * map.height) - iz;
 
-    float q11 = getData(ix, iz);
-    float q21 = getData(ix+1, iz);
-    float q12 = getData(ix, iz+1);
-    float q22 = getData(ix+1, iz+1);
+    float q11 = map.getData(ix, iz);
+    float q21 = map.getData(ix+1, iz);
+    float q12 = map.getData(ix, iz+1);
+    float q22 = map.getData(ix+1, iz+1);
 
     float y1 = (1.0 - qx)*q11 + (qx)*q21;
     float y2 = (1.0 - qx)*q12 + (qx)*q22;
 
     float y = (1.0 - qz)*y1 + (qz)*y2;
 
-    return Math::clamp( y, box.getMinY(), box.getMaxY());
+    return Math::clamp( y, map.box.getMinY(), map.box.getMaxY());
 }
 
+float CachedHeightMapSurface::getHeightAt(float x, float z) const  {
+    // bilinear interpolation
+    glm::vec3 len = box.getLength();
+    
+    float px = Math::clamp((x-box.getMinX())/len.x, 0.0, 1.0);
+    float pz = Math::clamp((z-box.getMinZ())/len.z, 0.0, 1.0);
+    return bilinear(*this, px, pz);
+}
+
+void CachedHeightMapSurface::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    glm::vec3 len = box.getLength();
+    float minX = box.getMinX();
+    float minZ = box.getMinZ();
+    for(size_t i = 0; i < count; ++i) {
+        float px = Math::clamp((x[i]-minX)/len.x, 0.0, 1.0);
+        float pz = Math::clamp((z[i]-minZ)/len.z, 0.0, 1.0);
+        out[i] = bilinear(*this, px, pz);
+    }
+}
+
+// Combines the ranges of the whole tiles under the cube, wider than the samples
+// it really covers but still conservative. Bilinear heights never leave the range
+// of their 4 samples, hence the extra sample on the high side.
+glm::vec2 CachedHeightMapSurface::getHeightRangeBetween(const BoundingCube &cube) const {
+    if(tileRanges.empty()) {
+        return glm::vec2(-INFINITY, INFINITY);
+    }
+    glm::vec3 len = box.getLength();
+    float px0 = Math::clamp((cube.getMinX()-box.getMinX())/len.x, 0.0, 1.0);
+    float pz0 = Math::clamp((cube.getMinZ()-box.getMinZ())/len.z, 0.0, 1.0);
+    float px1 = Math::clamp((cube.getMaxX()-box.getMinX())/len.x, 0.0, 1.0);
+    float pz1 = Math::clamp((cube.getMaxZ()-box.getMinZ())/len.z, 0.0, 1.0);
+    int i0 = Math::clamp((int) floor(px0 * width), 0, width-1);
+    int j0 = Math::clamp((int) floor(pz0 * height), 0, height-1);
+    int i1 = Math::clamp((int) floor(px1 * width) + 1, 0, width-1);
+    int j1 = Math::clamp((int) floor(pz1 * height) + 1, 0, height-1);
+
+    glm::vec2 range = glm::vec2(INFINITY, -INFINITY);
+    for(int tx = i0 / HEIGHTMAP_CACHE_TILE; tx <= i1 / HEIGHTMAP_CACHE_TILE; ++tx) {
+        for(int tz = j0 / HEIGHTMAP_CACHE_TILE; tz <= j1 / HEIGHTMAP_CACHE_TILE; ++tz) {
+            glm::vec2 tile = tileRanges[(size_t) tx * tilesZ + tz];
+            range = glm::vec2(glm::min(range.x, tile.x), glm::max(range.y, tile.y));
+        }
+    }
+    // same clamp as bilinear
+    return glm::clamp(range, glm::vec2(box.getMinY()), glm::vec2(box.getMaxY()));
+}
@@ -1,24 +1,38 @@
 #include "math.hpp"
 
 
-FractalPerlinSurface::FractalPerlinSurface(float amplitude, float frequency, float offset) : PerlinSurface(amplitude, frequency, offset){
+FractalPerlinSurface::FractalPerlinSurface(float amplitude, float frequency, float offset, int seed) : PerlinSurface(amplitude, frequency, offset, seed){
 }
 
 float FractalPerlinSurface::getHeightAt(float x, float z) const {
-    float noise = 0;
-    float weight = 1.0;
-    float total = 0.0;
-    float f = frequency;
-    int octaves = 8;
-    for(int o = 0 ; o < octaves ; ++o) {
-        PerlinSurface perlin(amplitude, f, offset);
-        noise += perlin.getHeightAt(x,z) * weight;
-        total += weight;
-        weight *= 0.5;
-        f *= 2;
-    }
+    float noise;
+    getHeightsAt(&x, &z, &noise, 1);
+    return noise;
+}
 
-    noise /= total;
+void FractalPerlinSurface::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    float octave[NOISE_BATCH_SIZE];
+    int octaves = 8;
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        float * noise = out + start;
+        std::fill(noise, noise + n, 0.0f);
+        float weight = 1.0;
+        float total = 0.0;
+        float f = frequency;
+        for(int o = 0 ; o < octaves ; ++o) {
+            PerlinSurface perlin(amplitude, f, offset, seed);
+            perlin.getHeightsAt(x + start, z + start, octave, n);
+            for(size_t i = 0; i < n; ++i) {
+                noise[i] += octave[i] * weight;
+            }
+            total += weight;
+            weight *= 0.5;
+            f *= 2;
+        }
 
-    return offset + amplitude * noise;
+        for(size_t i = 0; i < n; ++i) {
+            noise[i] = offset + amplitude * (noise[i] / total);
+        }
+    }
 }
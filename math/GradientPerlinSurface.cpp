@@ -1,48 +1,70 @@
 #include "math.hpp"
 
 
-GradientPerlinSurface::GradientPerlinSurface(float amplitude, float frequency, float offset) : PerlinSurface(amplitude, frequency, offset){
+GradientPerlinSurface::GradientPerlinSurface(float amplitude, float frequency, float offset, int seed) : PerlinSurface(amplitude, frequency, offset, seed){
 
 }
-long callsToGradientPerlinSurfaceGetHeight = 0;
+
 float GradientPerlinSurface::getHeightAt(float x,float z) const   {
-    float noise = 0;
-    float weight = 1.0;
-    float total = 0.0;
-    float f = frequency;
-    int octaves = 16;
-    
-    for(int i = 0 ; i < octaves ; ++i) {
-        PerlinSurface perlin(1 , f, 0);
-        glm::vec3 n = perlin.getNormal(x,z, 0.1);
-    
-        float m = 1.0f -Math::clamp(glm::abs(glm::dot(glm::vec3(0,1,0), n)), 0.0f, 1.0f);
-        float s = glm::pow(glm::e<float>(),-2.0f*m);
-
-
-        noise += s*perlin.getHeightAt(x,z) * weight;
-        total +=  weight;
-        weight *= 0.5;
-
-        f *= 2;
-    }
-    
-    noise /= total;
+    float noise;
+    getHeightsAt(&x, &z, &noise, 1);
+    return noise;
+}
 
+void GradientPerlinSurface::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    const int octaves = 16;
+    const float delta = 0.1f;
+    // per octave: height at (x,z), (x+delta,z) and (x,z+delta) for the normal, all in one noise call
+    float sx[NOISE_BATCH_SIZE*3], sz[NOISE_BATCH_SIZE*3], h[NOISE_BATCH_SIZE*3];
+    float sy[NOISE_BATCH_SIZE*3] = {};
+    PerlinNoise perlin(seed);
 
-    float beachLevel = 0.1;
-    float divisions = 3;
-    // Create beach
-    if(noise < 0.1){
-        noise = beachLevel+ (noise - beachLevel) / divisions;
-    }
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        float * noise = out + start;
+        std::fill(noise, noise + n, 0.0f);
+        float weight = 1.0;
+        float total = 0.0;
+        float f = frequency;
 
-    noise = offset + amplitude * noise;
-    if(++callsToGradientPerlinSurfaceGetHeight%1000000 == 0 ){
-        std::cout << "cg[" + std::to_string(callsToGradientPerlinSurfaceGetHeight) << "] = " << std::to_string(noise) << std::endl;
-    }
+        for(int o = 0 ; o < octaves ; ++o) {
+            for(size_t i = 0; i < n; ++i) {
+                float px = x[start + i];
+                float pz = z[start + i];
+                sx[i] = px*f;             sz[i] = pz*f;
+                sx[n + i] = (px+delta)*f; sz[n + i] = pz*f;
+                sx[2*n + i] = px*f;       sz[2*n + i] = (pz+delta)*f;
+            }
+            perlin.get(sx, sy, sz, h, n*3);
 
+            for(size_t i = 0; i < n; ++i) {
+                float q11 = h[i];
+                float q21 = h[n + i];
+                float q12 = h[2*n + i];
+                // same as HeightFunction::getNormal
+                glm::vec3 n21 = glm::normalize(glm::vec3(delta, q21 - q11, 0));
+                glm::vec3 n12 = glm::normalize(glm::vec3(0, q12 - q11, delta));
+                glm::vec3 normal = glm::cross(n12, n21);
 
-    return noise;
-}
+                float m = 1.0f -Math::clamp(glm::abs(glm::dot(glm::vec3(0,1,0), normal)), 0.0f, 1.0f);
+                float s = glm::pow(glm::e<float>(),-2.0f*m);
+                noise[i] += s*q11 * weight;
+            }
+            total +=  weight;
+            weight *= 0.5;
+
+            f *= 2;
+        }
 
+        float beachLevel = 0.1;
+        float divisions = 3;
+        for(size_t i = 0; i < n; ++i) {
+            float value = noise[i] / total;
+            // Create beach
+            if(value < 0.1){
+                value = beachLevel+ (value - beachLevel) / divisions;
+            }
+            noise[i] = offset + amplitude * value;
+        }
+    }
+}
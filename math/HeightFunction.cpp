@@ -1,5 +1,11 @@
 #include "math.hpp"
 
+void HeightFunction::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    for(size_t i = 0; i < count; ++i) {
+        out[i] = getHeightAt(x[i], z[i]);
+    }
+}
+
 glm::vec3 HeightFunction::getNormal(float x, float z, float delta)  const {
     float q11 = getHeightAt(x,z);
     float q21 = getHeightAt(x+delta, z);
@@ -13,4 +19,8 @@ glm::vec3 HeightFunction::getNormal(float x, float z, float delta)  const {
     glm::vec3 n12 = glm::normalize(v12 -v11 );
 
     return glm::cross(n12,n21);
-}
\ No newline at end of file
+}
+
+glm::vec2 HeightFunction::getHeightRangeBetween(const BoundingCube &cube) const {
+    return glm::vec2(-INFINITY, INFINITY);
+}
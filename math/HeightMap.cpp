@@ -8,3 +8,15 @@ float HeightMap::distance(const glm::vec3 p) const {
     float surfaceY = func.getHeightAt(p.x, p.z);
     return p.y - surfaceY;
 }
+
+
+void HeightMap::distance(const float * x, const float * y, const float * z, float * out, size_t count) const {
+    func.getHeightsAt(x, z, out, count);
+    for(size_t i = 0; i < count; ++i) {
+        out[i] = y[i] - out[i];
+    }
+}
+
+glm::vec2 HeightMap::getHeightRange(const BoundingCube &cube) const {
+    return func.getHeightRangeBetween(cube);
+}
@@ -69,11 +69,35 @@ void processBand(GDALRasterBand* band, int bandIdx, std::vector<int16_t> &result
 }
 
 
-HeightMapTif::HeightMapTif(const std::string &filename, BoundingBox box, int sizePerTile, float verticalScale, float verticalShift){
+
+// tile keys are the Z order code of the tile coordinates, x in the odd (higher) bits
+static uint tileKey(uint tx, uint tz) {
+    uint key = 0;
+    for(uint b = 0; b < 16; ++b) {
+        key |= ((tz >> b) & 1u) << (2*b);
+        key |= ((tx >> b) & 1u) << (2*b + 1);
+    }
+    return key;
+}
+
+static void tileCoords(uint key, int &tx, int &tz) {
+    tx = 0;
+    tz = 0;
+    for(uint b = 0; b < 16; ++b) {
+        tz |= ((key >> (2*b)) & 1u) << b;
+        tx |= ((key >> (2*b + 1)) & 1u) << b;
+    }
+}
+
+HeightMapTif::HeightMapTif(const std::string &filename, BoundingBox box, int sizePerTile, float verticalScale, float verticalShift, size_t cacheBytes) : verticalScale(verticalScale), verticalShift(verticalShift) {
     this->box = box;
     this->sizePerTile = sizePerTile;
+    if(cacheBytes > 0) {
+        openStreaming(filename, cacheBytes);
+        return;
+    }
     // **Open the dataset**
-    GDALDataset* dataset = static_cast<GDALDataset*>(GDALOpen(filename.c_str(), GA_ReadOnly));
+    dataset = static_cast<GDALDataset*>(GDALOpen(filename.c_str(), GA_ReadOnly));
     if (!dataset) {
         std::cerr << "Failed to open " << filename << std::endl;
         return;
@@ -83,6 +107,8 @@ HeightMapTif::HeightMapTif(const std::string &filename, BoundingBox box, int siz
     double geoTransform[6];
     if (dataset->GetGeoTransform(geoTransform) != CE_None) {
         std::cerr << "Failed to get geotransform." << std::endl;
+        GDALClose(dataset);
+        dataset = NULL;
         return;
     }
     std::cout << "Successfully opened "+ filename << std::endl;
@@ -116,14 +142,242 @@ HeightMapTif::HeightMapTif(const std::string &filename, BoundingBox box, int siz
     std::cout << "Calculated "+ std::to_string(sz) << " data[float]" << std::endl;
 
 
-    // **Close the dataset**
+    // **Close the dataset**, only the streaming mode keeps it open
     GDALClose(dataset);
+    dataset = NULL;
 
 }   
 
+void HeightMapTif::openStreaming(const std::string &filename, size_t cacheBytes) {
+    dataset = static_cast<GDALDataset*>(GDALOpen(filename.c_str(), GA_ReadOnly));
+    if (!dataset) {
+        throw std::runtime_error("Failed to open " + filename);
+    }
+    band = dataset->GetRasterBand(1);
+    if (!band) {
+        GDALClose(dataset);
+        dataset = NULL;
+        throw std::runtime_error("Band 1 is missing in " + filename);
+    }
+    width = dataset->GetRasterXSize();
+    height = dataset->GetRasterYSize();
+
+    int hasNoDataFlag = 0;
+    noDataValue = band->GetNoDataValue(&hasNoDataFlag);
+    hasNoData = hasNoDataFlag != 0;
+
+    // tiles are whole GDAL blocks, grouped until they reach HEIGHTMAP_TIF_MIN_TILE (strips get stacked)
+    int blockX, blockY;
+    band->GetBlockSize(&blockX, &blockY);
+    tileWidth = std::min(width, blockX * ((HEIGHTMAP_TIF_MIN_TILE + blockX - 1) / blockX));
+    tileHeight = std::min(height, blockY * ((HEIGHTMAP_TIF_MIN_TILE + blockY - 1) / blockY));
+    tilesX = (width + tileWidth - 1) / tileWidth;
+    tilesZ = (height + tileHeight - 1) / tileHeight;
+    if(tilesX > 65536 || tilesZ > 65536) {
+        throw std::runtime_error("Too many tiles in " + filename);
+    }
+    // same sample lattice as CachedHeightMapSurface, one height per sizePerTile
+    glm::vec3 len = box.getLength();
+    latticeWidth = std::max(1, int(len.x / sizePerTile));
+    latticeHeight = std::max(1, int(len.z / sizePerTile));
+    size_t tileBytes = sizeof(float) * (size_t) tileWidth * (size_t) tileHeight;
+    maxTiles = std::max<size_t>(HEIGHTMAP_TIF_PREFETCH + 1, cacheBytes / tileBytes);
+    tiles.reserve(maxTiles + 1);
+
+    std::cout << "Streaming "+ filename << " " << width << "x" << height
+        << " tiles " << tileWidth << "x" << tileHeight << " cache " << maxTiles << " tiles" << std::endl;
+
+    prefetchThread = std::thread(&HeightMapTif::prefetchLoop, this);
+}
+
+HeightMapTif::~HeightMapTif() {
+    if(prefetchThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(prefetchMutex);
+            prefetchStop = true;
+        }
+        prefetchCondition.notify_all();
+        prefetchThread.join();
+    }
+    if(dataset) {
+        GDALClose(dataset);
+    }
+}
+
+bool HeightMapTif::isStreaming() const {
+    return dataset != NULL;
+}
+
+size_t HeightMapTif::getTileReads() const {
+    return tileReads.load();
+}
+
+int HeightMapTif::getSampleX(float x) const {
+    return Math::clamp(int( width*(x-box.getMinX())/box.getLengthX()), 0, width-1);
+}
+
+int HeightMapTif::getSampleZ(float z) const {
+    return Math::clamp(int( height*(z-box.getMinZ())/box.getLengthZ()), 0, height-1);
+}
+
+std::shared_ptr<const HeightMapTif::Tile> HeightMapTif::findTile(uint key) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = tiles.find(key);
+    if(it == tiles.end()) {
+        return NULL;
+    }
+    lru.splice(lru.begin(), lru, it->second.second);
+    return it->second.first;
+}
+
+std::shared_ptr<const HeightMapTif::Tile> HeightMapTif::loadTile(uint key) const {
+    // GDAL datasets are not thread safe, one reader at a time
+    std::lock_guard<std::mutex> ioLock(ioMutex);
+    std::shared_ptr<const Tile> cached = findTile(key);
+    if(cached) {
+        return cached;
+    }
+
+    int tx, tz;
+    tileCoords(key, tx, tz);
+    auto tile = std::make_shared<Tile>();
+    int x0 = tx * tileWidth;
+    int z0 = tz * tileHeight;
+    tile->width = std::min(tileWidth, width - x0);
+    tile->height = std::min(tileHeight, height - z0);
+    tile->values.resize((size_t) tile->width * tile->height);
+
+    CPLErr err = band->RasterIO(GF_Read, x0, z0, tile->width, tile->height, tile->values.data(), tile->width, tile->height, GDT_Float32, 0, 0);
+    if (err != CE_None) {
+        throw std::runtime_error("Error reading raster tile " + std::to_string(tx) + "," + std::to_string(tz));
+    }
+    for(float &value : tile->values) {
+        if(hasNoData && value == static_cast<float>(noDataValue)) {
+            value = 0.0f;
+        }
+        value = value * verticalScale + verticalShift;
+    }
+    ++tileReads;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    lru.push_front(key);
+    tiles[key] = std::make_pair(std::shared_ptr<const Tile>(tile), lru.begin());
+    while(tiles.size() > maxTiles) {
+        // tiles still held by a reader stay alive through their shared_ptr
+        tiles.erase(lru.back());
+        lru.pop_back();
+    }
+    return tile;
+}
+
+std::shared_ptr<const HeightMapTif::Tile> HeightMapTif::getTile(uint key, bool prefetch) const {
+    std::shared_ptr<const Tile> tile = findTile(key);
+    if(!tile) {
+        if(prefetch) {
+            prefetchAfter(key);
+        }
+        tile = loadTile(key);
+    }
+    return tile;
+}
+
+void HeightMapTif::prefetchAfter(uint key) const {
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        prefetchQueue.clear(); // older requests are behind the current position, drop them
+        for(uint next = key + 1; next <= key + HEIGHTMAP_TIF_PREFETCH; ++next) {
+            int tx, tz;
+            tileCoords(next, tx, tz);
+            if(tx < tilesX && tz < tilesZ) {
+                prefetchQueue.push_back(next);
+            }
+        }
+    }
+    prefetchCondition.notify_one();
+}
+
+void HeightMapTif::prefetchLoop() {
+    for(;;) {
+        uint key;
+        {
+            std::unique_lock<std::mutex> lock(prefetchMutex);
+            prefetchCondition.wait(lock, [this]{ return prefetchStop || !prefetchQueue.empty(); });
+            if(prefetchStop) {
+                return;
+            }
+            key = prefetchQueue.front();
+            prefetchQueue.pop_front();
+        }
+        try {
+            if(!findTile(key)) {
+                loadTile(key);
+            }
+        } catch(const std::exception &e) {
+            std::cerr << "HeightMapTif prefetch: " << e.what() << std::endl;
+        }
+    }
+}
+
+float HeightMapTif::getStreamedHeight(int ix, int iz, std::shared_ptr<const Tile> &tile, uint &key) const {
+    uint k = tileKey(ix / tileWidth, iz / tileHeight);
+    if(!tile || k != key) {
+        tile = getTile(k, true);
+        key = k;
+    }
+    return tile->values[(size_t) (iz % tileHeight) * tile->width + (ix % tileWidth)];
+}
+
+float HeightMapTif::getLatticeHeight(int i, int j, std::shared_ptr<const Tile> &tile, uint &key) const {
+    i = Math::clamp(i, 0, latticeWidth-1);
+    j = Math::clamp(j, 0, latticeHeight-1);
+    int ix = getSampleX(i * sizePerTile + box.getMinX());
+    int iz = getSampleZ(j * sizePerTile + box.getMinZ());
+    return getStreamedHeight(ix, iz, tile, key);
+}
+
+// bilinear over the lattice like CachedHeightMapSurface, without reading the whole raster first
+float HeightMapTif::getInterpolatedHeight(float x, float z, std::shared_ptr<const Tile> &tile, uint &key) const {
+    glm::vec3 len = box.getLength();
+    float px = Math::clamp((x-box.getMinX())/len.x, 0.0, 1.0);
+    float pz = Math::clamp((z-box.getMinZ())/len.z, 0.0, 1.0);
+    int ix = floor(px * latticeWidth);
+    int iz = floor(pz * latticeHeight);
+
+    float qx = (px * latticeWidth) - ix;
+    float qz = (pz * latticeHeight) - iz;
+
+    float q11 = getLatticeHeight(ix, iz, tile, key);
+    float q21 = getLatticeHeight(ix+1, iz, tile, key);
+    float q12 = getLatticeHeight(ix, iz+1, tile, key);
+    float q22 = getLatticeHeight(ix+1, iz+1, tile, key);
+
+    float y1 = (1.0 - qx)*q11 + (qx)*q21;
+    float y2 = (1.0 - qx)*q12 + (qx)*q22;
+
+    float y = (1.0 - qz)*y1 + (qz)*y2;
+
+    return Math::clamp( y, box.getMinY(), box.getMaxY());
+}
+
 float HeightMapTif::getHeightAt(float x, float z) const {
-    int ix = Math::clamp(int( width*(x-box.getMinX())/box.getLengthX()), 0, width-1);
-    int iz = Math::clamp(int( height*(z-box.getMinZ())/box.getLengthZ()), 0, height-1);
-    float result = data[iz][ix];
+    if(isStreaming()) {
+        std::shared_ptr<const Tile> tile;
+        uint key = 0;
+        return getInterpolatedHeight(x, z, tile, key);
+    }
+    float result = data[getSampleZ(z)][getSampleX(x)];
     return result;
-}
\ No newline at end of file
+}
+
+void HeightMapTif::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    if(!isStreaming()) {
+        HeightFunction::getHeightsAt(x, z, out, count);
+        return;
+    }
+    // consecutive samples mostly fall in the same tile, keep it between iterations
+    std::shared_ptr<const Tile> tile;
+    uint key = 0;
+    for(size_t i = 0; i < count; ++i) {
+        out[i] = getInterpolatedHeight(x[i], z[i], tile, key);
+    }
+}
@@ -0,0 +1,62 @@
+#include "math.hpp"
+
+// one node for every PerlinNoise, generating is const and thread safe
+static const FastNoise::SmartNode<FastNoise::Perlin> &getGenerator() {
+    static FastNoise::SmartNode<FastNoise::Perlin> generator = FastNoise::New<FastNoise::Perlin>();
+    return generator;
+}
+
+// FastNoise2 and stb_perlin have different gradients, the values at a point don't match but the
+// spread does once scaled. The scale is measured once against stb on a fixed set of points
+static float getCalibration() {
+    static float scale = []() {
+        const int side = 24;
+        std::vector<float> x, y, z;
+        for(int i = 0; i < side; ++i) {
+            for(int j = 0; j < side; ++j) {
+                for(int k = 0; k < side; ++k) {
+                    // off the lattice, both are 0 on it
+                    x.push_back(i * 0.731f + 0.137f);
+                    y.push_back(j * 0.593f + 0.311f);
+                    z.push_back(k * 0.677f + 0.419f);
+                }
+            }
+        }
+        std::vector<float> fast(x.size());
+        getGenerator()->GenPositionArray3D(fast.data(), (int) x.size(), x.data(), y.data(), z.data(), 0.0f, 0.0f, 0.0f, 0);
+        double stbSquares = 0.0, fastSquares = 0.0;
+        for(size_t i = 0; i < x.size(); ++i) {
+            float reference = stb_perlin_noise3(x[i], y[i], z[i], 0, 0, 0);
+            stbSquares += reference * reference;
+            fastSquares += fast[i] * fast[i];
+        }
+        return fastSquares > 0.0 ? (float) std::sqrt(stbSquares / fastSquares) : 1.0f;
+    }();
+    return scale;
+}
+
+PerlinNoise::PerlinNoise(int seed) : seed(seed), scale(getCalibration()) {
+
+}
+
+// FastNoise2 works at unit frequency, callers scale the positions themselves
+float PerlinNoise::get(float x, float y, float z) const {
+    return getGenerator()->GenSingle3D(x, y, z, seed) * scale;
+}
+
+void PerlinNoise::get(const float * x, const float * y, const float * z, float * out, size_t count) const {
+    if(count == 0) {
+        return;
+    }
+    getGenerator()->GenPositionArray3D(out, (int) count, x, y, z, 0.0f, 0.0f, 0.0f, seed);
+    for(size_t i = 0; i < count; ++i) {
+        out[i] *= scale;
+    }
+}
+
+// stb_perlin_noise3_seed at the same points, the basis PerlinNoise is calibrated against
+void PerlinNoise::getReference(const float * x, const float * y, const float * z, float * out, size_t count) const {
+    for(size_t i = 0; i < count; ++i) {
+        out[i] = stb_perlin_noise3_seed(x[i], y[i], z[i], 0, 0, 0, seed);
+    }
+}
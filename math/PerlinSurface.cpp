@@ -2,15 +2,34 @@
 
 
 
-PerlinSurface::PerlinSurface(float amplitude, float frequency, float offset) {
+PerlinSurface::PerlinSurface(float amplitude, float frequency, float offset, int seed) {
     this->amplitude = amplitude;
     this->frequency = frequency;
     this->offset = offset;
+    this->seed = seed;
 }
 
 float PerlinSurface::getHeightAt(float x, float z) const {
 
-    float noise = stb_perlin_noise3(x* frequency, 0, z*frequency, 0, 0, 0);
+    float noise = PerlinNoise(seed).get(x* frequency, 0, z*frequency);
     noise = offset + amplitude * noise;
     return noise;
 }
+
+void PerlinSurface::getHeightsAt(const float * x, const float * z, float * out, size_t count) const {
+    PerlinNoise perlin(seed);
+    float sx[NOISE_BATCH_SIZE], sz[NOISE_BATCH_SIZE];
+    // the y=0 slice of the 3d noise, like getHeightAt
+    float sy[NOISE_BATCH_SIZE] = {};
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        for(size_t i = 0; i < n; ++i) {
+            sx[i] = x[start + i] * frequency;
+            sz[i] = z[start + i] * frequency;
+        }
+        perlin.get(sx, sy, sz, out + start, n);
+        for(size_t i = 0; i < n; ++i) {
+            out[start + i] = offset + amplitude * out[start + i];
+        }
+    }
+}
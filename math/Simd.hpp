@@ -0,0 +1,135 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Minimal float lane type for the batched SDF kernels.
+// Same kernel source compiles to AVX2 (8 lanes), SSE2 (4 lanes) or plain scalar (1 lane)
+// depending on the target flags (make release builds with -march=native).
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_NAME "avx2"
+
+struct vmask {
+    __m256 v;
+    vmask(__m256 v) : v(v) {}
+};
+
+struct vfloat {
+    static constexpr int width = 8;
+    __m256 v;
+    vfloat() : v(_mm256_setzero_ps()) {}
+    vfloat(__m256 v) : v(v) {}
+    vfloat(float f) : v(_mm256_set1_ps(f)) {}
+    static vfloat load(const float * p) { return _mm256_loadu_ps(p); }
+    void store(float * p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a.v, b.v); }
+inline vfloat vabs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a.v); }
+inline vfloat vfloor(vfloat a) { return _mm256_floor_ps(a.v); }
+inline vmask operator<(vfloat a, vfloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline vmask operator<=(vfloat a, vfloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline vmask operator>(vfloat a, vfloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline vmask operator>=(vfloat a, vfloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline vmask operator&(vmask a, vmask b) { return _mm256_and_ps(a.v, b.v); }
+inline vmask operator|(vmask a, vmask b) { return _mm256_or_ps(a.v, b.v); }
+inline vmask operator!(vmask a) { return _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+// a where mask is set, b elsewhere
+inline vfloat vselect(vmask m, vfloat a, vfloat b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_NAME "sse2"
+
+struct vmask {
+    __m128 v;
+    vmask(__m128 v) : v(v) {}
+};
+
+struct vfloat {
+    static constexpr int width = 4;
+    __m128 v;
+    vfloat() : v(_mm_setzero_ps()) {}
+    vfloat(__m128 v) : v(v) {}
+    vfloat(float f) : v(_mm_set1_ps(f)) {}
+    static vfloat load(const float * p) { return _mm_loadu_ps(p); }
+    void store(float * p) const { _mm_storeu_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a.v, b.v); }
+inline vfloat vabs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a.v); }
+inline vmask operator<(vfloat a, vfloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline vmask operator<=(vfloat a, vfloat b) { return _mm_cmple_ps(a.v, b.v); }
+inline vmask operator>(vfloat a, vfloat b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline vmask operator>=(vfloat a, vfloat b) { return _mm_cmpge_ps(a.v, b.v); }
+inline vmask operator&(vmask a, vmask b) { return _mm_and_ps(a.v, b.v); }
+inline vmask operator|(vmask a, vmask b) { return _mm_or_ps(a.v, b.v); }
+inline vmask operator!(vmask a) { return _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+inline vfloat vselect(vmask m, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+inline vfloat vfloor(vfloat a) {
+    // SSE2 has no floor, truncate and fix the negative values
+    vfloat t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return t - vselect(a < t, vfloat(1.0f), vfloat(0.0f));
+}
+
+#else
+#include <cmath>
+#include <algorithm>
+#define SIMD_NAME "scalar"
+
+struct vmask {
+    bool v;
+    vmask(bool v) : v(v) {}
+};
+
+struct vfloat {
+    static constexpr int width = 1;
+    float v;
+    vfloat() : v(0.0f) {}
+    vfloat(float f) : v(f) {}
+    static vfloat load(const float * p) { return *p; }
+    void store(float * p) const { *p = v; }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return a.v + b.v; }
+inline vfloat operator-(vfloat a, vfloat b) { return a.v - b.v; }
+inline vfloat operator*(vfloat a, vfloat b) { return a.v * b.v; }
+inline vfloat operator/(vfloat a, vfloat b) { return a.v / b.v; }
+inline vfloat operator-(vfloat a) { return -a.v; }
+inline vfloat vmin(vfloat a, vfloat b) { return std::min(a.v, b.v); }
+inline vfloat vmax(vfloat a, vfloat b) { return std::max(a.v, b.v); }
+inline vfloat vabs(vfloat a) { return std::fabs(a.v); }
+inline vfloat vsqrt(vfloat a) { return std::sqrt(a.v); }
+inline vfloat vfloor(vfloat a) { return std::floor(a.v); }
+inline vmask operator<(vfloat a, vfloat b) { return a.v < b.v; }
+inline vmask operator<=(vfloat a, vfloat b) { return a.v <= b.v; }
+inline vmask operator>(vfloat a, vfloat b) { return a.v > b.v; }
+inline vmask operator>=(vfloat a, vfloat b) { return a.v >= b.v; }
+inline vmask operator&(vmask a, vmask b) { return a.v && b.v; }
+inline vmask operator|(vmask a, vmask b) { return a.v || b.v; }
+inline vmask operator!(vmask a) { return !a.v; }
+inline vfloat vselect(vmask m, vfloat a, vfloat b) { return m.v ? a : b; }
+
+#endif
+
+inline vfloat vclamp(vfloat x, vfloat lo, vfloat hi) { return vmin(vmax(x, lo), hi); }
+inline vfloat vlength(vfloat x, vfloat y) { return vsqrt(x * x + y * y); }
+inline vfloat vlength(vfloat x, vfloat y, vfloat z) { return vsqrt(x * x + y * y + z * z); }
+// same as glm::sign, 0 stays 0
+inline vfloat vsign(vfloat x) { return vselect(x > vfloat(0.0f), vfloat(1.0f), vselect(x < vfloat(0.0f), vfloat(-1.0f), vfloat(0.0f))); }
+
+#endif
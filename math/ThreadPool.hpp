@@ -11,6 +11,8 @@
 #include <functional>
 #include <stdexcept>
 #include <type_traits>
+#include <algorithm>
+#include <iostream>
 
 class ThreadPool {
 public:
@@ -22,6 +24,8 @@ public:
     auto enqueue(F&& f, Args&&... args) 
         -> std::future<std::invoke_result_t<F, Args...>>;
     size_t threadCount() const;
+    // One pool per process, trees, scenes and loaders share its workers
+    static ThreadPool &shared();
 
 private:
     // Worker threads
@@ -78,6 +82,12 @@ inline size_t ThreadPool::threadCount() const
     return workers.size();
 }
 
+inline ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
 // Enqueue a new task
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args)
@@ -25,8 +25,14 @@
 #include <algorithm>
 #include <gdal/gdal_priv.h>
 #include <gdal/cpl_conv.h> // For CPLFree
+#include <FastNoise/FastNoise.h>
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
 
 #define INFO_TYPE_FILE 99
+#define NOISE_BATCH_SIZE 64
+// largest relative spread difference between PerlinNoise and stb_perlin the bench accepts
+#define NOISE_TOLERANCE 0.05f
 #define INFO_TYPE_REMOVE 0
 #define DISCARD_BRUSH_INDEX -1
 
@@ -412,24 +418,54 @@ class HeightFunction {
 	public:
 	    virtual ~HeightFunction() {}  
 		virtual float getHeightAt(float x, float z) const = 0;
+		virtual void getHeightsAt(const float * x, const float * z, float * out, size_t count) const;
+		// lowest and highest height over the XZ footprint of the cube, unbounded when unknown
+		virtual glm::vec2 getHeightRangeBetween(const BoundingCube &cube) const;
 		glm::vec3 getNormal(float x, float z, float delta) const;
 
 };
 
 
+#define HEIGHTMAP_CACHE_TILE 64
+
+// Samples are stored column by column (x major) in one 64 byte aligned buffer,
+// filled in HEIGHTMAP_CACHE_TILE x HEIGHTMAP_CACHE_TILE tiles on a thread pool.
+// Each tile also keeps the min/max of its samples for getHeightRangeBetween.
 class CachedHeightMapSurface : public HeightFunction {
 	public:
-		std::vector<std::vector<float>> data; 
+		float * data; 
 		BoundingBox box;
 		int width;
 		int height;
+		int tilesX;
+		int tilesZ;
+		std::vector<glm::vec2> tileRanges;
 
 
-	CachedHeightMapSurface(const HeightFunction &function, BoundingBox box,  float delta);
+	// progress receives (tiles done, total tiles) on the calling thread, pool NULL uses ThreadPool::shared().
+	// Blocks on the pool futures, never build one from a task running on that pool
+	CachedHeightMapSurface(const HeightFunction &function, BoundingBox box,  float delta, ThreadPool * pool = NULL, std::function<void(int, int)> progress = NULL);
+	CachedHeightMapSurface(const CachedHeightMapSurface &) = delete;
+	CachedHeightMapSurface &operator=(const CachedHeightMapSurface &) = delete;
+	~CachedHeightMapSurface();
 	float getData(int x, int z) const;
 	float getHeightAt(float x, float z) const override;
-	glm::vec2 getHeightRangeBetween(const BoundingCube &cube, int range) const ;
+	void getHeightsAt(const float * x, const float * z, float * out, size_t count) const override;
+	glm::vec2 getHeightRangeBetween(const BoundingCube &cube) const override;
+
+};
 
+// Perlin noise generated by FastNoise2, scaled to the spread of stb_perlin. The array version
+// runs SIMD inside the library so callers should gather their points and ask for them all at once.
+class PerlinNoise {
+	int seed;
+	float scale;
+
+	public:
+	PerlinNoise(int seed);
+	float get(float x, float y, float z) const;
+	void get(const float * x, const float * y, const float * z, float * out, size_t count) const;
+	void getReference(const float * x, const float * y, const float * z, float * out, size_t count) const;
 };
 
 class PerlinSurface : public HeightFunction {
@@ -437,26 +473,30 @@ class PerlinSurface : public HeightFunction {
 	float amplitude;
 	float frequency;
 	float offset;
+	int seed;
 
 
-	PerlinSurface(float amplitude, float frequency, float offset);
+	PerlinSurface(float amplitude, float frequency, float offset, int seed = 0);
 	float getHeightAt(float x, float z) const override;
+	void getHeightsAt(const float * x, const float * z, float * out, size_t count) const override;
 
 };
 
 class FractalPerlinSurface : public PerlinSurface {
 	public:
 	using PerlinSurface::PerlinSurface;
-	FractalPerlinSurface(float amplitude, float frequency, float offset);
+	FractalPerlinSurface(float amplitude, float frequency, float offset, int seed = 0);
 	float getHeightAt(float x, float z) const override;
+	void getHeightsAt(const float * x, const float * z, float * out, size_t count) const override;
 };
 
 
 class GradientPerlinSurface : public PerlinSurface {
 	public:
 
-	GradientPerlinSurface(float amplitude, float frequency, float offset);
+	GradientPerlinSurface(float amplitude, float frequency, float offset, int seed = 0);
 	float getHeightAt(float x, float z) const override;
+	void getHeightsAt(const float * x, const float * z, float * out, size_t count) const override;
 };
 
 class HeightMap: public BoundingBox  {
@@ -469,9 +509,19 @@ class HeightMap: public BoundingBox  {
 	public: 
 		HeightMap(const HeightFunction &func, BoundingBox box, float step);
 		float distance(const glm::vec3 p) const;
+		void distance(const float * x, const float * y, const float * z, float * out, size_t count) const;
+		glm::vec2 getHeightRange(const BoundingCube &cube) const;
 };
 
 
+#define HEIGHTMAP_TIF_MIN_TILE 256
+#define HEIGHTMAP_TIF_PREFETCH 4
+
+// GeoTIFF heights, nearest sample.
+// With cacheBytes == 0 the whole band is read upfront (data).
+// Otherwise the file stays open and tiles made of whole GDAL blocks are read on demand
+// into an LRU cache of at most cacheBytes. Misses prefetch the next tiles in Z order,
+// the same order Octree::shape visits the XZ plane (x is the high bit of the child index).
 class HeightMapTif : public HeightFunction {
 	public:
 	std::vector<std::vector<float>> data; 
@@ -480,9 +530,58 @@ class HeightMapTif : public HeightFunction {
 	int width;
 	int height;
 	int sizePerTile;
-		HeightMapTif(const std::string & filename, BoundingBox box, int sizePerTile, float verticalScale, float verticalShift);
+		HeightMapTif(const std::string & filename, BoundingBox box, int sizePerTile, float verticalScale, float verticalShift, size_t cacheBytes = 0);
+		~HeightMapTif();
 		float getHeightAt(float x, float z) const override;
+		void getHeightsAt(const float * x, const float * z, float * out, size_t count) const override;
+		bool isStreaming() const;
+		size_t getTileReads() const;
 
+	private:
+	struct Tile {
+		int width;
+		int height;
+		std::vector<float> values;
+	};
+	typedef std::list<uint>::iterator LruPosition;
+
+	GDALDataset * dataset = NULL;
+	GDALRasterBand * band = NULL;
+	float verticalScale;
+	float verticalShift;
+	double noDataValue = 0;
+	bool hasNoData = false;
+	int tileWidth = 0;
+	int tileHeight = 0;
+	int tilesX = 0;
+	int tilesZ = 0;
+	size_t maxTiles = 0;
+	int latticeWidth = 0;
+	int latticeHeight = 0;
+
+	mutable std::mutex cacheMutex;
+	mutable std::list<uint> lru;
+	mutable tsl::robin_map<uint, std::pair<std::shared_ptr<const Tile>, LruPosition>> tiles;
+	mutable std::mutex ioMutex;
+	mutable std::atomic<size_t> tileReads{0};
+
+	mutable std::mutex prefetchMutex;
+	mutable std::condition_variable prefetchCondition;
+	mutable std::deque<uint> prefetchQueue;
+	bool prefetchStop = false;
+	std::thread prefetchThread;
+
+	void openStreaming(const std::string &filename, size_t cacheBytes);
+	int getSampleX(float x) const;
+	int getSampleZ(float z) const;
+	std::shared_ptr<const Tile> findTile(uint key) const;
+	std::shared_ptr<const Tile> loadTile(uint key) const;
+	std::shared_ptr<const Tile> getTile(uint key, bool prefetch) const;
+	void prefetchAfter(uint key) const;
+	void prefetchLoop();
+	float getStreamedHeight(int ix, int iz, std::shared_ptr<const Tile> &tile, uint &tileKey) const;
+	float getLatticeHeight(int i, int j, std::shared_ptr<const Tile> &tile, uint &tileKey) const;
+	float getInterpolatedHeight(float x, float z, std::shared_ptr<const Tile> &tile, uint &tileKey) const;
 };
 
 class Geometry
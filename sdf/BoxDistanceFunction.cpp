@@ -10,6 +10,25 @@ float BoxDistanceFunction::distance(const glm::vec3 &p, const Transformation &mo
     return SDF::box(pos, model.scale);
 }
 
+void BoxDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 len = model.scale;
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat qx = vabs(px) - len.x;
+        vfloat qy = vabs(py) - len.y;
+        vfloat qz = vabs(pz) - len.z;
+        vfloat outside = vlength(vmax(qx, 0.0f), vmax(qy, 0.0f), vmax(qz, 0.0f));
+        vfloat inside = vmin(vmax(qx, vmax(qy, qz)), 0.0f);
+        (outside + inside).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType BoxDistanceFunction::getType() const {
     return SdfType::BOX;
 }
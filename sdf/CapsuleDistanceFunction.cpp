@@ -12,6 +12,32 @@ float CapsuleDistanceFunction::distance(const glm::vec3 &p, const Transformation
     return SDF::capsule(pos/model.scale, a, b, radius);
 }
 
+void CapsuleDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, model.translate);
+    glm::vec3 scale = model.scale;
+    glm::vec3 ba = b - a;
+    float invBaBa = 1.0f / glm::dot(ba, ba);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat pax = px / scale.x - a.x;
+        vfloat pay = py / scale.y - a.y;
+        vfloat paz = pz / scale.z - a.z;
+        vfloat h = vclamp((pax * ba.x + pay * ba.y + paz * ba.z) * invBaBa, 0.0f, 1.0f);
+        vfloat d = vlength(pax - h * ba.x, pay - h * ba.y, paz - h * ba.z) - radius;
+        d.store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
+// distance is taken in the scaled space, not corrected by the smallest axis like the others
+float CapsuleDistanceFunction::getLipschitz(const Transformation &model) const {
+    return 1.0f / glm::min(glm::min(model.scale.x, model.scale.y), model.scale.z);
+}
+
 SdfType CapsuleDistanceFunction::getType() const {
     return SdfType::CAPSULE;
 }
@@ -19,6 +19,31 @@ float ConeDistanceFunction::distance(const glm::vec3 &p, const Transformation &m
     return d * minScale;
 }
 
+void ConeDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 scale = model.scale;
+    float minScale = glm::min(glm::min(scale.x, scale.y), scale.z);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        // SDF::cone with q = (1,-1) folded in
+        vfloat wx = vlength(px / scale.x, pz / scale.z);
+        vfloat wy = py / scale.y - 1.0f;
+        vfloat t = vclamp((wx - wy) * 0.5f, 0.0f, 1.0f);
+        vfloat ax = wx - t;
+        vfloat ay = wy + t;
+        vfloat bx = wx - vclamp(wx, 0.0f, 1.0f);
+        vfloat by = wy + 1.0f;
+        vfloat d = vmin(ax * ax + ay * ay, bx * bx + by * by);
+        vfloat s = vmax(wx + wy, -(wy + 1.0f));
+        (vsqrt(d) * vsign(s) * minScale).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType ConeDistanceFunction::getType() const {
     return SdfType::CONE;
 }
@@ -19,6 +19,24 @@ float CylinderDistanceFunction::distance(const glm::vec3 &p, const Transformatio
     return d * minScale;
 }
 
+void CylinderDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 scale = model.scale;
+    float minScale = glm::min(glm::min(scale.x, scale.y), scale.z);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat dx = vlength(px / scale.x, pz / scale.z) - 0.5f;
+        vfloat dy = vabs(py / scale.y) - 1.0f;
+        vfloat d = vmin(vmax(dx, dy), 0.0f) + vlength(vmax(dx, 0.0f), vmax(dy, 0.0f));
+        (d * minScale).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType CylinderDistanceFunction::getType() const {
     return SdfType::CYLINDER;
 }
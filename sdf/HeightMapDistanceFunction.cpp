@@ -20,6 +20,38 @@ float HeightMapDistanceFunction::distance(const glm::vec3 &p, const Transformati
     return d;
 }
 
+void HeightMapDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    // heights first (one batch call into the height function), then the bounding box on top
+    map->distance(x, y, z, out, count);
+
+    glm::vec3 len = map->getLength()*0.5f;
+    glm::vec3 offset = model.translate - map->getCenter();
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat qx = vabs(vfloat::load(x + i) + offset.x) - len.x;
+        vfloat qy = vabs(vfloat::load(y + i) + offset.y) - len.y;
+        vfloat qz = vabs(vfloat::load(z + i) + offset.z) - len.z;
+        vfloat box = vlength(vmax(qx, 0.0f), vmax(qy, 0.0f), vmax(qz, 0.0f)) + vmin(vmax(qx, vmax(qy, qz)), 0.0f);
+        vmax(box, vfloat::load(out + i)).store(out + i);
+    }
+    for(; i < count; ++i) {
+        glm::vec3 pos = glm::vec3(x[i], y[i], z[i]) + offset;
+        out[i] = SDF::opIntersection(SDF::box(pos, len), out[i]);
+    }
+}
+
+// y - height isn't Lipschitz, bound it with the height range under the cube instead
+glm::vec2 HeightMapDistanceFunction::getDistanceRange(const BoundingCube &cube, const Transformation &model) {
+    glm::vec2 heights = map->getHeightRange(cube);
+    glm::vec2 range = glm::vec2(cube.getMinY() - heights.y, cube.getMaxY() - heights.x);
+
+    // the bounding box is exact
+    glm::vec3 len = map->getLength()*0.5f;
+    float box = SDF::box(cube.getCenter() - map->getCenter() + model.translate, len);
+    float radius = glm::length(cube.getLength()) * 0.5f;
+    return glm::vec2(glm::max(box - radius, range.x), glm::max(box + radius, range.y));
+}
+
 SdfType HeightMapDistanceFunction::getType() const {
     return SdfType::HEIGHTMAP; 
 }
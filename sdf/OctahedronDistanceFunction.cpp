@@ -17,6 +17,37 @@ float OctahedronDistanceFunction::distance(const glm::vec3 &p, const Transformat
     return d * minScale;
 }
 
+void OctahedronDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 scale = model.scale;
+    float minScale = glm::min(glm::min(scale.x, scale.y), scale.z);
+    const float s = 1.0f;
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat ax = vabs(px / scale.x);
+        vfloat ay = vabs(py / scale.y);
+        vfloat az = vabs(pz / scale.z);
+        vfloat m = ax + ay + az - s;
+
+        // same branches as SDF::octahedron, resolved with selects
+        vmask c1 = ax * 3.0f < m;
+        vmask c2 = (!c1) & (ay * 3.0f < m);
+        vmask c3 = (!c1) & (!c2) & (az * 3.0f < m);
+        vfloat qx = vselect(c1, ax, vselect(c2, ay, az));
+        vfloat qy = vselect(c1, ay, vselect(c2, az, ax));
+        vfloat qz = vselect(c1, az, vselect(c2, ax, ay));
+
+        vfloat k = vclamp((qz - qy + s) * 0.5f, 0.0f, s);
+        vfloat d = vselect(c1 | c2 | c3, vlength(qx, qy - s + k, qz - k), m * 0.57735027f);
+        (d * minScale).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType OctahedronDistanceFunction::getType() const {
     return SdfType::OCTAHEDRON;
 }
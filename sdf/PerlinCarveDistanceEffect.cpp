@@ -14,12 +14,29 @@ const char* WrappedPerlinCarveDistanceEffect::getLabel() const {
 
 float WrappedPerlinCarveDistanceEffect::distance(const glm::vec3 &p, const Transformation &model) {
     float d = function->distance(p, model);
-    float noise = SDF::distortedCarveFractalSDF(p+offset, threshold, frequency, 6, 2.0f, 0.5f);
+    float noise = SDF::distortedCarveFractalSDF(p+offset, threshold, frequency, 6, 2.0f, 0.5f, 0);
     noise = Math::brightnessAndContrast(noise, brightness, contrast);
 
     return d + noise * amplitude;
 }
 
+void WrappedPerlinCarveDistanceEffect::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    float px[NOISE_BATCH_SIZE], py[NOISE_BATCH_SIZE], pz[NOISE_BATCH_SIZE], noise[NOISE_BATCH_SIZE];
+    function->distanceBatch(x, y, z, out, count, model);
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        for(size_t i = 0; i < n; ++i) {
+            px[i] = x[start + i] + offset.x;
+            py[i] = y[start + i] + offset.y;
+            pz[i] = z[start + i] + offset.z;
+        }
+        SDF::distortedCarveFractalSDF(px, py, pz, noise, n, threshold, frequency, 6, 2.0f, 0.5f, 0);
+        for(size_t i = 0; i < n; ++i) {
+            out[start + i] += Math::brightnessAndContrast(noise[i], brightness, contrast) * amplitude;
+        }
+    }
+}
+
 ContainmentType WrappedPerlinCarveDistanceEffect::check(const BoundingCube &cube, const Transformation &model, float bias) const {
     return WrappedSignedDistanceEffect::check(cube, model, bias+amplitude);
 };
\ No newline at end of file
@@ -13,7 +13,7 @@ const char* WrappedPerlinDistortDistanceEffect::getLabel() const {
 }
 
 float WrappedPerlinDistortDistanceEffect::distance(const glm::vec3 &p, const Transformation &model) {
-    glm::vec3 noise = SDF::distortPerlinFractal(p+offset, frequency, 6, 2.0f, 0.5f);
+    glm::vec3 noise = SDF::distortPerlinFractal(p+offset, frequency, 6, 2.0f, 0.5f, 0);
     noise.x = Math::brightnessAndContrast(noise.x, brightness, contrast);
     noise.y = Math::brightnessAndContrast(noise.y, brightness, contrast);
     noise.z = Math::brightnessAndContrast(noise.z, brightness, contrast);
@@ -23,6 +23,27 @@ float WrappedPerlinDistortDistanceEffect::distance(const glm::vec3 &p, const Tra
     return d;
 }
 
+void WrappedPerlinDistortDistanceEffect::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    float px[NOISE_BATCH_SIZE], py[NOISE_BATCH_SIZE], pz[NOISE_BATCH_SIZE];
+    float nx[NOISE_BATCH_SIZE], ny[NOISE_BATCH_SIZE], nz[NOISE_BATCH_SIZE];
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        for(size_t i = 0; i < n; ++i) {
+            px[i] = x[start + i] + offset.x;
+            py[i] = y[start + i] + offset.y;
+            pz[i] = z[start + i] + offset.z;
+        }
+        SDF::distortPerlinFractal(px, py, pz, nx, ny, nz, n, frequency, 6, 2.0f, 0.5f, 0);
+        // displaced positions go to the wrapped function as one batch
+        for(size_t i = 0; i < n; ++i) {
+            px[i] = x[start + i] + amplitude * Math::brightnessAndContrast(nx[i], brightness, contrast);
+            py[i] = y[start + i] + amplitude * Math::brightnessAndContrast(ny[i], brightness, contrast);
+            pz[i] = z[start + i] + amplitude * Math::brightnessAndContrast(nz[i], brightness, contrast);
+        }
+        function->distanceBatch(px, py, pz, out + start, n, model);
+    }
+}
+
 ContainmentType WrappedPerlinDistortDistanceEffect::check(const BoundingCube &cube, const Transformation &model, float bias) const {
     return WrappedSignedDistanceEffect::check(cube, model, bias+amplitude);
 };
\ No newline at end of file
@@ -1,5 +1,62 @@
 #include "SDF.hpp"
 
+// Segment from a to b with the constants of sdSegment precomputed
+struct BatchSegment {
+    glm::vec3 a;
+    glm::vec3 ba;
+    float invBaBa;
+
+    BatchSegment(const glm::vec3 &a, const glm::vec3 &b) : a(a), ba(b - a), invBaBa(1.0f / glm::dot(b - a, b - a)) {
+
+    }
+
+    vfloat distance2(vfloat px, vfloat py, vfloat pz) const {
+        vfloat pax = px - a.x;
+        vfloat pay = py - a.y;
+        vfloat paz = pz - a.z;
+        vfloat t = vclamp((pax * ba.x + pay * ba.y + paz * ba.z) * invBaBa, 0.0f, 1.0f);
+        vfloat dx = pax - t * ba.x;
+        vfloat dy = pay - t * ba.y;
+        vfloat dz = paz - t * ba.z;
+        return dx * dx + dy * dy + dz * dz;
+    }
+};
+
+// Triangle of sdTriangle with normals and edge planes precomputed.
+// dot(cross(ab, proj - a), n) == dot(p - a, cross(n, ab)) so the inside test skips the projection.
+struct BatchTriangle {
+    glm::vec3 a, b, c;
+    glm::vec3 nn;
+    glm::vec3 e0, e1, e2;
+    glm::vec3 outward;
+    BatchSegment s0, s1, s2;
+
+    BatchTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &centroid) : a(a), b(b), c(c), s0(a, b), s1(b, c), s2(c, a) {
+        glm::vec3 n = glm::cross(b - a, c - a);
+        nn = glm::normalize(n);
+        e0 = glm::cross(n, b - a);
+        e1 = glm::cross(n, c - b);
+        e2 = glm::cross(n, a - c);
+        outward = glm::dot(nn, centroid - a) > 0.0f ? -nn : nn;
+    }
+
+    vfloat distance(vfloat px, vfloat py, vfloat pz) const {
+        vfloat ax = px - a.x, ay = py - a.y, az = pz - a.z;
+        vfloat bx = px - b.x, by = py - b.y, bz = pz - b.z;
+        vfloat cx = px - c.x, cy = py - c.y, cz = pz - c.z;
+        vmask hit = ((ax * e0.x + ay * e0.y + az * e0.z) >= 0.0f) &
+                    ((bx * e1.x + by * e1.y + bz * e1.z) >= 0.0f) &
+                    ((cx * e2.x + cy * e2.y + cz * e2.z) >= 0.0f);
+        vfloat plane = vabs(ax * nn.x + ay * nn.y + az * nn.z);
+        vfloat edges = vsqrt(vmin(s0.distance2(px, py, pz), vmin(s1.distance2(px, py, pz), s2.distance2(px, py, pz))));
+        return vselect(hit, plane, edges);
+    }
+
+    vmask below(vfloat px, vfloat py, vfloat pz) const {
+        return ((px - a.x) * outward.x + (py - a.y) * outward.y + (pz - a.z) * outward.z) <= 0.0f;
+    }
+};
+
 
 PyramidDistanceFunction::PyramidDistanceFunction() {
     
@@ -20,6 +77,50 @@ float PyramidDistanceFunction::distance(const glm::vec3 &p, const Transformation
     return d * minScale;
 }
 
+void PyramidDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    const float h = 1.0f;
+    const float a = sqrt(0.5f);
+    glm::vec3 apex(0.0f, h, 0.0f);
+    glm::vec3 v0(-a, 0.0f, -a);
+    glm::vec3 v1( a, 0.0f, -a);
+    glm::vec3 v2( a, 0.0f,  a);
+    glm::vec3 v3(-a, 0.0f,  a);
+    glm::vec3 centroid = (apex + v0 + v1 + v2 + v3) / 5.0f;
+
+    // same faces and order as SDF::pyramid
+    BatchTriangle faces[6] = {
+        BatchTriangle(apex, v0, v1, centroid),
+        BatchTriangle(apex, v1, v2, centroid),
+        BatchTriangle(apex, v2, v3, centroid),
+        BatchTriangle(apex, v3, v0, centroid),
+        BatchTriangle(v0, v1, v2, centroid),
+        BatchTriangle(v2, v3, v0, centroid)
+    };
+
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 scale = model.scale;
+    float minScale = glm::min(glm::min(scale.x, scale.y), scale.z);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        px = px / scale.x;
+        py = py / scale.y;
+        pz = pz / scale.z;
+
+        vfloat dist = faces[0].distance(px, py, pz);
+        vmask inside = faces[0].below(px, py, pz);
+        for(int f = 1; f < 6; ++f) {
+            dist = vmin(dist, faces[f].distance(px, py, pz));
+            inside = inside & faces[f].below(px, py, pz);
+        }
+        (vselect(inside, -dist, dist) * minScale).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType PyramidDistanceFunction::getType() const {
     return SdfType::PYRAMID;
 }
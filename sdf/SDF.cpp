@@ -178,55 +178,73 @@ float SDF::octahedron(const glm::vec3 &p, float s ) {
   return glm::length(glm::vec3(q.x,q.y-s+k,q.z-k)); 
 }
 
-// Deterministic pseudo-random [0,1] from integer coords
-inline float randFromPerlin(const glm::ivec3& cell, float seed = 0.0f) {
-    float n = stb_perlin_noise3(
-        cell.x * 0.123f,
-        cell.y * 0.456f,
-        cell.z * 0.789f + seed,0,0,0
-    );
-    return 0.5f * (n + 1.0f); // map [-1,1] -> [0,1]
+// Safe Voronoi 3D with adjustable cell size
+float SDF::voronoi3D(const glm::vec3& p, float cellSize = 1.0f, float seed = 0.0f, int noiseSeed = 0) {
+    float d;
+    voronoi3D(&p.x, &p.y, &p.z, &d, 1, cellSize, seed, noiseSeed);
+    return d;
 }
 
-// Safe Voronoi 3D with adjustable cell size
-float SDF::voronoi3D(const glm::vec3& p, float cellSize = 1.0f, float seed = 0.0f) {
+// Same as above for many points, the 27 neighbour cells of every point
+// get their random offsets from one noise call per neighbour.
+void SDF::voronoi3D(const float * x, const float * y, const float * z, float * out, size_t count, float cellSize, float seed, int noiseSeed) {
     if (cellSize <= 0.0f) {
-        return 0.0f; // safe fallback
+        std::fill(out, out + count, 0.0f); // safe fallback
+        return;
     }
+    PerlinNoise perlin(noiseSeed);
+    float nx[NOISE_BATCH_SIZE*3], ny[NOISE_BATCH_SIZE*3], nz[NOISE_BATCH_SIZE*3], r[NOISE_BATCH_SIZE*3];
+    glm::vec3 q[NOISE_BATCH_SIZE];
+    glm::ivec3 baseCell[NOISE_BATCH_SIZE];
+    float minDist[NOISE_BATCH_SIZE];
+
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+
+        // Work in normalized lattice space
+        for(size_t i = 0; i < n; ++i) {
+            q[i] = glm::vec3(x[start + i], y[start + i], z[start + i]) / cellSize;
+            nx[i] = q[i].x;       ny[i] = q[i].y;       nz[i] = q[i].z;
+            nx[n + i] = q[i].y;   ny[n + i] = q[i].z;   nz[n + i] = q[i].x;
+            nx[2*n + i] = q[i].z; ny[2*n + i] = q[i].x; nz[2*n + i] = q[i].y;
+        }
+        // Domain warp to break grid artifacts
+        perlin.get(nx, ny, nz, r, n*3);
+        for(size_t i = 0; i < n; ++i) {
+            q[i] += 0.3f * glm::vec3(r[i], r[n + i], r[2*n + i]);
+            baseCell[i] = glm::floor(q[i]);
+            minDist[i] = 1e10f;
+        }
 
-    // Work in normalized lattice space
-    glm::vec3 q = p / cellSize;
-
-    // Domain warp to break grid artifacts
-    q += 0.3f * glm::vec3(
-        stb_perlin_noise3(q.x, q.y, q.z, 0,0,0),
-        stb_perlin_noise3(q.y, q.z, q.x, 0,0,0),
-        stb_perlin_noise3(q.z, q.x, q.y, 0,0,0)
-    );
-
-    glm::ivec3 baseCell = glm::floor(q);
-    float minDist = 1e10f;
-
-    // Check neighbors (27 cells)
-    for (int k = -1; k <= 1; k++) {
-        for (int j = -1; j <= 1; j++) {
-            for (int i = -1; i <= 1; i++) {
-                glm::ivec3 neighbor = baseCell + glm::ivec3(i, j, k);
-
-                float ox = randFromPerlin(neighbor, seed);
-                float oy = randFromPerlin(neighbor + glm::ivec3(7, 3, 5), seed + 17.0f);
-                float oz = randFromPerlin(neighbor + glm::ivec3(11, 19, 23), seed + 37.0f);
-
-                glm::vec3 cellSeed = glm::vec3(neighbor) + glm::vec3(ox, oy, oz);
-
-                float d = glm::length(q - cellSeed);
-                minDist = glm::min(minDist, d);
+        // Check neighbors (27 cells)
+        for (int k = -1; k <= 1; k++) {
+            for (int j = -1; j <= 1; j++) {
+                for (int l = -1; l <= 1; l++) {
+                    // Deterministic pseudo-random [0,1] from integer coords
+                    for(size_t i = 0; i < n; ++i) {
+                        glm::ivec3 neighbor = baseCell[i] + glm::ivec3(l, j, k);
+                        glm::ivec3 cy = neighbor + glm::ivec3(7, 3, 5);
+                        glm::ivec3 cz = neighbor + glm::ivec3(11, 19, 23);
+                        nx[i] = neighbor.x * 0.123f; ny[i] = neighbor.y * 0.456f; nz[i] = neighbor.z * 0.789f + seed;
+                        nx[n + i] = cy.x * 0.123f;   ny[n + i] = cy.y * 0.456f;   nz[n + i] = cy.z * 0.789f + seed + 17.0f;
+                        nx[2*n + i] = cz.x * 0.123f; ny[2*n + i] = cz.y * 0.456f; nz[2*n + i] = cz.z * 0.789f + seed + 37.0f;
+                    }
+                    perlin.get(nx, ny, nz, r, n*3);
+                    for(size_t i = 0; i < n; ++i) {
+                        glm::ivec3 neighbor = baseCell[i] + glm::ivec3(l, j, k);
+                        glm::vec3 offset = 0.5f * (glm::vec3(r[i], r[n + i], r[2*n + i]) + 1.0f); // map [-1,1] -> [0,1]
+                        glm::vec3 cellSeed = glm::vec3(neighbor) + offset;
+                        minDist[i] = glm::min(minDist[i], glm::length(q[i] - cellSeed));
+                    }
+                }
             }
         }
-    }
 
-    // Normalize: [0, sqrt(3)] → [0,1]
-    return minDist / sqrtf(3.0f);
+        // Normalize: [0, sqrt(3)] → [0,1]
+        for(size_t i = 0; i < n; ++i) {
+            out[start + i] = minDist[i] / sqrtf(3.0f);
+        }
+    }
 }
 
 
@@ -354,50 +372,55 @@ float SDF::cone(const glm::vec3 &p) {
     return glm::sqrt(d) * glm::sign(s);
 }
 
-glm::vec3 SDF::distortPerlin(const glm::vec3 &p, float amplitude, float frequency) {
-    float noiseX = stb_perlin_noise3(p.x*frequency, p.y*frequency, p.z*frequency, 0, 0, 0);
-    float noiseY = stb_perlin_noise3((p.x+100)*frequency, (p.y+100)*frequency, (p.z+100)*frequency, 0, 0, 0);
-    float noiseZ = stb_perlin_noise3((p.x+200)*frequency, (p.y+200)*frequency, (p.z+200)*frequency, 0, 0, 0);
+glm::vec3 SDF::distortPerlin(const glm::vec3 &p, float amplitude, float frequency, int seed) {
+    PerlinNoise perlin(seed);
+    float noiseX = perlin.get(p.x*frequency, p.y*frequency, p.z*frequency);
+    float noiseY = perlin.get((p.x+100)*frequency, (p.y+100)*frequency, (p.z+100)*frequency);
+    float noiseZ = perlin.get((p.x+200)*frequency, (p.y+200)*frequency, (p.z+200)*frequency);
     return p + amplitude * glm::vec3(noiseX, noiseY, noiseZ);
 }
 
-glm::vec3 SDF::distortPerlinFractal(const glm::vec3 &p, float frequency, int octaves, float lacunarity = 2.0f, float gain = 0.5f) {
-    glm::vec3 totalNoise(0.0f);
-    float freq = frequency;
-    float amp = 1.0f;
+glm::vec3 SDF::distortPerlinFractal(const glm::vec3 &p, float frequency, int octaves, float lacunarity = 2.0f, float gain = 0.5f, int seed = 0) {
+    glm::vec3 totalNoise;
+    distortPerlinFractal(&p.x, &p.y, &p.z, &totalNoise.x, &totalNoise.y, &totalNoise.z, 1, frequency, octaves, lacunarity, gain, seed);
+    return totalNoise;
+}
+
+void SDF::distortPerlinFractal(const float * x, const float * y, const float * z, float * outX, float * outY, float * outZ, size_t count, float frequency, int octaves, float lacunarity, float gain, int seed) {
+    PerlinNoise perlin(seed);
+    float nx[NOISE_BATCH_SIZE*3], ny[NOISE_BATCH_SIZE*3], nz[NOISE_BATCH_SIZE*3], r[NOISE_BATCH_SIZE*3];
 
     // For each axis, use different offsets to decorrelate noise
-    glm::vec3 offsetX = glm::vec3(0.0f, 0.0f, 0.0f);
-    glm::vec3 offsetY = glm::vec3(100.0f, 100.0f, 100.0f);
-    glm::vec3 offsetZ = glm::vec3(200.0f, 200.0f, 200.0f);
-
-    for (int i = 0; i < octaves; ++i) {
-        float nx = stb_perlin_noise3(
-            p.x * freq + offsetX.x,
-            p.y * freq + offsetX.y,
-            p.z * freq + offsetX.z,
-            0,0,0
-        );
-        float ny = stb_perlin_noise3(
-            p.x * freq + offsetY.x,
-            p.y * freq + offsetY.y,
-            p.z * freq + offsetY.z,
-            0,0,0
-        );
-        float nz = stb_perlin_noise3(
-            p.x * freq + offsetZ.x,
-            p.y * freq + offsetZ.y,
-            p.z * freq + offsetZ.z,
-            0,0,0
-        );
-
-        totalNoise += amp * glm::vec3(nx, ny, nz);
-
-        freq *= lacunarity; // increase frequency
-        amp *= gain;        // decrease amplitude
-    }
+    const float offsets[3] = {0.0f, 100.0f, 200.0f};
 
-    return totalNoise;
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        for(size_t i = 0; i < n; ++i) {
+            outX[start + i] = outY[start + i] = outZ[start + i] = 0.0f;
+        }
+        float freq = frequency;
+        float amp = 1.0f;
+
+        for (int o = 0; o < octaves; ++o) {
+            // the three axis in one call
+            for(uint a = 0; a < 3; ++a) {
+                for(size_t i = 0; i < n; ++i) {
+                    nx[a*n + i] = x[start + i] * freq + offsets[a];
+                    ny[a*n + i] = y[start + i] * freq + offsets[a];
+                    nz[a*n + i] = z[start + i] * freq + offsets[a];
+                }
+            }
+            perlin.get(nx, ny, nz, r, n*3);
+            for(size_t i = 0; i < n; ++i) {
+                outX[start + i] += amp * r[i];
+                outY[start + i] += amp * r[n + i];
+                outZ[start + i] += amp * r[2*n + i];
+            }
+
+            freq *= lacunarity; // increase frequency
+            amp *= gain;        // decrease amplitude
+        }
+    }
 }
 
 float SDF::distortedCarveFractalSDF(const glm::vec3 &p, 
@@ -405,29 +428,42 @@ float SDF::distortedCarveFractalSDF(const glm::vec3 &p,
                                     float frequency, 
                                     int octaves = 4, 
                                     float lacunarity = 2.0f, 
-                                    float gain = 0.5f) {
-
-    float noiseValue = 0.0f;
-    float freq = frequency;
-    float amp = 1.0f;
-    float d = 0.0f;
-
-    for (int i = 0; i < octaves; ++i) {
-        noiseValue += amp * stb_perlin_noise3(
-            p.x * freq, 
-            p.y * freq, 
-            p.z * freq, 
-            0, 0, 0
-        );
-        freq *= lacunarity;
-        amp *= gain;
-    }
+                                    float gain = 0.5f,
+                                    int seed = 0) {
+    float d;
+    distortedCarveFractalSDF(&p.x, &p.y, &p.z, &d, 1, threshold, frequency, octaves, lacunarity, gain, seed);
+    return d;
+}
 
-    if (noiseValue > threshold) {
-        d += (noiseValue - threshold);
-    }
+void SDF::distortedCarveFractalSDF(const float * x, const float * y, const float * z, float * out, size_t count, float threshold, float frequency, int octaves, float lacunarity, float gain, int seed) {
+    PerlinNoise perlin(seed);
+    float nx[NOISE_BATCH_SIZE], ny[NOISE_BATCH_SIZE], nz[NOISE_BATCH_SIZE], r[NOISE_BATCH_SIZE];
+    float noiseValue[NOISE_BATCH_SIZE];
 
-    return d;
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        std::fill(noiseValue, noiseValue + n, 0.0f);
+        float freq = frequency;
+        float amp = 1.0f;
+
+        for (int o = 0; o < octaves; ++o) {
+            for(size_t i = 0; i < n; ++i) {
+                nx[i] = x[start + i] * freq;
+                ny[i] = y[start + i] * freq;
+                nz[i] = z[start + i] * freq;
+            }
+            perlin.get(nx, ny, nz, r, n);
+            for(size_t i = 0; i < n; ++i) {
+                noiseValue[i] += amp * r[i];
+            }
+            freq *= lacunarity;
+            amp *= gain;
+        }
+
+        for(size_t i = 0; i < n; ++i) {
+            out[start + i] = noiseValue[i] > threshold ? noiseValue[i] - threshold : 0.0f;
+        }
+    }
 }
 
 float SDF::opSmoothUnion(float d1, float d2, float k) {
@@ -66,10 +66,13 @@ public:
     static float octahedron(const glm::vec3 &p, float s);
     static float pyramid(const glm::vec3 &p, float h, float a);
     static float cone(const glm::vec3 &p);
-    static float voronoi3D(const glm::vec3& p, float cellSize, float seed);
-    static glm::vec3 distortPerlin(const glm::vec3 &p, float amplitude, float frequency);
-    static glm::vec3 distortPerlinFractal(const glm::vec3 &p, float frequency, int octaves, float lacunarity, float gain);
-    static float distortedCarveFractalSDF(const glm::vec3 &p, float threshold, float frequency, int octaves, float lacunarity, float gain);
+    static float voronoi3D(const glm::vec3& p, float cellSize, float seed, int noiseSeed);
+    static void voronoi3D(const float * x, const float * y, const float * z, float * out, size_t count, float cellSize, float seed, int noiseSeed);
+    static glm::vec3 distortPerlin(const glm::vec3 &p, float amplitude, float frequency, int seed);
+    static glm::vec3 distortPerlinFractal(const glm::vec3 &p, float frequency, int octaves, float lacunarity, float gain, int seed);
+    static void distortPerlinFractal(const float * x, const float * y, const float * z, float * outX, float * outY, float * outZ, size_t count, float frequency, int octaves, float lacunarity, float gain, int seed);
+    static float distortedCarveFractalSDF(const glm::vec3 &p, float threshold, float frequency, int octaves, float lacunarity, float gain, int seed);
+    static void distortedCarveFractalSDF(const float * x, const float * y, const float * z, float * out, size_t count, float threshold, float frequency, int octaves, float lacunarity, float gain, int seed);
     static glm::vec3 getPosition(float sdf[8], const BoundingCube &cube);
     static glm::vec3 getAveragePosition(float sdf[8], const BoundingCube &cube);
     static glm::vec3 getAveragePosition2(float sdf[8], const BoundingCube &cube);
@@ -83,11 +86,58 @@ public:
     static bool isSurfaceNet2(const float sdf[8]);
 };
 
+// Rotation/translation of the model precomputed once per batch
+struct SdfBatchTransform {
+    glm::mat3 rotation;
+    glm::vec3 center;
+
+    SdfBatchTransform(const glm::quat &quaternion, const glm::vec3 &center) : rotation(glm::mat3_cast(glm::inverse(quaternion))), center(center) {
+
+    }
+
+    // pos = inverse(quaternion) * (p - center)
+    void apply(const float * x, const float * y, const float * z, vfloat &px, vfloat &py, vfloat &pz) const {
+        vfloat dx = vfloat::load(x) - center.x;
+        vfloat dy = vfloat::load(y) - center.y;
+        vfloat dz = vfloat::load(z) - center.z;
+        px = dx * rotation[0][0] + dy * rotation[1][0] + dz * rotation[2][0];
+        py = dx * rotation[0][1] + dy * rotation[1][1] + dz * rotation[2][1];
+        pz = dx * rotation[0][2] + dy * rotation[1][2] + dz * rotation[2][2];
+    }
+};
+
 class SignedDistanceFunction {
     public:
     virtual SdfType getType() const = 0; 
 	virtual float distance(const glm::vec3 &p, const Transformation &model) = 0;
     virtual glm::vec3 getCenter(const Transformation &model) const = 0;
+
+    // Batched evaluation, positions in SoA layout. Primitives override it with SIMD kernels,
+    // everything else falls back to one distance() call per point.
+    virtual void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+        for(size_t i = 0; i < count; ++i) {
+            out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+        }
+    }
+
+    // How much the distance can change per unit moved, INFINITY when unknown.
+    // The primitives are exact or scaled by their smallest axis, so 1 holds for them.
+    virtual float getLipschitz(const Transformation &model) const {
+        return 1.0f;
+    }
+
+    // Conservative [min, max] of the distance inside the cube, by default from the
+    // center distance and the Lipschitz constant. Octree::shape stops descending
+    // into cubes that are fully inside or fully outside.
+    virtual glm::vec2 getDistanceRange(const BoundingCube &cube, const Transformation &model) {
+        float lipschitz = getLipschitz(model);
+        if(std::isinf(lipschitz)) {
+            return glm::vec2(-INFINITY, INFINITY);
+        }
+        float d = distance(cube.getCenter(), model);
+        float radius = lipschitz * glm::length(cube.getLength()) * 0.5f;
+        return glm::vec2(d - radius, d + radius);
+    }
 };
 
 
@@ -143,10 +193,26 @@ class WrappedSignedDistanceFunction : public SignedDistanceFunction {
         }
     }
 
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override {
+        if(cacheEnabled) {
+            SignedDistanceFunction::distanceBatch(x, y, z, out, count, model);
+        } else {
+            function->distanceBatch(x, y, z, out, count, model);
+        }
+    }
+
     glm::vec3 getCenter(const Transformation &model) const override {
         return function->getCenter(model);
     };
 
+    float getLipschitz(const Transformation &model) const override {
+        return function->getLipschitz(model);
+    }
+
+    glm::vec2 getDistanceRange(const BoundingCube &cube, const Transformation &model) override {
+        return function->getDistanceRange(cube, model);
+    }
+
 };
 
 class SphereDistanceFunction : public SignedDistanceFunction {
@@ -154,6 +220,7 @@ class SphereDistanceFunction : public SignedDistanceFunction {
 	
 	SphereDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 };
@@ -175,6 +242,7 @@ class CylinderDistanceFunction : public SignedDistanceFunction {
 	
 	CylinderDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 };
@@ -197,6 +265,7 @@ class TorusDistanceFunction : public SignedDistanceFunction {
 
 	TorusDistanceFunction(glm::vec2 radius);
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -219,6 +288,7 @@ class BoxDistanceFunction : public SignedDistanceFunction {
 
 	BoxDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -244,6 +314,8 @@ class CapsuleDistanceFunction : public SignedDistanceFunction {
 
     CapsuleDistanceFunction(glm::vec3 a, glm::vec3 b, float r);
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
+    float getLipschitz(const Transformation &model) const override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -266,6 +338,8 @@ class HeightMapDistanceFunction : public SignedDistanceFunction {
 	HeightMap * map;
 	HeightMapDistanceFunction(HeightMap * map);
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
+    glm::vec2 getDistanceRange(const BoundingCube &cube, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -288,6 +362,7 @@ class OctahedronDistanceFunction : public SignedDistanceFunction {
  
 	OctahedronDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -310,6 +385,7 @@ class PyramidDistanceFunction : public SignedDistanceFunction {
 
 	PyramidDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -333,6 +409,7 @@ class ConeDistanceFunction : public SignedDistanceFunction {
 	
 	ConeDistanceFunction();
 	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     SdfType getType() const override; 
     glm::vec3 getCenter(const Transformation &model) const override;
 };
@@ -355,6 +432,9 @@ class WrappedSignedDistanceEffect : public WrappedSignedDistanceFunction {
     WrappedSignedDistanceEffect(WrappedSignedDistanceFunction * function);
     ~WrappedSignedDistanceEffect();
     void setFunction(WrappedSignedDistanceFunction * function);
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
+    float getLipschitz(const Transformation &model) const override;
+    glm::vec2 getDistanceRange(const BoundingCube &cube, const Transformation &model) override;
     ContainmentType check(const BoundingCube &cube, const Transformation &model, float bias) const override;
     bool isContained(const BoundingCube &cube, const Transformation &model, float bias) const override;
     float getLength(const Transformation &model, float bias) const override;
@@ -373,6 +453,7 @@ class WrappedPerlinDistortDistanceEffect : public WrappedSignedDistanceEffect {
     BoundingSphere getSphere(const Transformation &model, float bias) const;
     const char* getLabel() const override;
   	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     ContainmentType check(const BoundingCube &cube, const Transformation &model, float bias) const override;
     SdfType getType() const override { return SdfType::DISTORT_PERLIN; }
 };
@@ -389,6 +470,7 @@ class WrappedPerlinCarveDistanceEffect : public WrappedSignedDistanceEffect {
     ~WrappedPerlinCarveDistanceEffect();
     const char* getLabel() const override;
   	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     ContainmentType check(const BoundingCube &cube, const Transformation &model, float bias) const override;
     SdfType getType() const override { return SdfType::CARVE_PERLIN; }
 };
@@ -418,6 +500,7 @@ class WrappedVoronoiCarveDistanceEffect : public WrappedSignedDistanceEffect {
     BoundingSphere getSphere(const Transformation &model, float bias) const;
     const char* getLabel() const override;
   	float distance(const glm::vec3 &p, const Transformation &model) override;
+    void distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) override;
     ContainmentType check(const BoundingCube &cube, const Transformation &model, float bias) const override;
     SdfType getType() const override { return SdfType::CARVE_VORONOI; }
 };
@@ -14,6 +14,22 @@ float SphereDistanceFunction::distance(const glm::vec3 &p, const Transformation
     return (glm::length(q) - 1.0f) * glm::min(glm::min(radii.x, radii.y), radii.z);
 }
 
+void SphereDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, model.translate);
+    glm::vec3 radii = model.scale;
+    float minScale = glm::min(glm::min(radii.x, radii.y), radii.z);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat d = (vlength(px / radii.x, py / radii.y, pz / radii.z) - 1.0f) * minScale;
+        d.store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType SphereDistanceFunction::getType() const {
     return SdfType::SPHERE;
 }
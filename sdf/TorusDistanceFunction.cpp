@@ -15,6 +15,23 @@ float TorusDistanceFunction::distance(const glm::vec3 &p, const Transformation &
     return d * minScale;
 }
 
+void TorusDistanceFunction::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    SdfBatchTransform transform(model.quaternion, getCenter(model));
+    glm::vec3 scale = model.scale;
+    float minScale = glm::min(glm::min(scale.x, scale.y), scale.z);
+    size_t i = 0;
+    for(; i + vfloat::width <= count; i += vfloat::width) {
+        vfloat px, py, pz;
+        transform.apply(x + i, y + i, z + i, px, py, pz);
+        vfloat qx = vlength(px / scale.x, pz / scale.z) - radius.x;
+        vfloat d = vlength(qx, py / scale.y) - radius.y;
+        (d * minScale).store(out + i);
+    }
+    for(; i < count; ++i) {
+        out[i] = distance(glm::vec3(x[i], y[i], z[i]), model);
+    }
+}
+
 SdfType TorusDistanceFunction::getType() const {
     return SdfType::TORUS;
 }
@@ -16,10 +16,27 @@ float WrappedVoronoiCarveDistanceEffect::distance(const glm::vec3 &p, const Tran
     glm::vec3 pp = p + offset; // apply offset
     float d = function->distance(p, model);
 
-    float noise = SDF::voronoi3D(pp , cellSize, 0);
+    float noise = SDF::voronoi3D(pp , cellSize, 0, 0);
     return d - amplitude * Math::brightnessAndContrast(noise, brightness, contrast);
 }
 
+void WrappedVoronoiCarveDistanceEffect::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    float px[NOISE_BATCH_SIZE], py[NOISE_BATCH_SIZE], pz[NOISE_BATCH_SIZE], noise[NOISE_BATCH_SIZE];
+    function->distanceBatch(x, y, z, out, count, model);
+    for(size_t start = 0; start < count; start += NOISE_BATCH_SIZE) {
+        size_t n = std::min<size_t>(NOISE_BATCH_SIZE, count - start);
+        for(size_t i = 0; i < n; ++i) {
+            px[i] = x[start + i] + offset.x;
+            py[i] = y[start + i] + offset.y;
+            pz[i] = z[start + i] + offset.z;
+        }
+        SDF::voronoi3D(px, py, pz, noise, n, cellSize, 0, 0);
+        for(size_t i = 0; i < n; ++i) {
+            out[start + i] -= amplitude * Math::brightnessAndContrast(noise[i], brightness, contrast);
+        }
+    }
+}
+
 ContainmentType WrappedVoronoiCarveDistanceEffect::check(const BoundingCube &cube, const Transformation &model, float bias) const {
     return WrappedSignedDistanceEffect::check(cube, model, bias+amplitude);
 };
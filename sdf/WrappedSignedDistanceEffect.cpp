@@ -12,6 +12,20 @@ void WrappedSignedDistanceEffect::setFunction(WrappedSignedDistanceFunction * fu
     this->function = function;
 }
 
+void WrappedSignedDistanceEffect::distanceBatch(const float * x, const float * y, const float * z, float * out, size_t count, const Transformation &model) {
+    // effects override the scalar distance(), forwarding the batch to the inner function would skip them
+    SignedDistanceFunction::distanceBatch(x, y, z, out, count, model);
+}
+
+// noise can bend the distance anywhere, no bounds unless an effect knows better
+float WrappedSignedDistanceEffect::getLipschitz(const Transformation &model) const {
+    return INFINITY;
+}
+
+glm::vec2 WrappedSignedDistanceEffect::getDistanceRange(const BoundingCube &cube, const Transformation &model) {
+    return SignedDistanceFunction::getDistanceRange(cube, model);
+}
+
 ContainmentType WrappedSignedDistanceEffect::check(const BoundingCube &cube, const Transformation &model, float bias) const {
     WrappedSignedDistanceFunction * f = (WrappedSignedDistanceFunction*) function;
     return f->check(cube, model, bias);
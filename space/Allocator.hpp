@@ -1,66 +1,197 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
 #include <vector>
 #include <unordered_set>
 #include <mutex>
 #include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
+#include <climits>
 #include <stdexcept>
 #include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
 #define NDEBUG 1
 
+#define ALLOCATOR_MAGIC 0x4f435452u
+#define ALLOCATOR_DATA_OFFSET 4096
+#define ALLOCATOR_SHARDS 32
+#define ALLOCATOR_BATCH 256
+
+// Each thread gets a slot once, shards are picked by slot so that
+// threads of the same pool never share a free list (up to ALLOCATOR_SHARDS).
+inline size_t allocatorThreadSlot() {
+    static std::atomic<size_t> nextSlot{0};
+    thread_local size_t slot = nextSlot.fetch_add(1);
+    return slot;
+}
+
 template <typename T>
 class Allocator {
 private:
+    // Vive no início de cada bloco, os dados começam em ALLOCATOR_DATA_OFFSET.
+    // Os blocos estão alinhados a blockAlignment, logo ponteiro -> bloco é uma máscara.
     struct Block {
-        T* data;          // ponteiro para os elementos
+        uint magic;
         size_t startIndex; // índice global do primeiro elemento deste bloco
+        T* data;           // ponteiro para os elementos
+        const Allocator * owner;
     };
 
-    std::vector<Block> blocks;
-    std::vector<T*> freeList;
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<T*> freeList;
+    };
+
+    const size_t blockSize;
+    size_t blockAlignment;
+    size_t maxBlocks;
+
+    // append-only, readers never lock
+    std::unique_ptr<std::atomic<Block*>[]> directory;
+    std::atomic<size_t> blockCount{0};
+    // blocks replaced by commitStaged(), still mapped so stale pointers stay readable until releaseRetired()
+    std::vector<Block*> retired;
+    // blocks being restored, readers don't see them before commitStaged()
+    std::vector<Block*> staged;
+
+    // global pool refills the shards in batches and takes the excess back
+    std::mutex poolMutex;
+    std::vector<T*> pool;
+    Shard shards[ALLOCATOR_SHARDS];
+
     #ifndef NDEBUG
+    mutable std::mutex debugMutex;
     std::unordered_set<T*> deallocatedSet;
     #endif
-    const size_t blockSize;
-    size_t totalAllocated = 0;
-    mutable std::shared_mutex mutex;    
 
-    void allocateBlock() {
-        T* data = static_cast<T*>(std::malloc(blockSize * sizeof(T)));
-        if (!data) throw std::bad_alloc();
+    static size_t nextPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
 
-        blocks.push_back({ data, totalAllocated });
+    Block * blockOf(const T* ptr) const {
+        return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(blockAlignment - 1));
+    }
 
-        for (size_t i = 0; i < blockSize; ++i) {
-            freeList.push_back(&data[i]);
-            #ifndef NDEBUG
-            deallocatedSet.insert(&data[i]);
-            #endif
+    Shard &localShard() {
+        return shards[allocatorThreadSlot() % ALLOCATOR_SHARDS];
+    }
+
+    // reserve twice the alignment and trim the borders to get an aligned region
+    uintptr_t reserveRegion() const {
+        size_t reserve = blockAlignment * 2;
+        void * raw = mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + blockAlignment - 1) & ~(uintptr_t)(blockAlignment - 1);
+        if (aligned > start) munmap(raw, aligned - start);
+        uintptr_t end = start + reserve;
+        if (end > aligned + blockAlignment) munmap(reinterpret_cast<void*>(aligned + blockAlignment), end - aligned - blockAlignment);
+        return aligned;
+    }
+
+    // writes the header and makes the block visible to readers
+    Block * publishBlock(uintptr_t aligned) {
+        size_t index = blockCount.load(std::memory_order_relaxed);
+        Block * block = reinterpret_cast<Block*>(aligned);
+        block->magic = ALLOCATOR_MAGIC;
+        block->startIndex = index * blockSize;
+        block->data = reinterpret_cast<T*>(aligned + ALLOCATOR_DATA_OFFSET);
+        block->owner = this;
+        directory[index].store(block, std::memory_order_release);
+        blockCount.store(index + 1, std::memory_order_release);
+        return block;
+    }
+
+    // like publishBlock() but off the directory, the index is the position in staged
+    Block * stage(uintptr_t aligned) {
+        Block * block = reinterpret_cast<Block*>(aligned);
+        block->magic = ALLOCATOR_MAGIC;
+        block->startIndex = staged.size() * blockSize;
+        block->data = reinterpret_cast<T*>(aligned + ALLOCATOR_DATA_OFFSET);
+        block->owner = this;
+        staged.push_back(block);
+        return block;
+    }
+
+    // poolMutex must be held
+    void allocateBlock() {
+        if (blockCount.load(std::memory_order_relaxed) >= maxBlocks) throw std::bad_alloc();
+        Block * block = publishBlock(reserveRegion());
+
+        pool.reserve(pool.size() + blockSize);
+        for (size_t i = blockSize; i-- > 0;) {
+            pool.push_back(&block->data[i]);
+        }
+        #ifndef NDEBUG
+        {
+            std::lock_guard<std::mutex> debugLock(debugMutex);
+            for (size_t i = 0; i < blockSize; ++i) deallocatedSet.insert(&block->data[i]);
         }
+        #endif
+    }
+
+    void refill(Shard &shard) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (pool.empty()) allocateBlock();
+        size_t count = std::min<size_t>(ALLOCATOR_BATCH, pool.size());
+        shard.freeList.insert(shard.freeList.end(), pool.end() - count, pool.end());
+        pool.resize(pool.size() - count);
+    }
 
-        totalAllocated += blockSize;
+    void drain(Shard &shard) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        size_t count = shard.freeList.size() - ALLOCATOR_BATCH;
+        pool.insert(pool.end(), shard.freeList.end() - count, shard.freeList.end());
+        shard.freeList.resize(ALLOCATOR_BATCH);
+    }
+
+    T * lookup(uint index) const {
+        size_t blockIdx = index / blockSize;
+        if (blockIdx >= blockCount.load(std::memory_order_acquire)) {
+            throw std::runtime_error("Invalid index");
+        }
+        Block * block = directory[blockIdx].load(std::memory_order_acquire);
+        return block->data + (index % blockSize);
     }
 
 public:
     Allocator(size_t blockSize) : blockSize(blockSize) {
-        std::cout << "Allocator(" << blockSize << ")" << std::endl;
+        blockAlignment = nextPowerOfTwo(ALLOCATOR_DATA_OFFSET + blockSize * sizeof(T));
+        maxBlocks = ((size_t) UINT_MAX) / blockSize + 1;
+        directory = std::make_unique<std::atomic<Block*>[]>(maxBlocks);
+        for (size_t i = 0; i < maxBlocks; ++i) directory[i].store(NULL, std::memory_order_relaxed);
     }
 
     ~Allocator() {
-        for (auto &b : blocks) std::free(b.data);
+        size_t count = blockCount.load();
+        for (size_t i = 0; i < count; ++i) {
+            munmap(directory[i].load(), blockAlignment);
+        }
+        releaseRetired();
+        discardStaged();
     }
 
     // -------------------
     // Alocação / Liberação
     // -------------------
     T* allocate() {
-        std::unique_lock lock(mutex);
-        if (freeList.empty()) allocateBlock();
+        Shard &shard = localShard();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.freeList.empty()) refill(shard);
+
+        T* ptr = shard.freeList.back();
+        shard.freeList.pop_back();
 
-        T* ptr = freeList.back();
-        freeList.pop_back();
-        
         #ifndef NDEBUG
+        std::lock_guard<std::mutex> debugLock(debugMutex);
         if (deallocatedSet.find(ptr) == deallocatedSet.end()) {
             throw std::runtime_error("Double allocate!");
         }
@@ -71,104 +202,79 @@ public:
 
     void deallocate(T* ptr) {
         if (!ptr) return;
+        assert(blockOf(ptr)->magic == ALLOCATOR_MAGIC && blockOf(ptr)->owner == this && "Pointer does not belong to allocator");
 
-        std::unique_lock lock(mutex);
         #ifndef NDEBUG
-        if (deallocatedSet.find(ptr) != deallocatedSet.end()) {
-            throw std::runtime_error("Double deallocate!");
-        }
-        #endif
-        // check pointer belongs to a block — iterate from most-recently-added blocks
-        bool valid = false;
-        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
-            if (ptr >= it->data && ptr < it->data + blockSize) { valid = true; break; }
+        {
+            std::lock_guard<std::mutex> debugLock(debugMutex);
+            if (deallocatedSet.find(ptr) != deallocatedSet.end()) {
+                throw std::runtime_error("Double deallocate!");
+            }
+            deallocatedSet.insert(ptr);
         }
-        assert(valid && "Pointer does not belong to allocator");
-        #ifndef NDEBUG
-        deallocatedSet.insert(ptr);
         #endif
-        freeList.push_back(ptr);
+
+        Shard &shard = localShard();
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.freeList.push_back(ptr);
+        if (shard.freeList.size() > 2 * ALLOCATOR_BATCH) drain(shard);
     }
 
     // -------------------
     // Index <-> Pointer O(1)
     // -------------------
-    uint getIndex(T* ptr) {
+    uint getIndex(T* ptr) const {
         if (!ptr) return UINT_MAX;
 
-        std::shared_lock lock(mutex); // multiple allowed
-
-        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
-            if (ptr >= it->data && ptr < it->data + blockSize) {
-                return static_cast<uint>(it->startIndex + (ptr - it->data));
-            }
+        Block * block = blockOf(ptr);
+        if (block->magic != ALLOCATOR_MAGIC || block->owner != this) {
+            throw std::runtime_error("Pointer does not belong to allocator");
         }
-        throw std::runtime_error("Pointer does not belong to allocator");
+        return static_cast<uint>(block->startIndex + (ptr - block->data));
     }
 
-    T* getFromIndex(uint index) {
+    T* getFromIndex(uint index) const {
         if (index == UINT_MAX) return nullptr;
+        T* ptr = lookup(index);
 
-        std::shared_lock lock(mutex); // multiple allowed
-        uint blockIdx = index / blockSize;
-        if (blockIdx >= blocks.size()) {
-            throw std::runtime_error("Invalid index");
-        }
-        uint offset = index % blockSize;
-
-        Block& b = blocks[blockIdx];
-        
-        T* ptr = b.data + offset;
-        
         #ifndef NDEBUG
+        std::lock_guard<std::mutex> debugLock(debugMutex);
         if (deallocatedSet.find(ptr) != deallocatedSet.end()) {
             throw std::runtime_error("Accessing deallocated pointer");
         }
         #endif
- 
+
         return ptr;
-        //throw std::runtime_error("Invalid index");
     }
 
-
-    void getFromIndices(T * nodes[8], uint indices[8]) {
-        std::shared_lock lock(mutex); // multiple allowed        
-        
+    void getFromIndices(T * nodes[8], uint indices[8]) const {
         for(int i = 0 ; i < 8 ; ++i) {
-            uint index = indices[i];
-            if (index == UINT_MAX) {
-                nodes[i] = NULL;
-                continue;
-            }
-
-            uint blockIdx = index / blockSize;
-            if (blockIdx >= blocks.size()) {
-                throw std::runtime_error("Invalid index");
-            }
-            uint offset = index % blockSize;
-            T* ptr = &blocks[blockIdx].data[offset];
-            
-            #ifndef NDEBUG
-            if (deallocatedSet.find(ptr) != deallocatedSet.end()) {
-                throw std::runtime_error("Accessing deallocated pointer");
-            }
-            #endif
-     
-            nodes[i] = ptr;
+            nodes[i] = getFromIndex(indices[i]);
         }
-      
     }
 
+    // not safe while other threads allocate, nothing from before the reset is read after it
     void reset() {
-        std::unique_lock lock(mutex);
-        freeList.clear();
+        releaseRetired();
+        // same lock order as allocate(): shard first, then pool
+        std::vector<std::unique_lock<std::mutex>> shardLocks;
+        for (Shard &shard : shards) {
+            shardLocks.emplace_back(shard.mutex);
+            shard.freeList.clear();
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        pool.clear();
         #ifndef NDEBUG
+        std::lock_guard<std::mutex> debugLock(debugMutex);
         deallocatedSet.clear();
         #endif
-        for (auto &b : blocks) {
-            for (size_t i = 0; i < blockSize; ++i) {
-                T* ptr = &b.data[i];
-                freeList.push_back(ptr);
+        size_t count = blockCount.load();
+        pool.reserve(count * blockSize);
+        for (size_t b = count; b-- > 0;) {
+            Block * block = directory[b].load();
+            for (size_t i = blockSize; i-- > 0;) {
+                T* ptr = &block->data[i];
+                pool.push_back(ptr);
                 #ifndef NDEBUG
                 deallocatedSet.insert(ptr);
                 #endif
@@ -176,15 +282,156 @@ public:
         }
     }
 
+    // For arrays that run parallel to another allocator: makes sure a block backs
+    // index and returns its slot, without ever handing it out through allocate()
+    T* at(uint index) {
+        size_t blockIdx = index / blockSize;
+        if (blockIdx >= blockCount.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(poolMutex);
+            while (blockCount.load(std::memory_order_relaxed) <= blockIdx) {
+                if (blockCount.load(std::memory_order_relaxed) >= maxBlocks) throw std::bad_alloc();
+                publishBlock(reserveRegion());
+            }
+        }
+        return lookup(index);
+    }
+
     uint allocateIndex() {
         T* ptr = allocate();
         return getIndex(ptr);
     }
 
-    size_t getAllocatedBlocksCount() {
-        std::shared_lock lock(mutex);
-        return blocks.size();
+    size_t getAllocatedBlocksCount() const {
+        return blockCount.load(std::memory_order_acquire);
     }
 
     size_t getBlockSize() const { return blockSize; }
+
+    // -------------------
+    // Images (OctreeImage), none of these are safe while other threads use the allocator
+    // -------------------
+    size_t getBlockDataSize() const { return blockSize * sizeof(T); }
+
+    const T * getBlockData(size_t index) const {
+        return directory[index].load(std::memory_order_acquire)->data;
+    }
+
+    // Stages a block for the caller to fill, it takes the next index once committed
+    T * stageBlock() {
+        return stage(reserveRegion())->data;
+    }
+
+    // Stages a block whose data is mapped from fd at offset, copy on write,
+    // so pages are only read from the file on first touch.
+    // Returns NULL when the page size doesn't allow it, use stageBlock() and read instead.
+    T * stageMappedBlock(int fd, off_t offset) {
+        long page = sysconf(_SC_PAGESIZE);
+        if (page <= 0 || ALLOCATOR_DATA_OFFSET % page != 0 || offset % page != 0) {
+            return NULL;
+        }
+        uintptr_t aligned = reserveRegion();
+        void * data = reinterpret_cast<void*>(aligned + ALLOCATOR_DATA_OFFSET);
+        if (mmap(data, getBlockDataSize(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+            munmap(reinterpret_cast<void*>(aligned), blockAlignment);
+            return NULL;
+        }
+        return stage(aligned)->data;
+    }
+
+    // Swaps the staged blocks in, starting again at index 0. The replaced blocks are retired,
+    // their slots are not free until setUsed()
+    void commitStaged() {
+        std::vector<std::unique_lock<std::mutex>> shardLocks;
+        for (Shard &shard : shards) {
+            shardLocks.emplace_back(shard.mutex);
+            shard.freeList.clear();
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        pool.clear();
+        #ifndef NDEBUG
+        {
+            std::lock_guard<std::mutex> debugLock(debugMutex);
+            deallocatedSet.clear();
+        }
+        #endif
+        if (staged.size() > maxBlocks) throw std::bad_alloc();
+        size_t count = blockCount.load();
+        for (size_t b = 0; b < count; ++b) {
+            Block * block = directory[b].load();
+            block->magic = 0;
+            retired.push_back(block);
+            directory[b].store(NULL, std::memory_order_relaxed);
+        }
+        for (size_t b = 0; b < staged.size(); ++b) {
+            directory[b].store(staged[b], std::memory_order_release);
+        }
+        blockCount.store(staged.size(), std::memory_order_release);
+        staged.clear();
+    }
+
+    // Drops the staged blocks, the allocator is left as it was
+    void discardStaged() {
+        for (Block * block : staged) {
+            munmap(block, blockAlignment);
+        }
+        staged.clear();
+    }
+
+    // Unmaps the retired blocks, only once nothing can hold a pointer into them
+    void releaseRetired() {
+        for (Block * block : retired) {
+            munmap(block, blockAlignment);
+        }
+        retired.clear();
+    }
+
+    // Rebuilds the free pool, bit i of used (word i/64) tells if index i is taken
+    void setUsed(const std::vector<uint64_t> &used) {
+        std::vector<std::unique_lock<std::mutex>> shardLocks;
+        for (Shard &shard : shards) {
+            shardLocks.emplace_back(shard.mutex);
+            shard.freeList.clear();
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        pool.clear();
+        #ifndef NDEBUG
+        {
+            std::lock_guard<std::mutex> debugLock(debugMutex);
+            deallocatedSet.clear();
+        }
+        #endif
+        size_t total = blockCount.load() * blockSize;
+        for (size_t i = total; i-- > 0;) {
+            bool taken = i / 64 < used.size() && ((used[i / 64] >> (i % 64)) & 1);
+            if (!taken) {
+                T* ptr = lookup((uint) i);
+                pool.push_back(ptr);
+                #ifndef NDEBUG
+                std::lock_guard<std::mutex> debugLock(debugMutex);
+                deallocatedSet.insert(ptr);
+                #endif
+            }
+        }
+    }
+
+    // The other way around, every index that is neither in a shard nor in the pool is taken
+    void getUsed(std::vector<uint64_t> &used) {
+        std::vector<std::unique_lock<std::mutex>> shardLocks;
+        for (Shard &shard : shards) {
+            shardLocks.emplace_back(shard.mutex);
+        }
+        std::lock_guard<std::mutex> lock(poolMutex);
+        size_t total = blockCount.load() * blockSize;
+        used.assign((total + 63) / 64, ~(uint64_t) 0);
+        auto release = [&](T* ptr) {
+            uint i = getIndex(ptr);
+            used[i / 64] &= ~(1ull << (i % 64));
+        };
+        for (Shard &shard : shards) {
+            for (T* ptr : shard.freeList) release(ptr);
+        }
+        for (T* ptr : pool) release(ptr);
+    }
 };
+
+#endif
@@ -0,0 +1,143 @@
+#include "space.hpp"
+
+ChunkMesh::ChunkMesh(const BoundingCube &cube) : cube(cube), dirty(CHUNK_MESH_ALL) {
+	this->blockLength = cube.getLengthX() / CHUNK_MESH_DIVISIONS;
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		geometries[i] = new Geometry(false);
+	}
+}
+
+ChunkMesh::~ChunkMesh() {
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		delete geometries[i];
+	}
+}
+
+static int clampBlock(int i) {
+	return glm::clamp(i, 0, CHUNK_MESH_DIVISIONS - 1);
+}
+
+int ChunkMesh::getBlockIndex(const glm::vec3 &point) const {
+	glm::ivec3 b = glm::ivec3(glm::floor((point - cube.getMin()) / blockLength));
+	return clampBlock(b.x) * CHUNK_MESH_DIVISIONS * CHUNK_MESH_DIVISIONS + clampBlock(b.y) * CHUNK_MESH_DIVISIONS + clampBlock(b.z);
+}
+
+uint64_t ChunkMesh::getBlocks(const BoundingCube &region) const {
+	glm::vec3 min = (region.getMin() - cube.getMin()) / blockLength;
+	glm::vec3 max = (region.getMax() - cube.getMin()) / blockLength;
+	if(glm::any(glm::lessThan(max, glm::vec3(0))) || glm::any(glm::greaterThan(min, glm::vec3(CHUNK_MESH_DIVISIONS)))) {
+		return 0;
+	}
+	glm::ivec3 lo = glm::ivec3(glm::floor(min));
+	glm::ivec3 hi = glm::ivec3(glm::ceil(max) - 1.0f);
+	uint64_t mask = 0;
+	for(int x = clampBlock(lo.x); x <= clampBlock(hi.x); ++x) {
+		for(int y = clampBlock(lo.y); y <= clampBlock(hi.y); ++y) {
+			for(int z = clampBlock(lo.z); z <= clampBlock(hi.z); ++z) {
+				mask |= ((uint64_t) 1) << (x * CHUNK_MESH_DIVISIONS * CHUNK_MESH_DIVISIONS + y * CHUNK_MESH_DIVISIONS + z);
+			}
+		}
+	}
+	return mask;
+}
+
+void ChunkMesh::markDirty(const BoundingCube &region) {
+	// quads of a cell use the vertices of its +x/+y/+z neighbors, so the
+	// sub-blocks right below the region have to be tesselated again too
+	BoundingCube lower(region.getMin() - glm::vec3(blockLength), region.getLengthX() + blockLength);
+	dirty.fetch_or(getBlocks(lower));
+}
+
+uint64_t ChunkMesh::takeDirty() {
+	return dirty.exchange(0);
+}
+
+void ChunkMesh::clear(uint64_t blocks) {
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		if(blocks & (((uint64_t) 1) << i)) {
+			delete geometries[i];
+			geometries[i] = new Geometry(false);
+			instances[i].clear();
+		}
+	}
+}
+
+Geometry * ChunkMesh::getGeometry(int block) {
+	return geometries[block];
+}
+
+std::vector<InstanceData> * ChunkMesh::getInstances(int block) {
+	return &instances[block];
+}
+
+// Concatenates the sub-blocks, vertices on their borders are not merged
+Geometry * ChunkMesh::buildGeometry() const {
+	Geometry * geometry = new Geometry(false);
+	size_t vertexCount = 0, indexCount = 0;
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		vertexCount += geometries[i]->vertices.size();
+		indexCount += geometries[i]->indices.size();
+	}
+	geometry->vertices.reserve(vertexCount);
+	geometry->indices.reserve(indexCount);
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		uint offset = geometry->vertices.size();
+		geometry->vertices.insert(geometry->vertices.end(), geometries[i]->vertices.begin(), geometries[i]->vertices.end());
+		for(uint index : geometries[i]->indices) {
+			geometry->indices.push_back(index + offset);
+		}
+	}
+	return geometry;
+}
+
+std::vector<InstanceData> ChunkMesh::buildInstances() const {
+	std::vector<InstanceData> result;
+	for(int i = 0; i < CHUNK_MESH_BLOCKS; ++i) {
+		result.insert(result.end(), instances[i].begin(), instances[i].end());
+	}
+	return result;
+}
+
+ChunkMeshLayer::~ChunkMeshLayer() {
+	for(auto &pair : meshes) {
+		delete pair.second;
+	}
+}
+
+ChunkMesh * ChunkMeshLayer::get(const BoundingCube &chunk) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = meshes.find(chunk.getMin());
+	if(it != meshes.end()) {
+		return it->second;
+	}
+	ChunkMesh * mesh = new ChunkMesh(chunk);
+	meshes[chunk.getMin()] = mesh;
+	return mesh;
+}
+
+void ChunkMeshLayer::markDirty(const BoundingCube &chunk, const BoundingCube &region) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = meshes.find(chunk.getMin());
+	// chunks never meshed are all dirty already
+	if(it != meshes.end()) {
+		it->second->markDirty(region);
+	}
+}
+
+void ChunkMeshLayer::erase(const BoundingCube &chunk) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = meshes.find(chunk.getMin());
+	if(it != meshes.end()) {
+		delete it->second;
+		meshes.erase(it);
+	}
+}
+
+// the whole tree was replaced, no mesh matches it anymore
+void ChunkMeshLayer::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for(auto &pair : meshes) {
+		delete pair.second;
+	}
+	meshes.clear();
+}
@@ -45,6 +45,7 @@ void IteratorHandler::iterateParallelBFS(const Octree &tree, OctreeNodeData &roo
                         NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
                     };
 
+                    tree.ensureLoaded(params.node, params.cube);
                     params.node->getChildren(*tree.allocator, children);
 
                     for (int i = 0; i < 8; ++i) {
@@ -56,13 +57,15 @@ void IteratorHandler::iterateParallelBFS(const Octree &tree, OctreeNodeData &roo
                         }
 
                         if (child != NULL && child != params.node) {
+                            float childSDF[8];
+                            child->getSDF(*tree.allocator, childSDF);
                             OctreeNodeData childData(
                                 params.level + 1,
                                 child,
                                 params.cube.getChild(j), 
                                 params.containmentType,
                                 params.context,
-                                child->sdf
+                                childSDF
                             );
 
                             queue.push(childData);
@@ -123,6 +126,7 @@ void IteratorHandler::iterateBFS(const Octree &tree, OctreeNodeData &rootParams)
                 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
             };
 
+            tree.ensureLoaded(params.node, params.cube);
             params.node->getChildren(*tree.allocator, children);
 
             for (int i = 0; i < 8; ++i) {
@@ -134,13 +138,15 @@ void IteratorHandler::iterateBFS(const Octree &tree, OctreeNodeData &rootParams)
                 }
 
                 if (child != NULL && child != params.node) {
+                    float childSDF[8];
+                    child->getSDF(*tree.allocator, childSDF);
                     OctreeNodeData childData(
                         params.level + 1,
                         child,
                         params.cube.getChild(j),
                         params.containmentType,
                         params.context,
-                        child->sdf
+                        childSDF
                     );
 
                     // BFS: push instead of recursive call
@@ -163,6 +169,7 @@ void IteratorHandler::iterateMultiThreaded(const Octree &tree, OctreeNodeData &p
             getOrder(tree, params, internalOrder);
 
             OctreeNode* children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+            tree.ensureLoaded(params.node, params.cube);
             params.node->getChildren(*tree.allocator, children);
             
             std::vector<std::thread> threads;
@@ -175,7 +182,9 @@ void IteratorHandler::iterateMultiThreaded(const Octree &tree, OctreeNodeData &p
                     throw std::runtime_error("Wrong pointer @ iter!");
                 }                
                 if(child != NULL && params.node != child) {
-                    OctreeNodeData data = OctreeNodeData( params.level+1, child, params.cube.getChild(j), params.containmentType, params.context, child->sdf);
+                    float childSDF[8];
+                    child->getSDF(*tree.allocator, childSDF);
+                    OctreeNodeData data = OctreeNodeData( params.level+1, child, params.cube.getChild(j), params.containmentType, params.context, childSDF);
                     if(!child->isChunk()) {
                         threads.emplace_back([this, &tree, &data]() {
                             this->iterateMultiThreaded(tree, data);
@@ -206,6 +215,7 @@ void IteratorHandler::iterate(const Octree &tree, OctreeNodeData &params) {
             getOrder(tree, params, internalOrder);
 
             OctreeNode* children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+            tree.ensureLoaded(params.node, params.cube);
             params.node->getChildren(*tree.allocator, children);
             for(int i=0; i <8 ; ++i) {
                 uint8_t j = internalOrder[i];
@@ -214,7 +224,9 @@ void IteratorHandler::iterate(const Octree &tree, OctreeNodeData &params) {
                     throw std::runtime_error("Wrong pointer @ iter!");
                 }                
                 if(child != NULL && params.node != child) {
-                    OctreeNodeData data = OctreeNodeData( params.level+1, child, params.cube.getChild(j), params.containmentType, params.context, child->sdf);
+                    float childSDF[8];
+                    child->getSDF(*tree.allocator, childSDF);
+                    OctreeNodeData data = OctreeNodeData( params.level+1, child, params.cube.getChild(j), params.containmentType, params.context, childSDF);
                     this->iterate(tree, data);
                 }
             }
@@ -238,6 +250,7 @@ void IteratorHandler::iterateFlatIn(const Octree &tree, OctreeNodeData &params)
         if (node != NULL && test(tree, data)) {
             getOrder(tree, data, internalOrder);
             OctreeNode* children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+            tree.ensureLoaded(node, data.cube);
             node->getChildren(*tree.allocator, children);
             for (int i = 7; i >= 0; --i) {
                 uint8_t j = internalOrder[i];
@@ -248,13 +261,15 @@ void IteratorHandler::iterateFlatIn(const Octree &tree, OctreeNodeData &params)
                 }
 
                 if (child != NULL) {
+                    float childSDF[8];
+                    child->getSDF(*tree.allocator, childSDF);
                     flatData.push(OctreeNodeData(
                         data.level + 1,
                         child,
                         data.cube.getChild(j),
                         data.containmentType,
                         data.context,
-                        child->sdf
+                        childSDF
                     ));
                 }
             }
@@ -291,11 +306,14 @@ void IteratorHandler::iterateFlat(const Octree &tree, OctreeNodeData &params) {
         if (frame.childIndex < 8) {
             uint8_t j = frame.internalOrder[frame.childIndex++];
             OctreeNode * node = frame.node;
+            tree.ensureLoaded(node, frame.cube);
             ChildBlock * block = node->getBlock(*tree.allocator);
             OctreeNode* child = block->get(j, *tree.allocator);
 
             if (child) {
-                OctreeNodeData data(frame.level+1, child, frame.cube.getChild(j), frame.containmentType, frame.context, child->sdf);
+                float childSDF[8];
+                child->getSDF(*tree.allocator, childSDF);
+                OctreeNodeData data(frame.level+1, child, frame.cube.getChild(j), frame.containmentType, frame.context, childSDF);
                 stack.push(StackFrame(data, 0, false));
             }
         } else {
@@ -337,12 +355,15 @@ void IteratorHandler::iterateFlatOut(const Octree &tree, OctreeNodeData &params)
             // in the original (correct) order when popped.
             {
                 OctreeNode* children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+                tree.ensureLoaded(frame.node, frame.cube);
                 frame.node->getChildren(*tree.allocator, children);
                 for (int i = 7; i >= 0; --i) {
                     uint8_t j = internalOrder[i];
                     OctreeNode* child = children[j];
                     if (child) {
-                        stackOut.push(StackFrameOut(OctreeNodeData(frame.level + 1, child, frame.cube.getChild(j), frame.containmentType, frame.context, child->sdf), false));
+                        float childSDF[8];
+                        child->getSDF(*tree.allocator, childSDF);
+                        stackOut.push(StackFrameOut(OctreeNodeData(frame.level + 1, child, frame.cube.getChild(j), frame.containmentType, frame.context, childSDF), false));
                     }
                 }
             }
@@ -1,4 +1,5 @@
 #include "space.hpp"
+#include <chrono>
 
 //      6-----7
 //     /|    /|
@@ -22,7 +23,7 @@ static void initialize() {
 
 Octree::Octree(BoundingCube minCube, float chunkSize) : BoundingCube(minCube), allocator(new OctreeAllocator()) {
     this->chunkSize = chunkSize;
-	this->root = allocator->allocate()->init(glm::vec3(minCube.getCenter()));
+	this->root = allocator->allocate()->init(*allocator, glm::vec3(minCube.getCenter()));
 	initialize();
 }
 
@@ -52,6 +53,7 @@ OctreeNodeLevel Octree::getNodeAt(const glm::vec3 &pos, int level, bool simplifi
         if (simplification && node->isSimplified()) {
             break;
         }
+        ensureLoaded(node, cube);
         int i = getNodeIndex(pos, cube);
         cube = cube.getChild(i);
         ChildBlock * block = node->getBlock(*allocator);
@@ -64,6 +66,49 @@ OctreeNodeLevel Octree::getNodeAt(const glm::vec3 &pos, int level, bool simplifi
     return OctreeNodeLevel(node, currentLevel);
 }
 
+// Same result as getNodeAt(pos, level, simplification), but the descent resumes from the deepest
+// node of the previous one that pos also goes through. Neighbor lookups of the tesselation share
+// almost all of their path, so most of them only walk the last one or two levels.
+OctreeNodeLevel Octree::getNodeAt(const glm::vec3 &pos, int level, bool simplification, ThreadContext * context) const {
+	if(!contains(pos)) {
+		return OctreeNodeLevel(NULL, 0);
+	}
+    std::vector<OctreePathEntry> &path = context->path;
+    uint depth = 0;
+    if(!path.empty() && path[0].node == root && context->pathSimplification == simplification) {
+        // every entry but the last was passed through, taking it again only depends on pos
+        while(depth + 1 < path.size() && (int) depth < level && getNodeIndex(pos, path[depth].cube) == path[depth].child) {
+            ++depth;
+        }
+        path.resize(depth + 1);
+    } else {
+        path.clear();
+        path.push_back(OctreePathEntry{root, *this, -1});
+        context->pathSimplification = simplification;
+    }
+
+    OctreeNode * node = path.back().node;
+    BoundingCube cube = path.back().cube;
+    int remaining = level - (int) depth;
+    while (node != NULL && remaining-- > 0) {
+        if (simplification && node->isSimplified()) {
+            break;
+        }
+        ensureLoaded(node, cube);
+        int i = getNodeIndex(pos, cube);
+        ChildBlock * block = node->getBlock(*allocator);
+        OctreeNode * candidate = block != NULL ? block->get(i, *allocator) : NULL;
+        if(candidate == NULL) {
+            break;
+        }
+        cube = cube.getChild(i);
+        path.back().child = i;
+        path.push_back(OctreePathEntry{candidate, cube, -1});
+        node = candidate;
+    }
+    return OctreeNodeLevel(node, path.size() - 1);
+}
+
 OctreeNode* Octree::getNodeAt(const glm::vec3 &pos, bool simplification) const {
     OctreeNode * candidate = root;
     OctreeNode* node = candidate;
@@ -75,6 +120,7 @@ OctreeNode* Octree::getNodeAt(const glm::vec3 &pos, bool simplification) const {
         if (simplification && node->isSimplified()) {
             break;
         }
+        ensureLoaded(node, cube);
         int i = getNodeIndex(pos, cube);
         cube = cube.getChild(i);
         ChildBlock * block = node->getBlock(*allocator);
@@ -98,6 +144,7 @@ float Octree::getSdfAt(const glm::vec3 &pos) {
     while (candidate) {
         node = candidate;
         nodeCube = candidateCube;
+        ensureLoaded(node, nodeCube);
         int i = getNodeIndex(pos, candidateCube);
         candidateCube = nodeCube.getChild(i);
         ChildBlock * block = node->getBlock(*allocator);
@@ -105,11 +152,143 @@ float Octree::getSdfAt(const glm::vec3 &pos) {
     }
 
     if(node) {
-        return SDF::interpolate(node->sdf, pos, nodeCube);
+        float sdf[8];
+        node->getSDF(*allocator, sdf);
+        return SDF::interpolate(sdf, pos, nodeCube);
     }
     std::cerr << "Not interpolated" << std::endl;
     return INFINITY;
 }
+// Range of the stored field over a cube, the bounds of the smallest node holding it.
+// Paged out chunks answer with their own bounds, nothing is loaded.
+glm::vec2 Octree::getSdfRange(const BoundingCube &cube) const {
+    if(root == NULL || !contains(cube)) {
+        return glm::vec2(-INFINITY, INFINITY);
+    }
+    OctreeNode * node = root;
+    BoundingCube nodeCube = *this;
+    while(!node->isUnloaded()) {
+        int i = getNodeIndex(cube.getCenter(), nodeCube);
+        BoundingCube childCube = nodeCube.getChild(i);
+        ChildBlock * block = node->getBlock(*allocator);
+        OctreeNode * child = block != NULL ? block->get(i, *allocator) : NULL;
+        if(child == NULL || !childCube.contains(cube)) {
+            break;
+        }
+        node = child;
+        nodeCube = childCube;
+    }
+    float bounds[2];
+    node->getBounds(*allocator, bounds);
+    return glm::vec2(bounds[0], bounds[1]);
+}
+
+// Bottom-up over a loaded subtree. Paged out chunks keep the bounds they have, with aboveChunks
+// the chunks aren't entered either, their own files set them.
+void Octree::updateBounds(OctreeNode * node, bool aboveChunks) {
+    if(node == NULL) {
+        return;
+    }
+    OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    node->getChildren(*allocator, children);
+    for(int i = 0; i < 8; ++i) {
+        OctreeNode * child = children[i];
+        if(child != NULL && !child->isUnloaded() && !(aboveChunks && child->isChunk())) {
+            updateBounds(child, aboveChunks);
+        }
+    }
+    node->updateBounds(*allocator);
+}
+
+// 21 bits per axis, x before y before z in every triple like the child indices
+static uint64_t getMortonCode(const glm::vec3 &pos, const BoundingCube &cube) {
+    glm::vec3 local = glm::clamp((pos - cube.getMin()) / cube.getLengthX(), 0.0f, 1.0f) * 2097151.0f;
+    glm::uvec3 q = glm::uvec3(local);
+    uint64_t code = 0;
+    for(int b = 20; b >= 0; --b) {
+        code = (code << 3) | (((q.x >> b) & 1) << 2) | (((q.y >> b) & 1) << 1) | ((q.z >> b) & 1);
+    }
+    return code;
+}
+
+// getNodeAt and getSdfAt for many points at once. The points are sorted along a Morton curve and
+// the tree is walked once, each node splitting its share of points among the children, so nodes
+// are read once per batch instead of once per point. Same results as the single point calls,
+// getSdfAt being locate(points, INT_MAX, false).
+void Octree::locate(const std::vector<glm::vec3> &points, int level, bool simplification, std::vector<OctreePointLocation> &result) const {
+    result.assign(points.size(), OctreePointLocation{NULL, 0, INFINITY});
+    if(root == NULL) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint>> order;
+    order.reserve(points.size());
+    for(uint i = 0; i < points.size(); ++i) {
+        if(contains(points[i])) {
+            order.push_back(std::make_pair(getMortonCode(points[i], *this), i));
+        }
+    }
+    if(order.empty()) {
+        return;
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<uint> indices(order.size());
+    std::vector<uint> scratch(order.size());
+    for(size_t k = 0; k < order.size(); ++k) {
+        indices[k] = order[k].second;
+    }
+    locate(root, *this, 0, level, simplification, points, indices.data(), scratch.data(), indices.size(), result);
+}
+
+// Children are picked with getNodeIndex rather than the Morton bits, points on a shared face
+// go where getNodeAt sends them. The split is stable, each child gets its points still sorted.
+void Octree::locate(OctreeNode * node, const BoundingCube &cube, uint depth, int level, bool simplification, const std::vector<glm::vec3> &points, uint * indices, uint * scratch, size_t count, std::vector<OctreePointLocation> &result) const {
+    ChildBlock * block = NULL;
+    if((int) depth < level && !(simplification && node->isSimplified())) {
+        ensureLoaded(node, cube);
+        block = node->getBlock(*allocator);
+    }
+    OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    if(block != NULL) {
+        for(int i = 0; i < 8; ++i) {
+            children[i] = block->get(i, *allocator);
+        }
+    }
+
+    float sdf[8];
+    node->getSDF(*allocator, sdf);
+    size_t start[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    for(size_t k = 0; k < count; ++k) {
+        const glm::vec3 &pos = points[indices[k]];
+        int i = block != NULL ? getNodeIndex(pos, cube) : 0;
+        if(children[i] != NULL) {
+            ++start[i + 1];
+        } else {
+            result[indices[k]] = OctreePointLocation{node, depth, SDF::interpolate(sdf, pos, cube)};
+        }
+    }
+    if(block == NULL) {
+        return;
+    }
+    for(int i = 0; i < 8; ++i) {
+        start[i + 1] += start[i];
+    }
+    size_t offset[8];
+    std::copy(start, start + 8, offset);
+    for(size_t k = 0; k < count; ++k) {
+        int i = getNodeIndex(points[indices[k]], cube);
+        if(children[i] != NULL) {
+            scratch[offset[i]++] = indices[k];
+        }
+    }
+    // the buffers swap roles on the way down, nothing is copied back
+    for(int i = 0; i < 8; ++i) {
+        size_t n = start[i + 1] - start[i];
+        if(n > 0) {
+            locate(children[i], cube.getChild(i), depth + 1, level, simplification, points, scratch + start[i], indices + start[i], n, result);
+        }
+    }
+}
+
 void Octree::iterateBorder(
             const OctreeNode * from,
             const BoundingCube &fromCube,
@@ -178,6 +357,7 @@ void Octree::iterateBorder(
     // INTERNAL NODE: recurse into children of `to`
     // ----------------------
     OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    ensureLoaded(to, toCube);
     to->getChildren(*allocator, children);
 
     // decide a threshold for treating `to` as "similar size" to `from`
@@ -197,7 +377,9 @@ void Octree::iterateBorder(
                 axis = 2;
 
             if (axis != -1 && fromCube.intersects(childCube)) {
-                iterateBorder(from, fromCube, fromSDF, fromLevel, to, childCube, to->sdf, toLevel + 1, nodeIterated, func, context);
+                float childSDF[8];
+                to->getSDF(*allocator, childSDF);
+                iterateBorder(from, fromCube, fromSDF, fromLevel, to, childCube, childSDF, toLevel + 1, nodeIterated, func, context);
             }
         }
     }
@@ -206,10 +388,11 @@ void Octree::iterateBorder(
 
 OctreeNodeLevel Octree::fetch(glm::vec3 pos, uint level, bool simplification, ThreadContext * context) const {
     glm::vec4 key = glm::vec4(pos, level);
-    if(context->nodeCache.find(key) != context->nodeCache.end()) {
-        return context->nodeCache[key];
+    auto it = context->nodeCache.find(key);
+    if(it != context->nodeCache.end()) {
+        return it->second;
     } else {
-        OctreeNodeLevel nodeLevel = getNodeAt(pos, level, simplification);
+        OctreeNodeLevel nodeLevel = getNodeAt(pos, level, simplification, context);
         context->nodeCache[key] = nodeLevel;
         return nodeLevel;
     }
@@ -259,7 +442,7 @@ void Octree::handleQuadNodes(const BoundingCube &cube, uint level, const float s
                 }
                 OctreeNode * childNode = neighbor->node;
                 if(childNode != NULL && childNode->getType() == SpaceType::Surface) {
-                    vertices[i] = childNode->vertex;
+                    vertices[i] = childNode->getVertex(*allocator);
                 } else {
                     vertices[i].brushIndex = DISCARD_BRUSH_INDEX;
                 }
@@ -279,31 +462,172 @@ void Octree::handleQuadNodes(const BoundingCube &cube, uint level, const float s
 	}
 }
 
-float Octree::evaluateSDF(const ShapeArgs &args, tsl::robin_map<glm::vec3, float> *cache, glm::vec3 p) const {
-    auto it = cache->find(p);
-    if (it != cache->end())
-        return it->second;
+// Evaluates up to SDF_BATCH_SIZE points with one distanceBatch call, cached points are not evaluated again.
+// Points with a key go through the operation's SdfCache, the others (keys NULL) through the thread's cache.
+void Octree::evaluateSDF(const ShapeArgs &args, ThreadContext * threadContext, const glm::vec3 * points, const uint64_t * keys, float * result, uint count) const {
+    float x[SDF_BATCH_SIZE], y[SDF_BATCH_SIZE], z[SDF_BATCH_SIZE], d[SDF_BATCH_SIZE];
+    uint missing[SDF_BATCH_SIZE];
+    uint pending[SDF_BATCH_SIZE];
+    uint misses = 0;
+    uint waits = 0;
+    tsl::robin_map<glm::vec4, float> * localCache = &threadContext->shapeSdfCache;
+    const float index = args.index;
+
+    for(uint i = 0; i < count; ++i) {
+        if(keys != NULL) {
+            SdfCacheLookup lookup = args.cache->claim(keys[i], &result[i]);
+            if(lookup == SDF_CACHE_HIT) {
+                continue;
+            } else if(lookup == SDF_CACHE_PENDING) {
+                pending[waits++] = i;
+                continue;
+            }
+        } else {
+            auto it = localCache->find(glm::vec4(points[i], index));
+            if (it != localCache->end()) {
+                result[i] = it->second;
+                continue;
+            }
+        }
+        x[misses] = points[i].x;
+        y[misses] = points[i].y;
+        z[misses] = points[i].z;
+        missing[misses++] = i;
+    }
+
+    if(misses > 0) {
+        // pad with the last point so the kernels only run full lanes
+        uint padded = misses;
+        while(padded % vfloat::width != 0 && padded < SDF_BATCH_SIZE) {
+            x[padded] = x[misses-1];
+            y[padded] = y[misses-1];
+            z[padded] = z[misses-1];
+            ++padded;
+        }
+        args.function->distanceBatch(x, y, z, d, padded, args.model);
 
-    float d = args.function->distance(p, args.model);
-    cache->try_emplace(p, d);
-    return d;
+        for(uint k = 0; k < misses; ++k) {
+            uint i = missing[k];
+            result[i] = d[k];
+            if(keys != NULL) {
+                args.cache->publish(keys[i], d[k]);
+            } else {
+                localCache->try_emplace(glm::vec4(points[i], index), d[k]);
+            }
+        }
+    }
+
+    // our own claims are published by now, whoever holds these isn't waiting on us
+    for(uint k = 0; k < waits; ++k) {
+        uint i = pending[k];
+        result[i] = args.cache->wait(keys[i]);
+    }
 }
 
-void Octree::buildSDF(const ShapeArgs &args, BoundingCube &cube, float shapeSDF[8], float resultSDF[8], float existingResultSDF[8], ThreadContext * threadContext) const {
+// Corners missing from the children get every active operation folded in order.
+// shapeSDF is the union of the shapes, painter the last operation whose shape isn't empty in the cube.
+void Octree::buildSDF(const std::vector<ShapeArgs> &args, uint64_t active, BoundingCube &cube, float shapeSDF[8], float resultSDF[8], float existingResultSDF[8], int * painter, ThreadContext * threadContext) const {
     const glm::vec3 min = cube.getMin();
     const glm::vec3 length = cube.getLength();
-    tsl::robin_map<glm::vec3, float> * shapeSdfCache = &threadContext->shapeSdfCache;
 
+    glm::vec3 points[8];
+    uint64_t keys[8];
+    uint64_t cubeKeys[8];
+    float values[8];
+    uint corners[8];
+    uint count = 0;
     for (uint i = 0; i < 8; ++i) {
+        if(shapeSDF[i] == INFINITY || resultSDF[i] == INFINITY) {
+            points[count] = min + length * Octree::getShift(i);
+            corners[count++] = i;
+        }
+    }
+    if(count == 0) {
+        return;
+    }
+
+    float shape[8];
+    float result[8];
+    for(uint j = 0; j < count; ++j) {
+        shape[j] = INFINITY;
+        result[j] = existingResultSDF[corners[j]];
+    }
+    for(uint k = 0; k < args.size(); ++k) {
+        if(!(active & (1ull << k))) {
+            continue;
+        }
+        const ShapeArgs &op = args[k];
+        bool shared = op.cache != NULL && op.cache->getKeys(cube, op.index, cubeKeys);
+        for(uint j = 0; j < count && shared; ++j) {
+            keys[j] = cubeKeys[corners[j]];
+        }
+        evaluateSDF(op, threadContext, points, shared ? keys : NULL, values, count);
+        bool touches = false;
+        for(uint j = 0; j < count; ++j) {
+            shape[j] = glm::min(shape[j], values[j]);
+            result[j] = op.operation(result[j], values[j]);
+            touches |= values[j] < 0.0f;
+        }
+        // leaves get all their corners evaluated, that's where painting happens
+        if(touches) {
+            *painter = k;
+        }
+    }
+
+    for(uint j = 0; j < count; ++j) {
+        uint i = corners[j];
         if(shapeSDF[i] == INFINITY) {
-            shapeSDF[i] = evaluateSDF(args, shapeSdfCache, min + length * Octree::getShift(i));
+            shapeSDF[i] = shape[j];
         }
         if(resultSDF[i] == INFINITY) {
-            resultSDF[i] = args.operation(existingResultSDF[i], shapeSDF[i]);
+            resultSDF[i] = result[j];
         }
     }
 }
 
+// Leaf children share the 27 corners of a 3x3x3 lattice, evaluate them in one batch
+// before recursing so that the children's buildSDF only hits the cache.
+// Without keys, points must be computed exactly like buildSDF does or the cache keys won't match.
+void Octree::prefetchSDF(const ShapeArgs &args, const BoundingCube &cube, ThreadContext * threadContext) const {
+    glm::vec3 points[SDF_BATCH_SIZE];
+    uint64_t keys[SDF_BATCH_SIZE];
+    float values[SDF_BATCH_SIZE];
+    uint count = 0;
+    uint64_t childKeys[8];
+    bool shared = args.cache != NULL;
+
+    for(uint c = 0; c < 8 && shared; ++c) {
+        shared = args.cache->getKeys(cube.getChild(c), args.index, childKeys);
+    }
+    tsl::robin_map<glm::vec4, float> * localCache = &threadContext->shapeSdfCache;
+
+    for(uint c = 0; c < 8; ++c) {
+        BoundingCube child = cube.getChild(c);
+        const glm::vec3 min = child.getMin();
+        const glm::vec3 length = child.getLength();
+        if(shared) {
+            args.cache->getKeys(child, args.index, childKeys);
+        }
+        for(uint j = 0; j < 8; ++j) {
+            glm::vec3 p = min + length * Octree::getShift(j);
+            if(!shared && localCache->find(glm::vec4(p, args.index)) != localCache->end()) {
+                continue;
+            }
+            bool repeated = false;
+            for(uint k = 0; k < count && !repeated; ++k) {
+                repeated = shared ? keys[k] == childKeys[j] : points[k] == p;
+            }
+            if(!repeated && count < SDF_BATCH_SIZE) {
+                keys[count] = childKeys[j];
+                points[count++] = p;
+            }
+        }
+    }
+    if(count > 0) {
+        evaluateSDF(args, threadContext, points, shared ? keys : NULL, values, count);
+    }
+}
+
 void Octree::expand(const ShapeArgs &args) {
     while (!args.function->isContained(*this, args.model, args.minSize)) {
         glm::vec3 point = args.function->getCenter(args.model);
@@ -313,7 +637,7 @@ void Octree::expand(const ShapeArgs &args) {
         setLength(getLengthX()*2);
 
         OctreeNode* oldRoot = root;
-        OctreeNode* newRoot = allocator->allocate()->init(getCenter());
+        OctreeNode* newRoot = allocator->allocate()->init(*allocator, getCenter());
         ChildBlock* newBlock = newRoot->allocate(*allocator)->init();
 
         if (oldRoot != NULL) {
@@ -336,6 +660,10 @@ void Octree::expand(const ShapeArgs &args) {
             newBlock->set(i, oldRoot, *allocator);
         }
         root = newRoot;
+        if(journal != NULL) {
+            // the cubes of the recorded slots moved with the new root
+            journal->clear(true);
+        }
     }
 }
 
@@ -349,14 +677,9 @@ void Octree::add(
         Simplifier &simplifier, 
         OctreeChangeHandler * changeHandler
     ) {
-    threadsCreated = 0;
-    *shapeCounter = 0;
-    ShapeArgs args = ShapeArgs(SDF::opUnion, function, painter, model, translate, scale, simplifier, changeHandler, minSize);	
-  	expand(args);
-    OctreeNodeFrame frame = OctreeNodeFrame(root, *this, 0, root->sdf, DISCARD_BRUSH_INDEX, false, *this);
-    ThreadContext localChunkContext = ThreadContext(*this);
-    shape(frame, args, &localChunkContext);
-    std::cout << "\t\tOctree::add Ok! threads=" << threadsCreated << ", works=" << *shapeCounter << std::endl; 
+    std::vector<ShapeArgs> args;
+    args.emplace_back(SDF::opUnion, function, painter, model, translate, scale, simplifier, changeHandler, minSize);
+    shapeStep(args, "Octree::add");
 }
 
 void Octree::del(
@@ -367,13 +690,80 @@ void Octree::del(
         const TexturePainter &painter,
         float minSize, Simplifier &simplifier, OctreeChangeHandler  * changeHandler
     ) {
-    threadsCreated = 0;
-    *shapeCounter = 0;
-    ShapeArgs args = ShapeArgs(SDF::opSubtraction, function, painter, model, translate, scale, simplifier, changeHandler, minSize);
-    OctreeNodeFrame frame = OctreeNodeFrame(root, *this, 0, root->sdf, DISCARD_BRUSH_INDEX, false, *this);
+    std::vector<ShapeArgs> args;
+    args.emplace_back(SDF::opSubtraction, function, painter, model, translate, scale, simplifier, changeHandler, minSize);
+    shapeStep(args, "Octree::del");
+}
+
+// Every corner gets the same CSG as one add/del per operation, in order, but the tree is only
+// walked once per SHAPE_BATCH_SIZE operations. The nodes may differ: a cube is refined down to the
+// smallest minSize of the operations active in it and nothing is simplified between operations.
+// The whole apply is one journal step.
+void Octree::apply(const std::vector<ShapeOperation> &operations, Simplifier &simplifier, OctreeChangeHandler * changeHandler) {
+    std::vector<std::vector<ShapeArgs>> batches;
+    for(size_t start = 0; start < operations.size(); start += SHAPE_BATCH_SIZE) {
+        size_t end = std::min(operations.size(), start + SHAPE_BATCH_SIZE);
+        std::vector<ShapeArgs> &args = batches.emplace_back();
+        args.reserve(end - start);
+        for(size_t i = start; i < end; ++i) {
+            const ShapeOperation &op = operations[i];
+            args.emplace_back(op.operation, op.function, *op.painter, op.model, op.translate, op.scale, simplifier, changeHandler, op.minSize);
+            args.back().index = i - start;
+        }
+    }
+    // a new root clears the journal, the tree grows for all of them before the step opens
+    for(std::vector<ShapeArgs> &args : batches) {
+        expandFor(args);
+    }
+    if(journal != NULL) {
+        journal->begin();
+    }
+    for(std::vector<ShapeArgs> &args : batches) {
+        shapeBatch(args, "Octree::apply(" + std::to_string(args.size()) + ")");
+    }
+    if(journal != NULL) {
+        journal->end();
+    }
+}
+
+// A single batch as its own journal step
+void Octree::shapeStep(std::vector<ShapeArgs> &args, const std::string &label) {
+    expandFor(args);
+    if(journal != NULL) {
+        journal->begin();
+    }
+    shapeBatch(args, label);
+    if(journal != NULL) {
+        journal->end();
+    }
+}
+
+void Octree::expandFor(const std::vector<ShapeArgs> &args) {
+    for(const ShapeArgs &op : args) {
+        // deletes never need a bigger tree
+        if(op.operation == SDF::opUnion) {
+            expand(op);
+        }
+    }
+}
+
+// One walk over the tree, inside the journal step the caller opened
+void Octree::shapeBatch(std::vector<ShapeArgs> &args, const std::string &label) {
+    // the tasks of this walk, the thread waiting for them helps with nothing else
+    TaskBatch batch(scheduler.workerCount());
+    TaskBatchScope batchScope(batch);
+    expandFor(args);
+    SdfCache cache(*this);
+    for(ShapeArgs &op : args) {
+        op.cache = &cache;
+    }
+    uint64_t active = args.size() >= 64 ? ~0ull : (1ull << args.size()) - 1;
+    float sdf[8];
+    root->getSDF(*allocator, sdf);
+    OctreeNodeFrame frame = OctreeNodeFrame(root, *this, 0, sdf, DISCARD_BRUSH_INDEX, false, *this);
     ThreadContext localChunkContext = ThreadContext(*this);
-    shape(frame, args, &localChunkContext);
-    std::cout << "\t\tOctree::del Ok! threads=" << threadsCreated << ", works=" << *shapeCounter << std::endl; 
+    shape(frame, args, active, &localChunkContext);
+    std::cout << "\t\t" << label << " Ok! " << getSchedulerStats(batch) << ", " << cache.getStats() << std::endl; 
 }
 
 SpaceType childToParent(bool childSolid, bool childEmpty) {
@@ -386,59 +776,154 @@ SpaceType childToParent(bool childSolid, bool childEmpty) {
     }
 }
 
+// Journal entry of a slot before shape() changes it. Only what the shape replaces without going
+// through the children keeps its subtree, the path to it is recorded node by node, chunks included.
+// Skipped slots can only go away with their parent, and only when they have no children.
+void Octree::record(const OctreeNodeFrame &frame, bool whole, bool skipped) {
+    if(journal == NULL || !journal->isOpen()) {
+        return;
+    }
+    if(skipped) {
+        if(frame.node != NULL && frame.node->id == UINT_MAX) {
+            journal->recordSubtree(frame.node, frame.cube);
+        }
+    } else if(whole || frame.node == NULL) {
+        journal->recordSubtree(frame.node, frame.cube);
+    } else {
+        journal->recordNode(frame.node, frame.cube);
+    }
+}
+
 bool Octree::isChunkNode(float length) const {
     return chunkSize*0.5f < length && length <= chunkSize;
 }
 
+void Octree::ensureLoaded(const OctreeNode * node, const BoundingCube &cube) const {
+    if(pager == NULL) {
+        return;
+    }
+    // whatever was left unloaded gets read, not only what the chunk bit says
+    if(node->isUnloaded()) {
+        pager->fault((OctreeNode*) node, cube);
+    } else if(node->isChunk()) {
+        pager->touch((OctreeNode*) node);
+    }
+}
+
 bool Octree::isThreadNode(float length, float minSize, int threadSize) const {
     return minSize*threadSize < length;
 }
 
-NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args, ThreadContext * threadContext) {    
-    ContainmentType check = args.function->check(frame.cube, args.model, args.minSize);
+NodeOperationResult Octree::shape(OctreeNodeFrame frame, const std::vector<ShapeArgs> &args, uint64_t active, ThreadContext * threadContext) {    
     OctreeNode * node = frame.node;
+    OctreeChangeHandler * changeHandler = args.front().changeHandler;
     bool process = true;
 
-    if(check == ContainmentType::Disjoint) {
+    // operations that can't touch this cube are left out for the whole subtree
+    float minSize = INFINITY;
+    for(uint k = 0; k < args.size(); ++k) {
+        if(active & (1ull << k)) {
+            if(args[k].function->check(frame.cube, args[k].model, args[k].minSize) == ContainmentType::Disjoint) {
+                active &= ~(1ull << k);
+            } else {
+                minSize = glm::min(minSize, args[k].minSize);
+            }
+        }
+    }
+
+    if(active == 0) {
         process = false;
+        record(frame, false, true);
         SpaceType resultType = node ? node->getType() : SDF::eval(frame.sdf);
         return NodeOperationResult(node, SpaceType::Empty, resultType, frame.sdf, INFINITY_ARRAY, process, node ? node->isSimplified() : true, DISCARD_BRUSH_INDEX);  // Skip this node
     }
     float length = frame.cube.getLengthX();
     bool isChunk = isChunkNode(length);
-    bool isLeaf = length <= args.minSize;
+    bool isLeaf = length <= minSize;
+    if(changeHandler != NULL && isChunkNode(length * CHUNK_MESH_DIVISIONS)) {
+        changeHandler->dirty(frame.chunkCube, frame.cube);
+    }
     if(node != NULL && !node->isLeaf()) {
         isLeaf = false;
     }
 
+    // Bounds of the shapes inside the cube. Fully outside is the same as disjoint,
+    // fully inside gives the same type to the whole cube whatever came before it,
+    // when it's the last operation there's no need to go deeper.
+    bool isFilled = false;
+    if(!isLeaf) {
+        int filled = -1;
+        for(uint k = 0; k < args.size(); ++k) {
+            if(active & (1ull << k)) {
+                glm::vec2 range = args[k].function->getDistanceRange(frame.cube, args[k].model);
+                if(range.x > 0.0f) {
+                    active &= ~(1ull << k);
+                } else if(range.y < 0.0f) {
+                    filled = k;
+                }
+            }
+        }
+        if(active == 0) {
+            record(frame, false, true);
+            SpaceType resultType = node ? node->getType() : SDF::eval(frame.sdf);
+            return NodeOperationResult(node, SpaceType::Empty, resultType, frame.sdf, INFINITY_ARRAY, false, node ? node->isSimplified() : true, DISCARD_BRUSH_INDEX);
+        }
+        if(filled >= 0) {
+            active &= ~((1ull << filled) - 1);
+            isFilled = (active >> filled) == 1;
+        }
+        if(isFilled && node != NULL) {
+            // a paged out chunk would come back over the result
+            ensureLoaded(node, frame.cube);
+        }
+        if(isFilled && changeHandler != NULL && length <= chunkSize) {
+            // the sub-blocks below aren't visited
+            changeHandler->dirty(frame.chunkCube, frame.cube);
+        }
+    }
+
+    record(frame, isLeaf || isFilled, false);
+
     NodeOperationResult childResult[8];
-    std::vector<std::thread> threads;
-    threads.reserve(8);
-    if (!isLeaf) {
-        bool isChildThread = isThreadNode(length*0.5f, args.minSize, 16);
+    TaskGroup group;
+    if (!isLeaf && !isFilled) {
+        bool isChildThread = isThreadNode(length*0.5f, minSize, 16);
         bool isChildChunk = isChunkNode(length*0.5f);
 
         OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
         if(node != NULL) {
+            ensureLoaded(node, frame.cube);
             node->getChildren(*allocator, children);
         }
+        if(length*0.5f <= minSize) {
+            for(uint k = 0; k < args.size(); ++k) {
+                if(active & (1ull << k)) {
+                    prefetchSDF(args[k], frame.cube, threadContext);
+                }
+            }
+        }
         // --------------------------------
-        // Iterate nodes and create threads
+        // Iterate nodes and submit tasks
         // --------------------------------
 
+        // check before submitting, tasks must not outlive childResult
         for (uint i = 0; i < 8; ++i) {
             OctreeNode * child = children[i];
             if(node!=NULL && child == node) {
 		        throw std::runtime_error("Infinite loop " + std::to_string((long)child) + " " + std::to_string((long)node));
             }
-            
+        }
+
+        for (uint i = 0; i < 8; ++i) {
+            OctreeNode * child = children[i];
             float childSDF[8] = {INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY};
-            int childBrushIndex = node != NULL ? node->vertex.brushIndex : frame.brushIndex;
+            int childBrushIndex = node != NULL ? node->getPayload(*allocator)->brushIndex : frame.brushIndex;
             bool isChildInterpolated = frame.interpolated;
 
             if(child != NULL) {
-                childBrushIndex = child->vertex.brushIndex;
-                SDF::copySDF(child->sdf, childSDF);
+                OctreeNodePayload * payload = child->getPayload(*allocator);
+                childBrushIndex = payload->brushIndex;
+                payload->getSDF(childSDF);
             } else {
                 isChildInterpolated = true;
                 SDF::getChildSDF(frame.sdf, i, childSDF);
@@ -455,29 +940,22 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
             );
 
             if(isChildThread) {
-                ++threadsCreated;
                 NodeOperationResult * result = &childResult[i];
-                threads.emplace_back([this, childFrame, args, result]() {
+                scheduler.submit(group, [this, childFrame, &args, active, result]() {
                    ThreadContext localThreadContext(childFrame.cube);
-                   *result = shape(childFrame, args, &localThreadContext);
+                   *result = shape(childFrame, args, active, &localThreadContext);
                 });
             } else {
-                childResult[i] = shape(childFrame, args, threadContext);
+                childResult[i] = shape(childFrame, args, active, threadContext);
             }
-            
-            (*shapeCounter)++;
         }
     }
 
     // ------------------------------
-    // Synchronize threads if created
+    // Wait for submitted tasks, helping meanwhile
     // ------------------------------
 
-    for(std::thread &t : threads) {
-        if(t.joinable()) {
-            t.join();
-        }
-    }
+    scheduler.wait(group);
  
     // ------------------------------
     // Inherit SDFs from children
@@ -493,7 +971,7 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
     bool isSimplified = isLeaf;
     int brushIndex = frame.brushIndex;
 
-    if(!isLeaf) {
+    if(!isLeaf && !isFilled) {
         for(uint i = 0; i < 8; ++i) {
             NodeOperationResult & result = childResult[i];   
 
@@ -512,10 +990,11 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
     // ------------------------------
     // Build SDFs based on inheritance/execution
     // ------------------------------
-    buildSDF(args, frame.cube, shapeSDF, resultSDF, frame.sdf, threadContext);
+    int painter = -1;
+    buildSDF(args, active, frame.cube, shapeSDF, resultSDF, frame.sdf, &painter, threadContext);
     
-    SpaceType shapeType = isLeaf ? SDF::eval(shapeSDF) : childToParent(childShapeSolid, childShapeEmpty);
-    SpaceType resultType = isLeaf ? SDF::eval(resultSDF) : childToParent(childResultSolid, childResultEmpty);
+    SpaceType shapeType = isLeaf || isFilled ? SDF::eval(shapeSDF) : childToParent(childShapeSolid, childShapeEmpty);
+    SpaceType resultType = isLeaf || isFilled ? SDF::eval(resultSDF) : childToParent(childResultSolid, childResultEmpty);
 
     if(shapeType == SpaceType::Empty && !frame.interpolated) {
         // Do nothing
@@ -526,31 +1005,39 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
         // Created nodes if the shape is not Empty
         // ------------------------------     
         if(node == NULL) {
-            node = allocator->allocate()->init(Vertex(frame.cube.getCenter()));   
+            node = allocator->allocate()->init(*allocator, Vertex(frame.cube.getCenter()));   
+            if(isChunk && changeHandler != NULL) {
+                // a mesh left by an erased chunk at the same place has none of this one
+                changeHandler->dirty(frame.cube, frame.cube);
+            }
         }
 
         if(node!= NULL) {
-            node->vertex.position = glm::vec4(SDF::getAveragePosition(resultSDF, frame.cube) ,0.0f);
-            node->vertex.normal = glm::vec4(SDF::getNormalFromPosition(resultSDF, frame.cube, node->vertex.position), 0.0f);        
+            OctreeNodePayload * payload = node->getPayload(*allocator);
+            Vertex vertex = payload->getVertex();
+            glm::vec3 position = SDF::getAveragePosition(resultSDF, frame.cube);
+            vertex.position = glm::vec4(position, 0.0f);
+            vertex.normal = glm::vec4(SDF::getNormalFromPosition(resultSDF, frame.cube, position), 0.0f);        
             
             // ------------------------------
             // Simplification & Painting
             // ------------------------------
             if(isLeaf) {
-                if(shapeType != SpaceType::Empty) {
-                    brushIndex = args.painter.paint(node->vertex, args.translate, args.scale);
+                if(shapeType != SpaceType::Empty && painter >= 0) {
+                    brushIndex = args[painter].painter.paint(vertex, args[painter].translate, args[painter].scale);
                 }        
             } else {
                 if(childSimplified && !isChunk) {
-                    std::pair<bool,int> simplificationResult = args.simplifier.simplify(frame.chunkCube, frame.cube, resultSDF, childResult);
+                    std::pair<bool,int> simplificationResult = args.front().simplifier.simplify(frame.chunkCube, frame.cube, resultSDF, childResult);
                     isSimplified = simplificationResult.first;
                     brushIndex = simplificationResult.second;
                 }
             }
 
-            node->vertex.brushIndex = brushIndex;
+            vertex.brushIndex = brushIndex;
+            payload->setVertex(vertex);
 
-            if(!isLeaf) {
+            if(!isLeaf && !isFilled) {
                 // ------------------------------
                 // Created at least one solid child
                 // ------------------------------
@@ -563,14 +1050,15 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
                     if(child.process) {
                         if(child.resultType != SpaceType::Surface) {
                             BoundingCube childCube = frame.cube.getChild(i);
-                            bool childIsLeaf = length *0.5f <= args.minSize;
+                            bool childIsLeaf = length *0.5f <= minSize;
                            
                             if(childNode == NULL) {
-                                childNode = allocator->allocate()->init(Vertex(childCube.getCenter()));
+                                childNode = allocator->allocate()->init(*allocator, Vertex(childCube.getCenter()));
                                 childResult[i].node = childNode;
                             }
                             childNode->setType(child.resultType);
-                            childNode->setSDF(child.resultSDF);
+                            childNode->setSDF(*allocator, child.resultSDF, childCube.getLengthX());
+                            childNode->updateBounds(*allocator);
                             childNode->setLeaf(childIsLeaf);
                             childNode->setSimplified(childIsLeaf);
                             childNode->setChunk(isChildChunk);
@@ -584,14 +1072,14 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
                 }
                 node->setChildren(*allocator, childNodes);
             }
-            if(isChunk && args.changeHandler != NULL) {
-                args.changeHandler->update(node);
+            if(isChunk && changeHandler != NULL) {
+                changeHandler->update(node);
             }
         }
     } else if(resultType != SpaceType::Surface) {
         isSimplified = true;
-        if(node != NULL && isChunk && args.changeHandler != NULL) {
-            args.changeHandler->erase(node);
+        if(node != NULL && isChunk && changeHandler != NULL) {
+            changeHandler->erase(node);
         }
 
         // ------------------------------
@@ -599,7 +1087,7 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
         // ------------------------------
         ChildBlock * block = node ? node->getBlock(*allocator) : NULL;
         if(block) {
-            node->clear(*allocator, args.changeHandler, block);
+            node->clear(*allocator, changeHandler, block);
         } 
         /*if(resultType == SpaceType::Empty) {
             node = node ? allocator->deallocate(node) : NULL;
@@ -608,12 +1096,17 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
     }
 
     if(node!= NULL && process) {
-        node->setSDF(resultSDF);
+        node->setSDF(*allocator, resultSDF, length);
+        // the children are final by now
+        node->updateBounds(*allocator);
         node->setType(resultType);
         node->setChunk(isChunk);
         node->setDirty(true);
         node->setSimplified(isSimplified);
         node->setLeaf(isLeaf);
+        if(isChunk && pager != NULL) {
+            pager->markModified(node, frame.cube);
+        }
     }
 
     return NodeOperationResult(node, shapeType, resultType, resultSDF, shapeSDF, process, isSimplified, brushIndex);
@@ -621,17 +1114,23 @@ NodeOperationResult Octree::shape(OctreeNodeFrame frame, const ShapeArgs &args,
 
 
 void Octree::iterate(IteratorHandler &handler) {
-    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, root->sdf);
+    float sdf[8];
+    root->getSDF(*allocator, sdf);
+    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, sdf);
 	handler.iterate(*this, data);
 }
 
 void Octree::iterateFlat(IteratorHandler &handler) {
-    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, root->sdf);
+    float sdf[8];
+    root->getSDF(*allocator, sdf);
+    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, sdf);
     handler.iterateFlatIn(*this, data);
 }
 
 void Octree::iterateParallel(IteratorHandler &handler) {
-    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, root->sdf);
+    float sdf[8];
+    root->getSDF(*allocator, sdf);
+    OctreeNodeData data(0, root, *this, ContainmentType::Intersects, NULL, sdf);
     handler.iterateBFS(*this, data);
     //handler.iterateParallelBFS(*this, data, threadPool);
 }
@@ -658,10 +1157,144 @@ void Octree::exportNodesSerialization(std::vector<OctreeNodeCubeSerialized> * no
 	std::cout << "exportNodesSerialization Ok!" << std::endl;
 }
 
+std::string Octree::getSchedulerStats(const TaskBatch &batch) const {
+    std::vector<TaskSchedulerStats> stats = scheduler.getStats(batch);
+    TaskSchedulerStats total = scheduler.getTotalStats(batch);
+    std::string result = "tasks=" + std::to_string(total.tasks) + ", steals=" + std::to_string(total.steals) + " [";
+    for(size_t i = 0; i < stats.size(); ++i) {
+        result += (i ? " " : "") + std::to_string(stats[i].tasks) + "/" + std::to_string(stats[i].steals);
+    }
+    return result + "]";
+}
+
 void Octree::reset() {
+    if(journal != NULL) {
+        journal->clear(false);
+    }
     if(root != NULL) {
-        allocator->childAllocator.reset();
-        allocator->nodeAllocator.reset();
-        this->root = allocator->allocate()->init(glm::vec3(getCenter()));
+        if(pager != NULL) {
+            pager->clear();
+        }
+        allocator->reset();
+        this->root = allocator->allocate()->init(*allocator, glm::vec3(getCenter()));
+    }
+}
+
+// Old slots in the order compact() lays them out: the children of a node side by side, then
+// the subtree of each child in turn. Chunks and what's above them stay, their blocks move.
+static void getLayout(OctreeAllocator &allocator, OctreeNode * node, bool below, std::vector<uint> &nodeOrder, std::vector<uint> &blockOrder, std::vector<OctreeNode*> &chunkNodes) {
+    if(node->isUnloaded() || node->id == UINT_MAX) {
+        return;
+    }
+    OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    node->getChildren(allocator, children);
+    if(!below && node->isChunk()) {
+        chunkNodes.push_back(node);
+        below = true;
+    }
+    if(below) {
+        blockOrder.push_back(node->id);
+        for(int i = 0; i < 8; ++i) {
+            if(children[i] != NULL) {
+                nodeOrder.push_back(allocator.getIndex(children[i]));
+            }
+        }
     }
-}
\ No newline at end of file
+    for(int i = 0; i < 8; ++i) {
+        if(children[i] != NULL) {
+            getLayout(allocator, children[i], below, nodeOrder, blockOrder, chunkNodes);
+        }
+    }
+}
+
+// The lowest slots that are free or about to be moved, one per entry of order.
+// used ends up as the allocator's bitmap after the move.
+template <typename T> static std::vector<uint> getTargets(Allocator<T> &allocator, const std::vector<uint> &order, std::vector<uint64_t> &used) {
+    allocator.getUsed(used);
+    for(uint i : order) {
+        used[i / 64] &= ~(1ull << (i % 64));
+    }
+    std::vector<uint> targets;
+    targets.reserve(order.size());
+    size_t total = allocator.getAllocatedBlocksCount() * allocator.getBlockSize();
+    for(size_t i = 0; i < total && targets.size() < order.size(); ++i) {
+        if(!((used[i / 64] >> (i % 64)) & 1)) {
+            targets.push_back(i);
+        }
+    }
+    for(uint i : targets) {
+        used[i / 64] |= 1ull << (i % 64);
+    }
+    return targets;
+}
+
+// Moves the nodes below the chunks and their ChildBlocks so that every chunk reads from a few
+// contiguous runs in child (Morton) order, edits leave them wherever the free lists were.
+// Chunks and the nodes above them keep their slots, change handlers, the pager and the journal
+// know them by pointer. Nothing may use the tree meanwhile.
+size_t Octree::compact() {
+    if(root == NULL) {
+        return 0;
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint> nodeOrder;
+    std::vector<uint> blockOrder;
+    std::vector<OctreeNode*> chunkNodes;
+    getLayout(*allocator, root, false, nodeOrder, blockOrder, chunkNodes);
+
+    std::vector<uint64_t> nodesUsed;
+    std::vector<uint64_t> blocksUsed;
+    std::vector<uint> nodeTargets = getTargets(allocator->nodeAllocator, nodeOrder, nodesUsed);
+    std::vector<uint> blockTargets = getTargets(allocator->childAllocator, blockOrder, blocksUsed);
+    std::vector<uint> nodeMap(allocator->nodeAllocator.getAllocatedBlocksCount() * allocator->nodeAllocator.getBlockSize(), UINT_MAX);
+    std::vector<uint> blockMap(allocator->childAllocator.getAllocatedBlocksCount() * allocator->childAllocator.getBlockSize(), UINT_MAX);
+    for(size_t k = 0; k < nodeOrder.size(); ++k) {
+        nodeMap[nodeOrder[k]] = nodeTargets[k];
+    }
+    for(size_t k = 0; k < blockOrder.size(); ++k) {
+        blockMap[blockOrder[k]] = blockTargets[k];
+    }
+
+    // targets overlap the old slots, everything is copied out before anything is written
+    std::vector<OctreeNode> nodes(nodeOrder.size());
+    std::vector<OctreeNodePayload> payloads(nodeOrder.size());
+    std::vector<ChildBlock> blocks(blockOrder.size());
+    for(size_t k = 0; k < nodeOrder.size(); ++k) {
+        nodes[k] = *allocator->get(nodeOrder[k]);
+        payloads[k] = *allocator->payloadAllocator.at(nodeOrder[k]);
+    }
+    for(size_t k = 0; k < blockOrder.size(); ++k) {
+        blocks[k] = *allocator->childAllocator.getFromIndex(blockOrder[k]);
+    }
+    for(size_t k = 0; k < nodeOrder.size(); ++k) {
+        OctreeNode * node = allocator->get(nodeTargets[k]);
+        *node = nodes[k];
+        if(node->id != UINT_MAX) {
+            node->id = blockMap[node->id];
+        }
+        *allocator->payloadAllocator.at(nodeTargets[k]) = payloads[k];
+    }
+    for(size_t k = 0; k < blockOrder.size(); ++k) {
+        ChildBlock * block = allocator->childAllocator.getFromIndex(blockTargets[k]);
+        *block = blocks[k];
+        for(int i = 0; i < 8; ++i) {
+            if(block->children[i] != UINT_MAX) {
+                block->children[i] = nodeMap[block->children[i]];
+            }
+        }
+    }
+    for(OctreeNode * chunk : chunkNodes) {
+        chunk->id = blockMap[chunk->id];
+    }
+    allocator->nodeAllocator.setUsed(nodesUsed);
+    allocator->childAllocator.setUsed(blocksUsed);
+
+    // cached descents point at the old slots
+    for(auto it = chunks.begin(); it != chunks.end(); ++it) {
+        it.value().path.clear();
+        it.value().nodeCache.clear();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Octree::compact() " << nodeOrder.size() << " nodes, " << blockOrder.size() << " blocks, " << chunkNodes.size() << " chunks in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+    return nodeOrder.size();
+}
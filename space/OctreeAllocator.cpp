@@ -6,6 +6,16 @@ OctreeNode * OctreeAllocator::allocate(){
     return result;
 }
 
+OctreeNodePayload * OctreeAllocator::getPayload(const OctreeNode * node){
+    return payloadAllocator.at(nodeAllocator.getIndex(const_cast<OctreeNode*>(node)));
+}
+
+// payloads need no reset, every node writes its own on init()
+void OctreeAllocator::reset(){
+    childAllocator.reset();
+    nodeAllocator.reset();
+}
+
 void OctreeAllocator::get(OctreeNode * nodes[8], uint indices[8]){
     nodeAllocator.getFromIndices(nodes, indices);
 }
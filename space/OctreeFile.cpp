@@ -12,14 +12,39 @@ std::string getChunkName(BoundingCube cube) {
 	return std::to_string(cube.getLengthX()) + "_" + std::to_string(p.x) + "_" +  std::to_string(p.y) + "_" + std::to_string(p.z);
 }
 
-OctreeNode * OctreeFile::loadRecursive(int i, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder) {
+// Runs task for every chunk on the pool, at most OCTREE_FILE_IN_FLIGHT chunks are held in memory at once
+template <typename F> static bool forEachChunk(ThreadPool &pool, std::vector<OctreeFileChunk> &chunks, F task) {
+	std::counting_semaphore<OCTREE_FILE_IN_FLIGHT> inFlight(OCTREE_FILE_IN_FLIGHT);
+	std::vector<std::future<bool>> futures;
+	futures.reserve(chunks.size());
+	for(OctreeFileChunk &chunk : chunks) {
+		inFlight.acquire();
+		futures.push_back(pool.enqueue([&inFlight, &chunk, &task]() {
+			bool ok = false;
+			try {
+				ok = task(chunk);
+			} catch(const std::exception &e) {
+				std::cerr << "Error processing chunk " << chunk.path << ": " << e.what() << std::endl;
+			}
+			inFlight.release();
+			return ok;
+		}));
+	}
+	bool ok = true;
+	for(std::future<bool> &future : futures) {
+		ok &= future.get();
+	}
+	return ok;
+}
+
+OctreeNode * OctreeFile::loadRecursive(int i, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder, std::vector<OctreeFileChunk> * chunks) {
 	OctreeNodeSerialized serialized = nodes->at(i);
 	glm::vec3 position = SDF::getAveragePosition(serialized.sdf, cube);
 	glm::vec3 normal = SDF::getNormalFromPosition(serialized.sdf, cube, position);
 	Vertex vertex(position, normal, glm::vec2(0), serialized.brushIndex);
 
-	OctreeNode * node = tree->allocator->allocate()->init(vertex);
-	node->setSDF(serialized.sdf);
+	OctreeNode * node = tree->allocator->allocate()->init(*tree->allocator, vertex);
+	node->setSDF(*tree->allocator, serialized.sdf, cube.getLengthX());
 	node->bits = serialized.bits;
 	if(node->isChunk()){
 		node->setDirty(true);
@@ -32,21 +57,22 @@ OctreeNode * OctreeFile::loadRecursive(int i, std::vector<OctreeNodeSerialized>
 		}
 	}
 	ChildBlock * block = isLeaf ? NULL : node->allocate(*tree->allocator);
-	if(cube.getLengthX() > chunkSize) {
+	// the save may have split the chunks at another size than chunkSize (paged trees use their own),
+	// the index stops at the chunk files. Surfaces are refined below any chunk size, a leaf
+	// one bigger than chunkSize can only be a chunk
+	std::string chunkPath = baseFolder + "/" + filename + "_" + getChunkName(cube) + ".bin";
+	bool isChunkFile = isLeaf && (cube.getLengthX() <= chunkSize || node->getType() == SpaceType::Surface) && std::filesystem::exists(chunkPath);
+	if(!isChunkFile) {
 		for(int j=0 ; j <8 ; ++j){
 			int index = serialized.children[j];
 			if(index != 0) {
 				BoundingCube c = cube.getChild(j);
-				block->set(j , loadRecursive(index, nodes, chunkSize, filename, c,baseFolder), *tree->allocator);
+				block->set(j , loadRecursive(index, nodes, chunkSize, filename, c,baseFolder, chunks), *tree->allocator);
 			}
 		}
 	} else {
-		std::string chunkName = getChunkName(cube);
-		OctreeNodeFile * file = new OctreeNodeFile(tree, node, baseFolder + "/" + filename+ "_" + chunkName + ".bin");
-		//NodeInfo info(INFO_TYPE_FILE, file, NULL, true);
-		//node->info.push_back(info);
-		file->load(baseFolder, cube);
-		delete file;
+		// decoded later, in parallel
+		chunks->push_back(OctreeFileChunk{node, cube, chunkPath});
 	}
 	return node;
 }
@@ -78,21 +104,56 @@ void OctreeFile::load(std::string baseFolder, float chunkSize) {
 	tree->setMin(octreeSerialized.min);
 	tree->setLength(octreeSerialized.length);
 	tree->chunkSize = octreeSerialized.chunkSize;
-	tree->root = loadRecursive(0,&nodes, chunkSize, filename, *tree, baseFolder);
+	std::vector<OctreeFileChunk> chunks;
+	tree->root = loadRecursive(0,&nodes, chunkSize, filename, *tree, baseFolder, &chunks);
 
     file.close();
 	nodes.clear();
 
+	// every chunk owns its subtree, the allocator is the only shared state
+	if(tree->pager != NULL) {
+		// paged trees read chunks when a traversal reaches them, bigger chunks
+		// from an older save are read now and split on the next save
+		std::vector<OctreeFileChunk> bigChunks;
+		for(OctreeFileChunk &chunk : chunks) {
+			if(tree->isChunkNode(chunk.cube.getLengthX())) {
+				chunk.node->setUnloaded(true);
+			} else {
+				bigChunks.push_back(chunk);
+			}
+		}
+		bool ok = forEachChunk(tree->threadPool, bigChunks, [this, &baseFolder](OctreeFileChunk &chunk) {
+			OctreeNodeFile chunkFile(tree, chunk.node, chunk.path);
+			return chunkFile.load(baseFolder, chunk.cube);
+		});
+		tree->updateBounds(tree->root, true);
+		if(!ok) {
+			std::cerr << "OctreeFile::load('" << filePath <<"') some chunks failed to load" << std::endl;
+			return;
+		}
+		std::cout << "OctreeFile::load('" << filePath <<"') " << (chunks.size() - bigChunks.size()) << " chunks paged Ok!" << std::endl;
+		return;
+	}
+	bool ok = forEachChunk(tree->threadPool, chunks, [this, &baseFolder](OctreeFileChunk &chunk) {
+		OctreeNodeFile chunkFile(tree, chunk.node, chunk.path);
+		return chunkFile.load(baseFolder, chunk.cube);
+	});
+	tree->updateBounds(tree->root, true);
+	if(!ok) {
+		std::cerr << "OctreeFile::load('" << filePath <<"') some chunks failed to load" << std::endl;
+		return;
+	}
+
 	std::cout << "OctreeFile::load('" << filePath <<"') Ok!" << std::endl;
 }
 
 
-uint OctreeFile::saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder) {
+uint OctreeFile::saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder, std::vector<OctreeFileChunk> * chunks) {
 	if(node!=NULL) {
 		OctreeNodeSerialized n = OctreeNodeSerialized();
-		n.brushIndex = node->vertex.brushIndex;
+		n.brushIndex = node->getPayload(*tree->allocator)->brushIndex;
 		n.bits = node->bits;
-		SDF::copySDF(node->sdf, n.sdf);
+		node->getSDF(*tree->allocator, n.sdf);
 
 		uint index = nodes->size(); 
 		nodes->push_back(n);
@@ -103,12 +164,12 @@ uint OctreeFile::saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerializ
 
 			for(int i=0; i < 8; ++i) {
 				BoundingCube c = cube.getChild(i);
-				(*nodes)[index].children[i] = saveRecursive(children[i], nodes, chunkSize, filename, c, baseFolder);
+				(*nodes)[index].children[i] = saveRecursive(children[i], nodes, chunkSize, filename, c, baseFolder, chunks);
 			}
 		} else {
+			// encoded later, in parallel
 			std::string chunkName = getChunkName(cube);
-			OctreeNodeFile file(tree, node, baseFolder + "/" + filename + "_" + chunkName + ".bin");
-			file.save(baseFolder);
+			chunks->push_back(OctreeFileChunk{node, cube, baseFolder + "/" + filename + "_" + chunkName + ".bin"});
 		}
 		return index;
 	}
@@ -118,15 +179,34 @@ uint OctreeFile::saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerializ
 void OctreeFile::save(std::string baseFolder, float chunkSize){
 	ensureFolderExists(baseFolder);
     std::vector<OctreeNodeSerialized> nodes;
+	std::vector<OctreeFileChunk> chunks;
 	std::string filePath = baseFolder + "/" + filename+".bin";
-	std::ofstream file = std::ofstream(filePath, std::ios::binary);
+	// unloaded chunks are copied from their files, those are split at the tree's chunk size
+	if(tree->pager != NULL) {
+		chunkSize = tree->chunkSize;
+	}
+
+	saveRecursive(tree->root, &nodes, chunkSize, filename, *tree, baseFolder, &chunks);
+
+	// everything goes to .tmp files first and is renamed only once every write succeeded,
+	// nothing on disk changes if one of them fails
+	std::string tmpPath = filePath + ".tmp";
+	auto discard = [&]() {
+		std::error_code ec;
+		std::filesystem::remove(tmpPath, ec);
+		for(OctreeFileChunk &chunk : chunks) {
+			std::filesystem::remove(chunk.path + ".tmp", ec);
+		}
+		std::cerr << "OctreeFile::save('" << filePath <<"') failed, previous save kept" << std::endl;
+	};
+
+	std::ofstream file = std::ofstream(tmpPath, std::ios::binary);
     if (!file) {
-        std::cerr << "Error opening file for writing: " << filePath << std::endl;
+        std::cerr << "Error opening file for writing: " << tmpPath << std::endl;
+        discard();
         return;
     }
 
-	saveRecursive(tree->root, &nodes, chunkSize, filename, *tree, baseFolder);
-
 	OctreeSerialized  octreeSerialized;
 	octreeSerialized.min = tree->getMin();
 	octreeSerialized.length = tree->getLengthX();
@@ -145,10 +225,39 @@ void OctreeFile::save(std::string baseFolder, float chunkSize){
 	std::istringstream inputStream(decompressed.str());
  	gzipCompressToOfstream(inputStream, file);
 	file.close();
-
+	if(file.fail()) {
+		std::cerr << "Error writing file: " << tmpPath << std::endl;
+		discard();
+		return;
+	}
 	nodes.clear();
 
-	std::cout << "OctreeFile::save('" << filePath <<"') Ok!" << std::endl;
+	bool ok = forEachChunk(tree->threadPool, chunks, [this, &baseFolder](OctreeFileChunk &chunk) {
+		if(chunk.node->isUnloaded()) {
+			// not in memory, its file is still the latest version
+			std::string source = tree->pager->getPath(chunk.node, chunk.cube);
+			std::error_code ec;
+			std::filesystem::copy_file(source, chunk.path + ".tmp", std::filesystem::copy_options::overwrite_existing, ec);
+			if(ec) {
+				std::cerr << "Error copying chunk " << source << ": " << ec.message() << std::endl;
+			}
+			return !ec;
+		}
+		OctreeNodeFile chunkFile(tree, chunk.node, chunk.path + ".tmp");
+		return chunkFile.save(baseFolder, chunk.cube);
+	});
+	if(!ok) {
+		discard();
+		return;
+	}
+
+	// the index goes last, it only ever points to complete chunks
+	for(OctreeFileChunk &chunk : chunks) {
+		std::filesystem::rename(chunk.path + ".tmp", chunk.path);
+	}
+	std::filesystem::rename(tmpPath, filePath);
+
+	std::cout << "OctreeFile::save('" << filePath <<"') " << chunks.size() << " chunks Ok!" << std::endl;
 
 }
 
@@ -0,0 +1,285 @@
+#include "space.hpp"
+#include <zlib.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+OctreeImage::OctreeImage(Octree * tree, std::string filename) {
+	this->tree = tree;
+	this->filename = filename;
+}
+
+std::string OctreeImage::getPath(std::string baseFolder) const {
+	return baseFolder + "/" + filename + ".img";
+}
+
+bool OctreeImage::exists(std::string baseFolder) const {
+	return std::filesystem::exists(getPath(baseFolder));
+}
+
+static void markUsed(std::vector<uint64_t> &used, uint index) {
+	used[index / 64] |= ((uint64_t) 1) << (index % 64);
+}
+
+// only what is reachable from the root is in use, everything else becomes free on load
+static void markReachable(OctreeAllocator &allocator, OctreeNode * node, std::vector<uint64_t> &nodesUsed, std::vector<uint64_t> &childrenUsed) {
+	markUsed(nodesUsed, allocator.getIndex(node));
+	ChildBlock * block = node->getBlock(allocator);
+	if(block == NULL) {
+		return;
+	}
+	markUsed(childrenUsed, node->id);
+	for(int i = 0; i < 8; ++i) {
+		OctreeNode * child = block->get(i, allocator);
+		if(child != NULL) {
+			markReachable(allocator, child, nodesUsed, childrenUsed);
+		}
+	}
+}
+
+static void pad(std::ofstream &file) {
+	static const char zeros[OCTREE_IMAGE_ALIGNMENT] = {0};
+	uint64_t position = file.tellp();
+	uint64_t padding = (OCTREE_IMAGE_ALIGNMENT - position % OCTREE_IMAGE_ALIGNMENT) % OCTREE_IMAGE_ALIGNMENT;
+	file.write(zeros, padding);
+}
+
+template <typename T> static void writeBlocks(std::ofstream &file, const Allocator<T> &allocator, bool compress, OctreeImageSection &section, std::vector<OctreeImageBlock> &table) {
+	section.recordSize = sizeof(T);
+	section.blockSize = allocator.getBlockSize();
+	section.blockCount = allocator.getAllocatedBlocksCount();
+	size_t dataSize = allocator.getBlockDataSize();
+	std::vector<Bytef> compressed(compress ? compressBound(dataSize) : 0);
+
+	for(size_t b = 0; b < section.blockCount; ++b) {
+		pad(file);
+		OctreeImageBlock entry;
+		entry.offset = file.tellp();
+		const char * data = reinterpret_cast<const char*>(allocator.getBlockData(b));
+		if(compress) {
+			uLongf length = compressed.size();
+			if(compress2(compressed.data(), &length, reinterpret_cast<const Bytef*>(data), dataSize, Z_BEST_SPEED) != Z_OK) {
+				throw std::runtime_error("OctreeImage: compression failed");
+			}
+			file.write(reinterpret_cast<const char*>(compressed.data()), length);
+			entry.storedSize = length;
+		} else {
+			// written straight from the allocator, no intermediate copy
+			file.write(data, dataSize);
+			entry.storedSize = dataSize;
+		}
+		table.push_back(entry);
+	}
+}
+
+// the previous image stays until the new one is complete, a failed save leaves no .tmp behind
+bool OctreeImage::save(std::string baseFolder, bool compress) {
+	ensureFolderExists(baseFolder);
+	std::string filePath = getPath(baseFolder);
+	std::string tmpPath = filePath + ".tmp";
+	OctreeAllocator &allocator = *tree->allocator;
+
+	OctreeImageHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, OCTREE_IMAGE_MAGIC, sizeof(header.magic));
+	header.version = OCTREE_IMAGE_VERSION;
+	header.flags = compress ? OCTREE_IMAGE_COMPRESSED : 0;
+	header.tree.min = tree->getMin();
+	header.tree.length = tree->getLengthX();
+	header.tree.chunkSize = tree->chunkSize;
+	header.root = tree->root != NULL ? allocator.getIndex(tree->root) : UINT_MAX;
+
+	std::vector<uint64_t> nodesUsed((allocator.nodeAllocator.getAllocatedBlocksCount() * allocator.nodeAllocator.getBlockSize() + 63) / 64, 0);
+	std::vector<uint64_t> childrenUsed((allocator.childAllocator.getAllocatedBlocksCount() * allocator.childAllocator.getBlockSize() + 63) / 64, 0);
+	if(tree->root != NULL) {
+		markReachable(allocator, tree->root, nodesUsed, childrenUsed);
+	}
+	// every node block gets its payload block, even if no slot in it was read yet
+	size_t nodeCount = allocator.nodeAllocator.getAllocatedBlocksCount() * allocator.nodeAllocator.getBlockSize();
+	if(nodeCount > 0) {
+		allocator.payloadAllocator.at(nodeCount - 1);
+	}
+
+	std::ofstream file = std::ofstream(tmpPath, std::ios::binary);
+	if (!file) {
+		std::cerr << "Error opening file for writing: " << tmpPath << std::endl;
+		return false;
+	}
+	// header goes last, once the offsets are known
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<OctreeImageBlock> nodesTable, childrenTable, payloadsTable;
+	try {
+		writeBlocks(file, allocator.nodeAllocator, compress, header.nodes, nodesTable);
+		writeBlocks(file, allocator.childAllocator, compress, header.children, childrenTable);
+		writeBlocks(file, allocator.payloadAllocator, compress, header.payloads, payloadsTable);
+	} catch(const std::exception &e) {
+		std::cerr << "Error writing file: " << tmpPath << ": " << e.what() << std::endl;
+		file.close();
+		std::error_code ec;
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	pad(file);
+	header.nodes.tableOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(nodesTable.data()), nodesTable.size() * sizeof(OctreeImageBlock));
+	header.nodes.usedOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(nodesUsed.data()), nodesUsed.size() * sizeof(uint64_t));
+	header.children.tableOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(childrenTable.data()), childrenTable.size() * sizeof(OctreeImageBlock));
+	header.children.usedOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(childrenUsed.data()), childrenUsed.size() * sizeof(uint64_t));
+	header.payloads.tableOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(payloadsTable.data()), payloadsTable.size() * sizeof(OctreeImageBlock));
+	header.payloads.usedOffset = header.nodes.usedOffset;
+	// the last block page must be complete for the mapping
+	pad(file);
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+	std::error_code ec;
+	if(!file) {
+		std::cerr << "Error writing file: " << tmpPath << std::endl;
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+	std::filesystem::rename(tmpPath, filePath, ec);
+	if(ec) {
+		std::cerr << "Error renaming " << tmpPath << ": " << ec.message() << std::endl;
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	std::cout << "OctreeImage::save('" << filePath <<"') Ok!" << std::endl;
+	return true;
+}
+
+static bool readAt(int fd, void * buffer, size_t size, uint64_t offset) {
+	char * out = static_cast<char*>(buffer);
+	while(size > 0) {
+		ssize_t n = pread(fd, out, size, offset);
+		if(n <= 0) {
+			return false;
+		}
+		out += n;
+		size -= n;
+		offset += n;
+	}
+	return true;
+}
+
+// blocks are only staged, the tree in use stays untouched until every section was read
+template <typename T> static void readBlocks(int fd, Allocator<T> &allocator, bool compressed, const OctreeImageSection &section, std::vector<uint64_t> &used) {
+	std::vector<OctreeImageBlock> table(section.blockCount);
+	used.resize((section.blockCount * section.blockSize + 63) / 64);
+	if(!readAt(fd, table.data(), table.size() * sizeof(OctreeImageBlock), section.tableOffset) ||
+		!readAt(fd, used.data(), used.size() * sizeof(uint64_t), section.usedOffset)) {
+		throw std::runtime_error("OctreeImage: truncated file");
+	}
+
+	size_t dataSize = allocator.getBlockDataSize();
+	std::vector<Bytef> buffer;
+	for(const OctreeImageBlock &entry : table) {
+		if(!compressed) {
+			if(allocator.stageMappedBlock(fd, entry.offset) != NULL) {
+				continue;
+			}
+			T * data = allocator.stageBlock();
+			if(!readAt(fd, data, dataSize, entry.offset)) {
+				throw std::runtime_error("OctreeImage: truncated block");
+			}
+		} else {
+			T * data = allocator.stageBlock();
+			buffer.resize(entry.storedSize);
+			uLongf length = dataSize;
+			if(!readAt(fd, buffer.data(), entry.storedSize, entry.offset) ||
+				uncompress(reinterpret_cast<Bytef*>(data), &length, buffer.data(), entry.storedSize) != Z_OK || length != dataSize) {
+				throw std::runtime_error("OctreeImage: corrupted block");
+			}
+		}
+	}
+}
+
+// only the nodes above the chunks are touched, the rest stays on disk until used
+static void markChunksDirty(OctreeAllocator &allocator, OctreeNode * node, const BoundingCube &cube, float chunkSize) {
+	if(node->isChunk() || cube.getLengthX() <= chunkSize) {
+		node->setDirty(true);
+		return;
+	}
+	OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	node->getChildren(allocator, children);
+	for(int i = 0; i < 8; ++i) {
+		if(children[i] != NULL) {
+			markChunksDirty(allocator, children[i], cube.getChild(i), chunkSize);
+		}
+	}
+}
+
+bool OctreeImage::load(std::string baseFolder) {
+	std::string filePath = getPath(baseFolder);
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return false;
+	}
+
+	OctreeImageHeader header;
+	bool valid = readAt(fd, &header, sizeof(header), 0) &&
+		std::memcmp(header.magic, OCTREE_IMAGE_MAGIC, sizeof(header.magic)) == 0 &&
+		header.version == OCTREE_IMAGE_VERSION &&
+		header.nodes.recordSize == sizeof(OctreeNode) &&
+		header.nodes.blockSize == tree->allocator->nodeAllocator.getBlockSize() &&
+		header.children.recordSize == sizeof(ChildBlock) &&
+		header.children.blockSize == tree->allocator->childAllocator.getBlockSize() &&
+		header.payloads.recordSize == sizeof(OctreeNodePayload) &&
+		header.payloads.blockSize == tree->allocator->payloadAllocator.getBlockSize() &&
+		header.payloads.blockCount == header.nodes.blockCount;
+	if(!valid) {
+		std::cerr << "Incompatible octree image: " << filePath << std::endl;
+		close(fd);
+		return false;
+	}
+
+	OctreeAllocator &allocator = *tree->allocator;
+	// the caller drained the jobs, nothing reads the tree the previous load replaced
+	allocator.nodeAllocator.releaseRetired();
+	allocator.childAllocator.releaseRetired();
+	allocator.payloadAllocator.releaseRetired();
+
+	bool compressed = header.flags & OCTREE_IMAGE_COMPRESSED;
+	std::vector<uint64_t> nodesUsed, childrenUsed, payloadsUsed;
+	try {
+		readBlocks(fd, allocator.nodeAllocator, compressed, header.nodes, nodesUsed);
+		readBlocks(fd, allocator.childAllocator, compressed, header.children, childrenUsed);
+		readBlocks(fd, allocator.payloadAllocator, compressed, header.payloads, payloadsUsed);
+	} catch(const std::exception &e) {
+		close(fd);
+		// the current tree was never touched, the caller falls back to the chunk files
+		allocator.nodeAllocator.discardStaged();
+		allocator.childAllocator.discardStaged();
+		allocator.payloadAllocator.discardStaged();
+		std::cerr << "OctreeImage::load('" << filePath << "') " << e.what() << std::endl;
+		return false;
+	}
+	// mappings keep the file alive
+	close(fd);
+
+	allocator.nodeAllocator.commitStaged();
+	allocator.childAllocator.commitStaged();
+	allocator.payloadAllocator.commitStaged();
+	// payloads are a parallel array, their slots are never handed out
+	allocator.nodeAllocator.setUsed(nodesUsed);
+	allocator.childAllocator.setUsed(childrenUsed);
+
+	tree->setMin(header.tree.min);
+	tree->setLength(header.tree.length);
+	tree->chunkSize = header.tree.chunkSize;
+	tree->root = header.root != UINT_MAX ? tree->allocator->get(header.root) : NULL;
+	if(tree->root != NULL) {
+		markChunksDirty(*tree->allocator, tree->root, *tree, tree->chunkSize);
+	}
+
+	std::cout << "OctreeImage::load('" << filePath <<"') Ok!" << std::endl;
+	return true;
+}
@@ -0,0 +1,329 @@
+#include "space.hpp"
+
+static glm::vec4 getKey(const BoundingCube &cube) {
+	return glm::vec4(cube.getMin(), cube.getLengthX());
+}
+
+OctreeJournal::OctreeJournal(Octree * tree, size_t budget) {
+	this->tree = tree;
+	this->budget = budget;
+	this->current = 0;
+	this->open = false;
+}
+
+OctreeJournal::~OctreeJournal() {
+	clear(true);
+}
+
+void OctreeJournal::setBudget(size_t budget) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->budget = budget;
+}
+
+// Detached copy of a subtree, paged out chunks are brought back first
+uint OctreeJournal::copy(OctreeNode * node, const BoundingCube &cube, size_t * bytes) {
+	OctreeAllocator &allocator = *tree->allocator;
+	tree->ensureLoaded(node, cube);
+	OctreeNode * result = allocator.allocate();
+	result->id = UINT_MAX;
+	result->bits = node->bits;
+	*result->getPayload(allocator) = *node->getPayload(allocator);
+	*bytes += sizeof(OctreeNode) + sizeof(OctreeNodePayload);
+
+	ChildBlock * block = node->getBlock(allocator);
+	if(block != NULL) {
+		uint children[8];
+		for(int i = 0; i < 8; ++i) {
+			OctreeNode * child = block->get(i, allocator);
+			children[i] = child != NULL ? copy(child, cube.getChild(i), bytes) : UINT_MAX;
+		}
+		result->setChildren(allocator, children);
+		*bytes += sizeof(ChildBlock);
+	}
+	return allocator.getIndex(result);
+}
+
+void OctreeJournal::release(uint node) {
+	if(node != UINT_MAX) {
+		OctreeNode * n = tree->allocator->get(node);
+		n->clear(*tree->allocator, NULL, NULL);
+		tree->allocator->deallocate(n);
+	}
+}
+
+void OctreeJournal::release(OctreeJournalStep &step) {
+	for(OctreeJournalEntry &entry : step.entries) {
+		if(entry.deep) {
+			release(entry.node);
+		}
+	}
+	step.entries.clear();
+	step.bytes = 0;
+}
+
+// Steps recorded after the current one can't be redone anymore.
+// Without a budget nothing is kept, the edit isn't recorded at all
+void OctreeJournal::begin() {
+	std::lock_guard<std::mutex> lock(mutex);
+	while(steps.size() > current) {
+		release(steps.back());
+		steps.pop_back();
+	}
+	recording = OctreeJournalStep();
+	if(budget == 0) {
+		enforceBudget();
+		return;
+	}
+	open = true;
+}
+
+// set before the shape starts and cleared after it, the shape threads only read it
+bool OctreeJournal::isOpen() const {
+	return open;
+}
+
+void OctreeJournal::end() {
+	std::lock_guard<std::mutex> lock(mutex);
+	open = false;
+	if(recording.entries.empty()) {
+		return;
+	}
+	steps.push_back(std::move(recording));
+	recording = OctreeJournalStep();
+	current = steps.size();
+	enforceBudget();
+}
+
+// oldest steps go first, a step bigger than the whole budget is not kept
+void OctreeJournal::enforceBudget() {
+	size_t total = 0;
+	for(OctreeJournalStep &step : steps) {
+		total += step.bytes;
+	}
+	while(total > budget && !steps.empty()) {
+		total -= steps.front().bytes;
+		release(steps.front());
+		steps.pop_front();
+		if(current > 0) {
+			--current;
+		}
+		if(steps.empty() && budget > 0) {
+			std::cout << "OctreeJournal: edit too big for the budget, it can't be undone" << std::endl;
+		}
+	}
+}
+
+// Node that the shape goes through, recorded before it changes
+void OctreeJournal::recordNode(OctreeNode * node, const BoundingCube &cube) {
+	if(!open) {
+		return;
+	}
+	// a paged out chunk has no block yet, the entry would drop its subtree on undo
+	tree->ensureLoaded(node, cube);
+	OctreeJournalEntry entry;
+	entry.cube = cube;
+	entry.deep = false;
+	entry.node = UINT_MAX;
+	entry.exists = true;
+	entry.hasBlock = node->id != UINT_MAX;
+	entry.bits = node->bits;
+	entry.payload = *node->getPayload(*tree->allocator);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	recording.entries.push_back(entry);
+	recording.bytes += sizeof(OctreeJournalEntry);
+}
+
+// Whatever the shape replaces without going through the children
+void OctreeJournal::recordSubtree(OctreeNode * node, const BoundingCube &cube) {
+	if(!open) {
+		return;
+	}
+	size_t bytes = sizeof(OctreeJournalEntry);
+	OctreeJournalEntry entry;
+	entry.cube = cube;
+	entry.deep = true;
+	entry.node = node != NULL ? copy(node, cube, &bytes) : UINT_MAX;
+	entry.exists = node != NULL;
+	entry.hasBlock = false;
+	entry.bits = 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	recording.entries.push_back(entry);
+	recording.bytes += bytes;
+}
+
+// Chunks of a subtree that leaves or joins the tree
+void OctreeJournal::notify(OctreeNode * node, const BoundingCube &cube, OctreeChangeHandler * handler, bool incoming) {
+	float length = cube.getLengthX();
+	if(node == NULL || length <= tree->chunkSize * 0.5f) {
+		return;
+	}
+	if(tree->isChunkNode(length)) {
+		if(incoming) {
+			node->setDirty(true);
+			if(handler != NULL) {
+				handler->dirty(cube, cube);
+				handler->update(node);
+			}
+			if(tree->pager != NULL) {
+				tree->pager->markModified(node, cube);
+			}
+		} else {
+			// the journal keeps it, whatever is on disk for it is not its content anymore
+			tree->ensureLoaded(node, cube);
+			if(handler != NULL) {
+				handler->erase(node);
+			}
+			if(tree->pager != NULL) {
+				tree->pager->forget(node);
+			}
+		}
+		return;
+	}
+	OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	node->getChildren(*tree->allocator, children);
+	for(int i = 0; i < 8; ++i) {
+		notify(children[i], cube.getChild(i), handler, incoming);
+	}
+}
+
+// Puts the entry of a slot in the tree and leaves what was there in the entry,
+// so the same call does the undo and the redo
+void OctreeJournal::swap(uint &slot, const BoundingCube &cube, tsl::robin_map<glm::vec4, uint> &entries, OctreeJournalStep &step, OctreeChangeHandler * handler) {
+	auto it = entries.find(getKey(cube));
+	if(it == entries.end()) {
+		// untouched by the step
+		return;
+	}
+	OctreeAllocator &allocator = *tree->allocator;
+	OctreeJournalEntry &entry = step.entries[it->second];
+
+	if(entry.deep) {
+		notify(slot != UINT_MAX ? allocator.get(slot) : NULL, cube, handler, false);
+		std::swap(slot, entry.node);
+		notify(slot != UINT_MAX ? allocator.get(slot) : NULL, cube, handler, true);
+		return;
+	}
+
+	bool existed = slot != UINT_MAX;
+	if(!existed) {
+		// freed by the edit, with its parent
+		slot = allocator.getIndex(allocator.allocate()->init(allocator, Vertex(cube.getCenter())));
+	}
+	OctreeNode * node = allocator.get(slot);
+	// the chunk may have been paged out since the step, its children are swapped below
+	tree->ensureLoaded(node, cube);
+	OctreeNodePayload * payload = node->getPayload(allocator);
+	OctreeJournalEntry previous = entry;
+	previous.exists = existed;
+	previous.hasBlock = node->id != UINT_MAX;
+	previous.bits = node->bits;
+	previous.payload = *payload;
+
+	node->bits = entry.bits;
+	*payload = entry.payload;
+	if(entry.hasBlock && node->id == UINT_MAX) {
+		node->allocate(allocator)->init();
+	}
+	ChildBlock * block = node->getBlock(allocator);
+	if(block != NULL) {
+		for(int i = 0; i < 8; ++i) {
+			swap(block->children[i], cube.getChild(i), entries, step, handler);
+		}
+		if(!entry.hasBlock) {
+			node->clear(allocator, handler, block);
+		}
+	}
+	bool isChunk = tree->isChunkNode(cube.getLengthX());
+	if(!entry.exists) {
+		if(isChunk) {
+			if(handler != NULL) {
+				handler->erase(node);
+			}
+			if(tree->pager != NULL) {
+				tree->pager->forget(node);
+			}
+		}
+		allocator.deallocate(node);
+		slot = UINT_MAX;
+	} else if(isChunk) {
+		// changed below, by its own entries
+		node->setDirty(true);
+		if(handler != NULL) {
+			handler->dirty(cube, cube);
+			handler->update(node);
+		}
+		if(tree->pager != NULL) {
+			tree->pager->markModified(node, cube);
+		}
+	}
+	entry = previous;
+}
+
+void OctreeJournal::swap(OctreeJournalStep &step, OctreeChangeHandler * handler) {
+	tsl::robin_map<glm::vec4, uint> entries;
+	entries.reserve(step.entries.size());
+	for(uint i = 0; i < step.entries.size(); ++i) {
+		entries[getKey(step.entries[i].cube)] = i;
+	}
+	OctreeAllocator &allocator = *tree->allocator;
+	uint root = tree->root != NULL ? allocator.getIndex(tree->root) : UINT_MAX;
+	swap(root, *tree, entries, step, handler);
+	tree->root = root != UINT_MAX ? allocator.get(root) : NULL;
+}
+
+bool OctreeJournal::undo(OctreeChangeHandler * handler) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(current == 0) {
+		return false;
+	}
+	--current;
+	swap(steps[current], handler);
+	std::cout << "OctreeJournal::undo() " << std::to_string(steps[current].entries.size()) << " entries" << std::endl;
+	return true;
+}
+
+bool OctreeJournal::redo(OctreeChangeHandler * handler) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(current >= steps.size()) {
+		return false;
+	}
+	swap(steps[current], handler);
+	std::cout << "OctreeJournal::redo() " << std::to_string(steps[current].entries.size()) << " entries" << std::endl;
+	++current;
+	return true;
+}
+
+bool OctreeJournal::canUndo() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return current > 0;
+}
+
+bool OctreeJournal::canRedo() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return current < steps.size();
+}
+
+// Without release the copies are left alone, for when the allocator was reset or replaced
+void OctreeJournal::clear(bool release) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(release) {
+		for(OctreeJournalStep &step : steps) {
+			this->release(step);
+		}
+		this->release(recording);
+	}
+	steps.clear();
+	recording = OctreeJournalStep();
+	current = 0;
+}
+
+std::string OctreeJournal::getStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t total = 0;
+	for(OctreeJournalStep &step : steps) {
+		total += step.bytes;
+	}
+	return "undo=" + std::to_string(current) + ", redo=" + std::to_string(steps.size() - current) + " (" + std::to_string(total >> 20) + "MB)";
+}
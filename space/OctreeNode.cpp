@@ -1,24 +1,20 @@
 #include "space.hpp"
 
 
-OctreeNode::OctreeNode() {
-	init(glm::vec3());
-}
-
-OctreeNode::OctreeNode(Vertex vertex) {
-	init(vertex);
-}
-
-OctreeNode * OctreeNode::init(Vertex vertex) {
-	memcpy(this->sdf, INFINITY_ARRAY, sizeof(float)*8);
+OctreeNode * OctreeNode::init(OctreeAllocator &allocator, Vertex vertex) {
 	this->bits = 0x0;
+	this->paging = 0x0;
 	this->setLeaf(false);
 	this->setSimplified(false);
 	this->setDirty(true);
 	this->setChunk(false);
 	this->setType(SpaceType::Empty);
-	this->vertex = vertex;
 	this->id = UINT_MAX;
+	OctreeNodePayload * payload = getPayload(allocator);
+	payload->setVertex(vertex);
+	payload->setSDF(INFINITY_ARRAY, 1.0f);
+	// unknown until the shape or the loader sets them
+	payload->setBounds(-INFINITY, INFINITY);
 	return this;
 }
 
@@ -60,12 +56,10 @@ ChildBlock * OctreeNode::allocate(OctreeAllocator &allocator) {
 
 
 
-OctreeNode::~OctreeNode() {
-
-}
-
 ChildBlock * OctreeNode::clear(OctreeAllocator &allocator, OctreeChangeHandler * handler, ChildBlock * block) {
-	handler->erase(this);
+	if(handler != NULL) {
+		handler->erase(this);
+	}
 	if(this->id != UINT_MAX) {
 		if(block == NULL) {
 			block = getBlock(allocator);
@@ -80,8 +74,50 @@ ChildBlock * OctreeNode::clear(OctreeAllocator &allocator, OctreeChangeHandler *
 	return block;
 }
 
-void OctreeNode::setSDF(float value[8]) {
-	memcpy(this->sdf, value, sizeof(float)*8);
+OctreeNodePayload * OctreeNode::getPayload(OctreeAllocator &allocator) const {
+	return allocator.getPayload(this);
+}
+
+Vertex OctreeNode::getVertex(OctreeAllocator &allocator) const {
+	return getPayload(allocator)->getVertex();
+}
+
+void OctreeNode::getSDF(OctreeAllocator &allocator, float out[8]) const {
+	getPayload(allocator)->getSDF(out);
+}
+
+// length is the cube length, it sets the quantization step
+void OctreeNode::setSDF(OctreeAllocator &allocator, const float value[8], float length) {
+	getPayload(allocator)->setSDF(value, length);
+}
+
+void OctreeNode::getBounds(OctreeAllocator &allocator, float out[2]) const {
+	getPayload(allocator)->getBounds(out);
+}
+
+// Range of the stored field over the subtree, from the corners and the bounds of the children.
+// A missing child is interpolated from the corners, so they cover it.
+void OctreeNode::updateBounds(OctreeAllocator &allocator) {
+	OctreeNodePayload * payload = getPayload(allocator);
+	float sdf[8];
+	payload->getSDF(sdf);
+	float min = sdf[0];
+	float max = sdf[0];
+	for(int i = 1; i < 8; ++i) {
+		min = glm::min(min, sdf[i]);
+		max = glm::max(max, sdf[i]);
+	}
+	OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	getChildren(allocator, children);
+	for(int i = 0; i < 8; ++i) {
+		if(children[i] != NULL) {
+			float bounds[2];
+			children[i]->getBounds(allocator, bounds);
+			min = glm::min(min, bounds[0]);
+			max = glm::max(max, bounds[1]);
+		}
+	}
+	payload->setBounds(min, max);
 }
 
 void OctreeNode::setType(SpaceType type) {
@@ -125,6 +161,63 @@ void OctreeNode::setLeaf(bool value) {
 	this->bits = (this->bits & ~mask) | (value ? mask : 0x0);
 }
 
+// a cleared flag comes after the whole subtree was written, readers that see it see the subtree
+bool OctreeNode::isUnloaded() const {
+	uint8_t value = std::atomic_ref<uint8_t>(const_cast<uint8_t&>(this->paging)).load(std::memory_order_acquire);
+	return value & (OCTREE_NODE_UNLOADED | OCTREE_NODE_LOADING);
+}
+
+// only while nothing traverses the node, see OctreePager::trim
+void OctreeNode::setUnloaded(bool value) {
+	std::atomic_ref<uint8_t> state(this->paging);
+	if(value) {
+		state.fetch_or(OCTREE_NODE_UNLOADED, std::memory_order_release);
+	} else {
+		state.fetch_and(~OCTREE_NODE_UNLOADED, std::memory_order_release);
+	}
+}
+
+// true for the one thread that gets to read the subtree, the others waitLoading()
+bool OctreeNode::beginLoading() {
+	std::atomic_ref<uint8_t> state(this->paging);
+	uint8_t value = state.load(std::memory_order_acquire);
+	while(value & OCTREE_NODE_UNLOADED) {
+		uint8_t loading = (value & ~OCTREE_NODE_UNLOADED) | OCTREE_NODE_LOADING;
+		if(state.compare_exchange_weak(value, loading, std::memory_order_acquire)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void OctreeNode::endLoading() {
+	std::atomic_ref<uint8_t> state(this->paging);
+	state.fetch_and(~OCTREE_NODE_LOADING, std::memory_order_release);
+	state.notify_all();
+}
+
+void OctreeNode::waitLoading() const {
+	std::atomic_ref<uint8_t> state(const_cast<uint8_t&>(this->paging));
+	uint8_t value = state.load(std::memory_order_acquire);
+	while(value & OCTREE_NODE_LOADING) {
+		state.wait(value, std::memory_order_acquire);
+		value = state.load(std::memory_order_acquire);
+	}
+}
+
+// visited since the last trim, read before writing so hot chunks don't bounce the cache line
+void OctreeNode::setReferenced() {
+	std::atomic_ref<uint8_t> state(this->paging);
+	if(!(state.load(std::memory_order_relaxed) & OCTREE_NODE_REFERENCED)) {
+		state.fetch_or(OCTREE_NODE_REFERENCED, std::memory_order_relaxed);
+	}
+}
+
+bool OctreeNode::takeReferenced() {
+	std::atomic_ref<uint8_t> state(this->paging);
+	return state.fetch_and(~OCTREE_NODE_REFERENCED, std::memory_order_relaxed) & OCTREE_NODE_REFERENCED;
+}
+
 SpaceType OctreeNode::getType() const {
 	if(this->bits & (0x1 << 0)) {
 		return SpaceType::Solid;
@@ -169,7 +262,9 @@ uint OctreeNode::exportSerialization(OctreeAllocator &allocator, std::vector<Oct
 	}
 	uint index = nodes->size(); 
 
-	OctreeNodeCubeSerialized n(this->sdf, cube, this->vertex, this->bits, level);
+	float sdf[8];
+	getSDF(allocator, sdf);
+	OctreeNodeCubeSerialized n(sdf, cube, getVertex(allocator), this->bits, level);
 	nodes->push_back(n);
 	if(isLeaf()) {
 		++(*leafNodes);
@@ -8,15 +8,49 @@ OctreeNodeFile::OctreeNodeFile(Octree * tree, OctreeNode * node, std::string fil
 	this->tree = tree;
 }
 
-OctreeNode * OctreeNodeFile::loadRecursive(OctreeNode * node, int i, BoundingCube &cube, std::vector<OctreeNodeSerialized> * nodes) {
+uint64_t OctreeCornerLattice::getKey(const glm::uvec3 &corner) {
+	return ((uint64_t) corner.x) | (((uint64_t) corner.y) << 21) | (((uint64_t) corner.z) << 42);
+}
+
+// corner i of the node at min with the given size, in lattice units
+glm::uvec3 OctreeCornerLattice::getCorner(const glm::uvec3 &min, uint size, int i) {
+	return min + glm::uvec3((i >> 2) & 1, (i >> 1) & 1, i & 1) * size;
+}
+
+// step of a node's own payload, overrides are stored with it
+static float getNodeScale(const BoundingCube &cube) {
+	return OCTREE_SDF_RANGE * cube.getLengthX() / QUANTIZED_SDF_MAX;
+}
+
+// levels of the subtree. Evicted chunks below are read first, they would be written as bare leaves
+static uint getDepth(Octree * tree, OctreeNode * node, const BoundingCube &cube) {
+	tree->ensureLoaded(node, cube);
+	OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	node->getChildren(*tree->allocator, children);
+	uint depth = 0;
+	for(int i = 0; i < 8; ++i) {
+		if(children[i] != NULL) {
+			depth = glm::max(depth, 1 + getDepth(tree, children[i], cube.getChild(i)));
+		}
+	}
+	return depth;
+}
+
+static OctreeNode * createNode(Octree * tree, const BoundingCube &cube, float sdf[8], int brushIndex, uint8_t bits) {
+	glm::vec3 position = SDF::getAveragePosition(sdf, cube);
+	glm::vec3 normal = SDF::getNormalFromPosition(sdf, cube, position);
+	Vertex vertex(position, normal, glm::vec2(0), brushIndex);
+	OctreeNode * node = tree->allocator->allocate()->init(*tree->allocator, vertex);
+	node->setSDF(*tree->allocator, sdf, cube.getLengthX());
+	node->bits = bits;
+	return node;
+}
+
+// files written before the corner lattice
+OctreeNode * OctreeNodeFile::loadLegacy(OctreeNode * node, int i, BoundingCube &cube, std::vector<OctreeNodeSerialized> * nodes) {
 	OctreeNodeSerialized serialized = nodes->at(i);
 	if(node == NULL) {
-		glm::vec3 position = SDF::getAveragePosition(serialized.sdf, cube);
-		glm::vec3 normal = SDF::getNormalFromPosition(serialized.sdf, cube, position);
-		Vertex vertex(position, normal, glm::vec2(0), serialized.brushIndex);
-		node = tree->allocator->allocate()->init(vertex);
-		node->setSDF(serialized.sdf);
-		node->bits = serialized.bits;
+		node = createNode(tree, cube, serialized.sdf, serialized.brushIndex, serialized.bits);
 	}
 
 	if(node->isChunk()){
@@ -34,76 +68,227 @@ OctreeNode * OctreeNodeFile::loadRecursive(OctreeNode * node, int i, BoundingCub
 		int index = serialized.children[j];
 		if(index != 0) {
 			BoundingCube c = cube.getChild(j);
-			block->set(j , loadRecursive(NULL, index, c, nodes), *tree->allocator);
+			block->set(j , loadLegacy(NULL, index, c, nodes), *tree->allocator);
 		}
 	}
 
 	return node;
 }
 
+OctreeNode * OctreeNodeFile::loadRecursive(OctreeNode * node, uint i, BoundingCube &cube, glm::uvec3 min, uint depth, OctreeCornerLattice &lattice, tsl::robin_map<uint, uint> &overrides) {
+	OctreeLatticeNode &serialized = lattice.nodes.at(i);
+	uint size = depth <= OCTREE_LATTICE_DEPTH ? 1u << (OCTREE_LATTICE_DEPTH - depth) : 0;
+	if(node == NULL) {
+		float sdf[8];
+		if(serialized.shared) {
+			for(int j = 0; j < 8; ++j) {
+				auto it = lattice.corners.find(OctreeCornerLattice::getKey(OctreeCornerLattice::getCorner(min, size, j)));
+				sdf[j] = it != lattice.corners.end() ? dequantizeSDF(it->second, lattice.scale) : INFINITY;
+			}
+		} else {
+			OctreeLatticeOverride &entry = lattice.overrides.at(overrides.at(i));
+			float scale = lattice.version < 2 ? lattice.scale : getNodeScale(cube);
+			for(int j = 0; j < 8; ++j) {
+				sdf[j] = dequantizeSDF(entry.sdf[j], scale);
+			}
+		}
+		node = createNode(tree, cube, sdf, serialized.brushIndex, serialized.bits);
+	}
+
+	if(node->isChunk()){
+		node->setDirty(true);
+	}
+	bool isLeaf = true;
+	for(int j=0; j < 8; ++j) {
+		if(serialized.children[j] != 0) {
+			isLeaf = false;
+			break;
+		}
+	}
+	ChildBlock * block = isLeaf ? NULL : node->allocate(*tree->allocator)->init();
+	for(int j=0 ; j <8 ; ++j){
+		uint index = serialized.children[j];
+		if(index != 0) {
+			BoundingCube c = cube.getChild(j);
+			glm::uvec3 childMin = OctreeCornerLattice::getCorner(min, size / 2, j);
+			block->set(j , loadRecursive(NULL, index, c, childMin, depth + 1, lattice, overrides), *tree->allocator);
+		}
+	}
+
+	return node;
+}
 
-void OctreeNodeFile::load(std::string baseFolder, BoundingCube &cube) {
+bool OctreeNodeFile::load(std::string baseFolder, BoundingCube &cube) {
 	std::ifstream file = std::ifstream(filename, std::ios::binary);
     if (!file) {
         std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return;
+        return false;
     }
 
     std::stringstream decompressed = gzipDecompressFromIfstream(file);
+    file.close();
+
+	uint64_t magic = 0;
+	decompressed.read(reinterpret_cast<char*>(&magic), sizeof(uint64_t));
+	if(magic != OCTREE_LATTICE_MAGIC) {
+		size_t size = magic;
+		std::vector<OctreeNodeSerialized> nodes;
+		nodes.resize(size);
+		decompressed.read(reinterpret_cast<char*>(nodes.data()), size * sizeof(OctreeNodeSerialized));
+		loadLegacy(node, 0, cube, &nodes);
+		tree->updateBounds(node, false);
+		return true;
+	}
 
-	size_t size;
-	decompressed.read(reinterpret_cast<char*>(&size), sizeof(size_t) );
+	OctreeLatticeHeader header;
+	decompressed.seekg(0);
+	decompressed.read(reinterpret_cast<char*>(&header), sizeof(OctreeLatticeHeader));
+	if(header.version < 1 || header.version > OCTREE_LATTICE_VERSION) {
+		std::cerr << "Unknown chunk file version " << header.version << ": " << filename << std::endl;
+		return false;
+	}
 
-	std::vector<OctreeNodeSerialized> nodes;
-	nodes.resize(size);
+	OctreeCornerLattice lattice;
+	lattice.version = header.version;
+	lattice.scale = header.scale;
+	lattice.nodes.resize(header.nodes);
+	lattice.overrides.resize(header.overrides);
+	std::vector<uint64_t> keys(header.corners);
+	std::vector<int16_t> values(header.corners);
+	decompressed.read(reinterpret_cast<char*>(lattice.nodes.data()), header.nodes * sizeof(OctreeLatticeNode));
+	decompressed.read(reinterpret_cast<char*>(keys.data()), header.corners * sizeof(uint64_t));
+	decompressed.read(reinterpret_cast<char*>(values.data()), header.corners * sizeof(int16_t));
+	decompressed.read(reinterpret_cast<char*>(lattice.overrides.data()), header.overrides * sizeof(OctreeLatticeOverride));
+	if(!decompressed || header.nodes == 0) {
+		std::cerr << "Truncated chunk file: " << filename << std::endl;
+		return false;
+	}
 
-   	decompressed.read(reinterpret_cast<char*>(nodes.data()), size * sizeof(OctreeNodeSerialized));
-	loadRecursive(node, 0, cube, &nodes);
-    file.close();
-	nodes.clear();
+	lattice.corners.reserve(keys.size());
+	for(size_t i = 0; i < keys.size(); ++i) {
+		lattice.corners[keys[i]] = values[i];
+	}
+	tsl::robin_map<uint, uint> overrides;
+	overrides.reserve(lattice.overrides.size());
+	for(uint i = 0; i < lattice.overrides.size(); ++i) {
+		overrides[lattice.overrides[i].node] = i;
+	}
+
+	loadRecursive(node, 0, cube, glm::uvec3(0), 0, lattice, overrides);
+	// the bounds aren't stored, the subtree has them all in memory now
+	tree->updateBounds(node, false);
+	return true;
 }
 
 
-uint OctreeNodeFile::saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes) {
-	if(node!=NULL) {
-		OctreeNodeSerialized n = OctreeNodeSerialized();
-		n.brushIndex = node->vertex.brushIndex;
-		n.bits = node->bits;
-		SDF::copySDF(node->sdf, n.sdf);
+uint OctreeNodeFile::saveRecursive(OctreeNode * node, const BoundingCube &cube, glm::uvec3 min, uint depth, OctreeCornerLattice &lattice) {
+	if(node == NULL) {
+		return 0;
+	}
+	OctreeLatticeNode n = OctreeLatticeNode();
+	n.brushIndex = node->getPayload(*tree->allocator)->brushIndex;
+	n.bits = node->bits;
+	n.shared = 0;
 
-		uint index = nodes->size(); 
-		nodes->push_back(n);
-		OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
-		node->getChildren(*tree->allocator, children);
-		for(int i=0; i < 8; ++i) {
-            (*nodes)[index].children[i] = saveRecursive(children[i], nodes);
+	float sdf[8];
+	int16_t quantized[8];
+	node->getSDF(*tree->allocator, sdf);
+	float nodeScale = getNodeScale(cube);
+	for(int j = 0; j < 8; ++j) {
+		quantized[j] = quantizeSDF(sdf[j], lattice.scale);
+	}
+
+	// shared when every corner is either new or already holds the same value, and the lattice
+	// step keeps it as precise as the node itself (far corners of big nodes don't fit in int16)
+	uint size = depth <= OCTREE_LATTICE_DEPTH ? 1u << (OCTREE_LATTICE_DEPTH - depth) : 0;
+	uint64_t keys[8];
+	if(depth <= OCTREE_LATTICE_DEPTH) {
+		n.shared = 1;
+		for(int j = 0; j < 8; ++j) {
+			float value = dequantizeSDF(quantized[j], lattice.scale);
+			bool precise = std::isinf(sdf[j]) ? value == sdf[j] : glm::abs(value - sdf[j]) <= nodeScale * 0.5f;
+			if(!precise) {
+				n.shared = 0;
+				break;
+			}
+			keys[j] = OctreeCornerLattice::getKey(OctreeCornerLattice::getCorner(min, size, j));
+			auto it = lattice.corners.find(keys[j]);
+			if(it != lattice.corners.end() && it->second != quantized[j]) {
+				n.shared = 0;
+				break;
+			}
 		}
-		return index;
 	}
-	return 0;
-}
 
-void OctreeNodeFile::save(std::string baseFolder){
-    std::vector<OctreeNodeSerialized> nodes;
+	uint index = lattice.nodes.size();
+	if(n.shared) {
+		for(int j = 0; j < 8; ++j) {
+			lattice.corners.insert({keys[j], quantized[j]});
+		}
+	} else {
+		OctreeLatticeOverride entry = OctreeLatticeOverride();
+		entry.node = index;
+		for(int j = 0; j < 8; ++j) {
+			entry.sdf[j] = quantizeSDF(sdf[j], nodeScale);
+		}
+		lattice.overrides.push_back(entry);
+	}
+	lattice.nodes.push_back(n);
 
+	OctreeNode * children[8] = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+	node->getChildren(*tree->allocator, children);
+	for(int i=0; i < 8; ++i) {
+		uint child = saveRecursive(children[i], cube.getChild(i), OctreeCornerLattice::getCorner(min, size / 2, i), depth + 1, lattice);
+		lattice.nodes[index].children[i] = child;
+	}
+	return index;
+}
+
+// cube is the one of the saved node. The lattice step is the one of the deepest node, coarser
+// nodes are multiples of it in memory and round trip exactly while they fit in int16
+bool OctreeNodeFile::save(std::string baseFolder, const BoundingCube &cube){
 	std::ofstream file = std::ofstream(filename, std::ios::binary);
     if (!file) {
         std::cerr << "Error opening file for writing: " << filename << std::endl;
-        return;
+        return false;
     }
 
-	saveRecursive(node, &nodes);
+	OctreeCornerLattice lattice;
+	lattice.version = OCTREE_LATTICE_VERSION;
+	uint depth = glm::min(getDepth(tree, node, cube), (uint) OCTREE_LATTICE_DEPTH);
+	lattice.scale = getNodeScale(cube) / (float) (1u << depth);
+	saveRecursive(node, cube, glm::uvec3(0), 0, lattice);
+
+	// sorted keys and the values apart compress better
+	std::vector<std::pair<uint64_t, int16_t>> corners(lattice.corners.begin(), lattice.corners.end());
+	std::sort(corners.begin(), corners.end());
+	std::vector<uint64_t> keys;
+	std::vector<int16_t> values;
+	keys.reserve(corners.size());
+	values.reserve(corners.size());
+	for(auto &corner : corners) {
+		keys.push_back(corner.first);
+		values.push_back(corner.second);
+	}
+
+	OctreeLatticeHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = OCTREE_LATTICE_MAGIC;
+	header.version = OCTREE_LATTICE_VERSION;
+	header.scale = lattice.scale;
+	header.nodes = lattice.nodes.size();
+	header.corners = keys.size();
+	header.overrides = lattice.overrides.size();
 
-	size_t size = nodes.size();
-	//std::cout << "Saving " << std::to_string(size) << " nodes" << std::endl;
-	//std::cout << std::to_string(sizeof(OctreeNodeSerialized)) << " bytes/node" << std::endl;
     std::ostringstream decompressed;
-	decompressed.write(reinterpret_cast<const char*>(&size), sizeof(size_t) );
-	decompressed.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(OctreeNodeSerialized) );
-	
+	decompressed.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	decompressed.write(reinterpret_cast<const char*>(lattice.nodes.data()), lattice.nodes.size() * sizeof(OctreeLatticeNode));
+	decompressed.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(uint64_t));
+	decompressed.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(int16_t));
+	decompressed.write(reinterpret_cast<const char*>(lattice.overrides.data()), lattice.overrides.size() * sizeof(OctreeLatticeOverride));
+
 	std::istringstream inputStream(decompressed.str());
  	gzipCompressToOfstream(inputStream, file);
 	file.close();
-
-	nodes.clear();
-}
\ No newline at end of file
+	return !file.fail();
+}
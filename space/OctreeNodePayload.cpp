@@ -0,0 +1,96 @@
+#include "space.hpp"
+
+static uint packAxis(float value, int shift) {
+	int q = (int) glm::round(glm::clamp(value, -1.0f, 1.0f) * 511.0f);
+	return ((uint) q & 0x3ff) << shift;
+}
+
+static float unpackAxis(uint packed, int shift) {
+	// sign extend the 10 bits
+	int q = ((int) (packed << (22 - shift))) >> 22;
+	return q / 511.0f;
+}
+
+Vertex OctreeNodePayload::getVertex() const {
+	glm::vec3 n = glm::vec3(unpackAxis(normal, 0), unpackAxis(normal, 10), unpackAxis(normal, 20));
+	return Vertex(position, n, texCoord, brushIndex);
+}
+
+void OctreeNodePayload::setVertex(const Vertex &vertex) {
+	this->position = glm::vec3(vertex.position);
+	this->normal = packAxis(vertex.normal.x, 0) | packAxis(vertex.normal.y, 10) | packAxis(vertex.normal.z, 20);
+	this->texCoord = vertex.texCoord;
+	this->brushIndex = vertex.brushIndex;
+}
+
+int16_t quantizeSDF(float value, float scale) {
+	if(std::isinf(value)) {
+		return value > 0.0f ? QUANTIZED_SDF_INFINITY : -QUANTIZED_SDF_INFINITY;
+	}
+	float q = glm::clamp(glm::round(value / scale), (float) -QUANTIZED_SDF_MAX, (float) QUANTIZED_SDF_MAX);
+	// never round a corner onto the surface from the wrong side
+	if(q == 0.0f && value != 0.0f) {
+		q = value < 0.0f ? -1.0f : 1.0f;
+	}
+	return (int16_t) q;
+}
+
+float dequantizeSDF(int16_t value, float scale) {
+	if(value == QUANTIZED_SDF_INFINITY) {
+		return INFINITY;
+	} else if(value == -QUANTIZED_SDF_INFINITY) {
+		return -INFINITY;
+	}
+	return value * scale;
+}
+
+#ifdef OCTREE_QUANTIZED_SDF
+
+void OctreeNodePayload::getSDF(float out[8]) const {
+	for(int i = 0; i < 8; ++i) {
+		out[i] = dequantizeSDF(sdf[i], scale);
+	}
+}
+
+void OctreeNodePayload::setSDF(const float value[8], float length) {
+	this->scale = OCTREE_SDF_RANGE * length / QUANTIZED_SDF_MAX;
+	for(int i = 0; i < 8; ++i) {
+		sdf[i] = quantizeSDF(value[i], scale);
+	}
+}
+
+void OctreeNodePayload::getBounds(float out[2]) const {
+	out[0] = dequantizeSDF(bounds[0], scale);
+	out[1] = dequantizeSDF(bounds[1], scale);
+}
+
+// Same scale as the corners, set them first. Rounded outwards, a min below the quantized
+// range becomes -infinity and a max above it +infinity, so the range always holds the subtree
+void OctreeNodePayload::setBounds(float min, float max) {
+	float low = glm::floor(min / scale);
+	float high = glm::ceil(max / scale);
+	bounds[0] = low < -QUANTIZED_SDF_MAX ? -QUANTIZED_SDF_INFINITY : (int16_t) glm::min(low, (float) QUANTIZED_SDF_MAX);
+	bounds[1] = high > QUANTIZED_SDF_MAX ? QUANTIZED_SDF_INFINITY : (int16_t) glm::max(high, (float) -QUANTIZED_SDF_MAX);
+}
+
+#else
+
+void OctreeNodePayload::getSDF(float out[8]) const {
+	SDF::copySDF(sdf, out);
+}
+
+void OctreeNodePayload::setSDF(const float value[8], float length) {
+	SDF::copySDF(value, sdf);
+}
+
+void OctreeNodePayload::getBounds(float out[2]) const {
+	out[0] = bounds[0];
+	out[1] = bounds[1];
+}
+
+void OctreeNodePayload::setBounds(float min, float max) {
+	bounds[0] = min;
+	bounds[1] = max;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#include "space.hpp"
+
+OctreePager::OctreePager(Octree * tree, std::string baseFolder, std::string filename, size_t budget) {
+	this->tree = tree;
+	this->baseFolder = baseFolder;
+	this->swapFolder = baseFolder + "/" + filename + ".swap";
+	this->filename = filename;
+	this->budget = budget;
+	this->residentBytes = 0;
+	this->faults = 0;
+	this->evictions = 0;
+	this->writes = 0;
+	// leftovers from a previous run are not valid anymore
+	std::filesystem::remove_all(swapFolder);
+}
+
+OctreePager::~OctreePager() {
+	std::filesystem::remove_all(swapFolder);
+}
+
+std::string OctreePager::getPath(const OctreeNode * node, const BoundingCube &cube) {
+	std::string name = "/" + filename + "_" + getChunkName(cube) + ".bin";
+	bool inSwap;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		inSwap = swapped.find((OctreeNode*) node) != swapped.end();
+	}
+	return (inSwap ? swapFolder : baseFolder) + name;
+}
+
+void OctreePager::setBudget(size_t budget) {
+	std::lock_guard<std::mutex> lock(mutex);
+	this->budget = budget;
+}
+
+size_t OctreePager::measure(OctreeNode * node) {
+	size_t bytes = sizeof(OctreeNode) + sizeof(OctreeNodePayload);
+	ChildBlock * block = node->getBlock(*tree->allocator);
+	if(block != NULL) {
+		bytes += sizeof(ChildBlock);
+		for(int i = 0; i < 8; ++i) {
+			OctreeNode * child = block->get(i, *tree->allocator);
+			if(child != NULL) {
+				bytes += measure(child);
+			}
+		}
+	}
+	return bytes;
+}
+
+// The chunk is read outside of the lock, other chunks fault in meanwhile and
+// threads reaching this one wait for it alone
+void OctreePager::fault(OctreeNode * node, const BoundingCube &cube) {
+	if(!node->beginLoading()) {
+		// someone else is loading it, or already did
+		node->waitLoading();
+		return;
+	}
+	std::string path = getPath(node, cube);
+
+	// a reload doesn't need a new mesh, keep whatever the chunk had
+	bool dirty = node->isDirty();
+	BoundingCube chunkCube = cube;
+	OctreeNodeFile file(tree, node, path);
+	bool ok = false;
+	try {
+		ok = file.load(baseFolder, chunkCube);
+	} catch(const std::exception &e) {
+		std::cerr << "OctreePager::fault() " << e.what() << std::endl;
+	}
+	if(!ok) {
+		std::cerr << "OctreePager::fault() chunk lost, left empty: " << path << std::endl;
+	}
+	node->setDirty(dirty);
+	size_t bytes = measure(node);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lru.push_front(node);
+		Entry entry = { bytes, false, cube, lru.begin() };
+		resident[node] = entry;
+		residentBytes += entry.bytes;
+		++faults;
+	}
+
+	// readers that see the flag cleared see the whole subtree
+	node->endLoading();
+}
+
+// Called on every chunk visit, so it only marks the node, trim() moves the marked ones up the LRU
+void OctreePager::touch(OctreeNode * node) {
+	node->setReferenced();
+}
+
+void OctreePager::markModified(OctreeNode * node, const BoundingCube &cube) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = resident.find(node);
+	if(it == resident.end()) {
+		// chunk created by an edit, it has no file yet
+		lru.push_front(node);
+		Entry entry = { measure(node), true, cube, lru.begin() };
+		resident[node] = entry;
+		residentBytes += entry.bytes;
+	} else {
+		Entry &entry = it.value();
+		residentBytes -= entry.bytes;
+		entry.bytes = measure(node);
+		entry.modified = true;
+		residentBytes += entry.bytes;
+		lru.splice(lru.begin(), lru, entry.lru);
+	}
+}
+
+// The node left the tree (OctreeJournal), it's not paged anymore
+void OctreePager::forget(OctreeNode * node) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = resident.find(node);
+	if(it != resident.end()) {
+		residentBytes -= it->second.bytes;
+		lru.erase(it->second.lru);
+		resident.erase(it);
+	}
+	swapped.erase(node);
+}
+
+bool OctreePager::writeBack(OctreeNode * node, Entry &entry) {
+	ensureFolderExists(swapFolder);
+	std::string path = swapFolder + "/" + filename + "_" + getChunkName(entry.cube) + ".bin";
+	OctreeNodeFile file(tree, node, path + ".tmp");
+	if(!file.save(swapFolder, entry.cube)) {
+		return false;
+	}
+	std::filesystem::rename(path + ".tmp", path);
+	swapped.insert(node);
+	entry.modified = false;
+	++writes;
+	return true;
+}
+
+void OctreePager::trim() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(budget == 0) {
+		return;
+	}
+	size_t kept = 0;
+	while(residentBytes > budget && lru.size() > kept) {
+		OctreeNode * node = lru.back();
+		auto it = resident.find(node);
+		Entry &entry = it.value();
+		if(node->takeReferenced()) {
+			// visited since the last trim, gets another round (second chance)
+			lru.splice(lru.begin(), lru, entry.lru);
+			continue;
+		}
+		if(entry.modified && !writeBack(node, entry)) {
+			// can't lose the edits, try again on the next trim
+			std::cerr << "OctreePager::trim() write back failed for " << getChunkName(entry.cube) << std::endl;
+			lru.splice(lru.begin(), lru, entry.lru);
+			++kept;
+			continue;
+		}
+		ChildBlock * block = node->getBlock(*tree->allocator);
+		if(block != NULL) {
+			node->clear(*tree->allocator, NULL, block);
+		}
+		node->setUnloaded(true);
+		residentBytes -= entry.bytes;
+		lru.pop_back();
+		resident.erase(it);
+		++evictions;
+	}
+}
+
+void OctreePager::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	resident.clear();
+	swapped.clear();
+	lru.clear();
+	residentBytes = 0;
+}
+
+size_t OctreePager::getResidentBytes() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return residentBytes;
+}
+
+std::string OctreePager::getStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return "resident=" + std::to_string(resident.size()) + " (" + std::to_string(residentBytes >> 20) + "MB), faults=" + std::to_string(faults) + ", evictions=" + std::to_string(evictions) + ", writes=" + std::to_string(writes);
+}
@@ -0,0 +1,337 @@
+#include "space.hpp"
+
+// below this many queries a packet is not worth a task
+#define QUERY_TASK_MIN 64
+// newton steps of closestPoint
+#define QUERY_PROJECTIONS 16
+// capsule samples of a sweep or overlap
+#define QUERY_CAPSULE_SAMPLES 32
+
+// Entry and exit of the ray in the cube, false when it misses
+static bool intersect(const BoundingCube &cube, const glm::vec3 &origin, const glm::vec3 &direction, float * near, float * far) {
+	glm::vec3 inv;
+	for(int i = 0; i < 3; ++i) {
+		inv[i] = direction[i] != 0.0f ? 1.0f / direction[i] : 1e30f;
+	}
+	glm::vec3 t0 = (cube.getMin() - origin) * inv;
+	glm::vec3 t1 = (cube.getMax() - origin) * inv;
+	glm::vec3 tmin = glm::min(t0, t1);
+	glm::vec3 tmax = glm::max(t0, t1);
+	*near = glm::max(tmin.x, glm::max(tmin.y, tmin.z));
+	*far = glm::min(tmax.x, glm::min(tmax.y, tmax.z));
+	return *far >= glm::max(*near, 0.0f);
+}
+
+static float outsideDistance(const BoundingCube &cube, const glm::vec3 &pos) {
+	return glm::length(glm::max(glm::max(cube.getMin() - pos, pos - cube.getMax()), glm::vec3(0.0f)));
+}
+
+static float insideDistance(const BoundingCube &cube, const glm::vec3 &pos) {
+	glm::vec3 d = glm::min(pos - cube.getMin(), cube.getMax() - pos);
+	return glm::max(glm::min(d.x, glm::min(d.y, d.z)), 0.0f);
+}
+
+// Same value as SDF::interpolate, with its gradient. Corners are x*4 + y*2 + z
+static float trilinear(const float sdf[8], const BoundingCube &cube, const glm::vec3 &pos, glm::vec3 * gradient) {
+	float length = cube.getLengthX();
+	glm::vec3 l = glm::clamp((pos - cube.getMin()) / length, 0.0f, 1.0f);
+	float c00 = glm::mix(sdf[0], sdf[1], l.z);
+	float c01 = glm::mix(sdf[2], sdf[3], l.z);
+	float c10 = glm::mix(sdf[4], sdf[5], l.z);
+	float c11 = glm::mix(sdf[6], sdf[7], l.z);
+	float c0 = glm::mix(c00, c01, l.y);
+	float c1 = glm::mix(c10, c11, l.y);
+	float dz = glm::mix(glm::mix(sdf[1] - sdf[0], sdf[3] - sdf[2], l.y), glm::mix(sdf[5] - sdf[4], sdf[7] - sdf[6], l.y), l.x);
+	*gradient = glm::vec3(c1 - c0, glm::mix(c01 - c00, c11 - c10, l.x), dz) / length;
+	return glm::mix(c0, c1, l.x);
+}
+
+static glm::vec3 normalOf(const glm::vec3 &gradient, const glm::vec3 &fallback) {
+	float length = glm::length(gradient);
+	return length > 1e-12f && std::isfinite(length) ? gradient / length : fallback;
+}
+
+static OctreeHit miss(float distance) {
+	return OctreeHit{false, distance, glm::vec3(0.0f), glm::vec3(0.0f), NULL};
+}
+
+OctreeQuery::OctreeQuery(Octree * tree, float epsilon, uint maxSteps) : tree(tree), context(*tree) {
+	this->epsilon = epsilon;
+	this->maxSteps = maxSteps;
+}
+
+// Node NULL outside of the tree
+void OctreeQuery::locate(const glm::vec3 &pos, ThreadContext * context, OctreeQueryCell * cell) const {
+	OctreeNodeLevel level = tree->getNodeAt(pos, INT_MAX, false, context);
+	cell->node = level.node;
+	if(cell->node == NULL) {
+		cell->type = SpaceType::Empty;
+		return;
+	}
+	// an ancestor whose bounds don't cross zero has no surface anywhere in its cube
+	std::vector<OctreePathEntry> &path = context->path;
+	for(size_t k = 0; k + 1 < path.size(); ++k) {
+		float bounds[2];
+		path[k].node->getBounds(*tree->allocator, bounds);
+		if(bounds[0] > 0.0f || bounds[1] < 0.0f) {
+			cell->node = path[k].node;
+			cell->cube = path[k].cube;
+			cell->node->getSDF(*tree->allocator, cell->sdf);
+			cell->type = bounds[0] > 0.0f ? SpaceType::Empty : SpaceType::Solid;
+			return;
+		}
+	}
+	BoundingCube cube = path.back().cube;
+	float sdf[8];
+	cell->node->getSDF(*tree->allocator, sdf);
+	if(cell->node->getBlock(*tree->allocator) == NULL) {
+		cell->cube = cube;
+		SDF::copySDF(sdf, cell->sdf);
+		cell->type = cell->node->getType();
+		return;
+	}
+	// the edits only drop children without surface, the parent corners still cover them
+	cell->cube = cube.getChild(getNodeIndex(pos, cube));
+	glm::vec3 gradient;
+	for(int i = 0; i < 8; ++i) {
+		glm::vec3 corner = cell->cube.getMin() + glm::vec3((i >> 2) & 1, (i >> 1) & 1, i & 1) * cell->cube.getLengthX();
+		cell->sdf[i] = trilinear(sdf, cube, corner, &gradient);
+	}
+	cell->type = SDF::eval(cell->sdf);
+}
+
+// Stored SDF at pos, INFINITY outside of the tree. Cubes without surface are at least as
+// far as their own border
+float OctreeQuery::distance(const glm::vec3 &pos, ThreadContext * context, OctreeQueryCell * cell, glm::vec3 * gradient) const {
+	locate(pos, context, cell);
+	if(cell->node == NULL) {
+		*gradient = glm::vec3(0.0f);
+		return INFINITY;
+	}
+	float d = trilinear(cell->sdf, cell->cube, pos, gradient);
+	if(cell->type == SpaceType::Empty) {
+		float border = insideDistance(cell->cube, pos);
+		d = std::isfinite(d) ? glm::max(d, border) : border;
+	}
+	return d;
+}
+
+// Lower bound of the distance between the capsule moved by offset and the surface, samples
+// along the segment are at most h apart so h/2 is taken out. Samples outside of the tree
+// only bound the step (reach), they can't touch anything
+float OctreeQuery::clearance(const OctreeCapsule &capsule, const glm::vec3 &offset, ThreadContext * context, float * reach, OctreeHit * contact) const {
+	glm::vec3 segment = capsule.b - capsule.a;
+	float length = glm::length(segment);
+	int intervals = length > 0.0f ? glm::clamp((int) glm::ceil(length / glm::max(capsule.radius, epsilon)), 1, QUERY_CAPSULE_SAMPLES) : 0;
+	float slack = intervals > 0 ? 0.5f * length / intervals : 0.0f;
+
+	float result = INFINITY;
+	*reach = INFINITY;
+	OctreeQueryCell cell;
+	glm::vec3 gradient;
+	for(int i = 0; i <= intervals; ++i) {
+		glm::vec3 pos = capsule.a + offset + (intervals > 0 ? segment * ((float) i / intervals) : glm::vec3(0.0f));
+		float d = distance(pos, context, &cell, &gradient);
+		if(cell.node == NULL) {
+			*reach = glm::min(*reach, outsideDistance(*tree, pos) - capsule.radius - slack);
+			continue;
+		}
+		if(d - capsule.radius - slack < result) {
+			result = d - capsule.radius - slack;
+			contact->node = cell.node;
+			contact->normal = normalOf(gradient, glm::vec3(0.0f, 1.0f, 0.0f));
+			contact->position = pos - contact->normal * d;
+		}
+	}
+	return result;
+}
+
+// Bisection between a point of the ray inside the surface and one outside
+float OctreeQuery::refine(const OctreeRay &ray, float inside, float outside, ThreadContext * context) const {
+	OctreeQueryCell cell;
+	glm::vec3 gradient;
+	for(int i = 0; i < 16 && glm::abs(inside - outside) > epsilon; ++i) {
+		float middle = (inside + outside) * 0.5f;
+		if(distance(ray.origin + ray.direction * middle, context, &cell, &gradient) <= 0.0f) {
+			inside = middle;
+		} else {
+			outside = middle;
+		}
+	}
+	return inside;
+}
+
+// Sphere tracing over the stored SDF, cubes without surface are crossed in one step and
+// a step never leaves the cube it started in, so thin walls aren't jumped over
+OctreeHit OctreeQuery::raycast(const OctreeRay &ray, ThreadContext * context) const {
+	OctreeHit hit = miss(ray.length);
+	float t, end;
+	if(!intersect(*tree, ray.origin, ray.direction, &t, &end)) {
+		return hit;
+	}
+	t = glm::max(t, 0.0f);
+	end = glm::min(end, ray.length);
+
+	float outside = -1.0f; // last t known to be out of the surface
+	OctreeQueryCell cell;
+	glm::vec3 gradient;
+	for(uint step = 0; step < maxSteps && t <= end; ++step) {
+		float d = distance(ray.origin + ray.direction * t, context, &cell, &gradient);
+		if(cell.node == NULL) {
+			break;
+		}
+		float near, far;
+		intersect(cell.cube, ray.origin, ray.direction, &near, &far);
+		if(cell.type == SpaceType::Empty) {
+			outside = t;
+			t = glm::max(far, t) + epsilon;
+			continue;
+		}
+		if(d <= epsilon) {
+			if(d < 0.0f && outside >= 0.0f) {
+				t = refine(ray, t, outside, context);
+				distance(ray.origin + ray.direction * t, context, &cell, &gradient);
+			}
+			hit.hit = true;
+			hit.distance = t;
+			hit.position = ray.origin + ray.direction * t;
+			hit.normal = normalOf(gradient, -ray.direction);
+			hit.node = cell.node;
+			return hit;
+		}
+		outside = t;
+		t = glm::min(t + d, glm::max(far, t) + epsilon);
+	}
+	return hit;
+}
+
+// Same tracing with the clearance of the capsule instead of the distance of a point
+OctreeHit OctreeQuery::sweep(const OctreeSweep &sweep, ThreadContext * context) const {
+	OctreeHit hit = miss(sweep.length);
+	OctreeHit contact = miss(0.0f);
+	float t = 0.0f;
+	for(uint step = 0; step < maxSteps && t <= sweep.length; ++step) {
+		float reach;
+		float c = clearance(sweep.capsule, sweep.direction * t, context, &reach, &contact);
+		if(c <= epsilon) {
+			contact.hit = true;
+			contact.distance = t;
+			return contact;
+		}
+		float advance = glm::min(c, reach);
+		if(!std::isfinite(advance)) {
+			break;
+		}
+		t += glm::max(advance, epsilon);
+	}
+	return hit;
+}
+
+// Newton projection onto the surface along the gradient of the stored SDF
+OctreeHit OctreeQuery::closestPoint(const glm::vec3 &pos, float maxDistance, ThreadContext * context) const {
+	OctreeHit hit = miss(maxDistance);
+	OctreeQueryCell cell;
+	glm::vec3 gradient;
+	glm::vec3 current = pos;
+	for(int i = 0; i < QUERY_PROJECTIONS; ++i) {
+		float d = distance(current, context, &cell, &gradient);
+		if(!std::isfinite(d) || (i == 0 && glm::abs(d) > maxDistance)) {
+			return hit;
+		}
+		glm::vec3 normal = normalOf(gradient, glm::vec3(0.0f));
+		if(glm::abs(d) <= epsilon) {
+			hit.hit = true;
+			hit.distance = glm::distance(pos, current);
+			hit.position = current;
+			hit.normal = normal;
+			hit.node = cell.node;
+			return hit;
+		}
+		if(normal == glm::vec3(0.0f)) {
+			return hit;
+		}
+		current -= normal * d;
+	}
+	return hit;
+}
+
+// Conservative, a capsule closer than half its sample spacing counts as touching
+bool OctreeQuery::overlaps(const OctreeCapsule &capsule, ThreadContext * context) const {
+	float reach;
+	OctreeHit contact = miss(0.0f);
+	return clearance(capsule, glm::vec3(0.0f), context, &reach, &contact) <= 0.0f;
+}
+
+// The tree may have changed since the last one, the descent starts over from the root
+OctreeHit OctreeQuery::raycast(const OctreeRay &ray) {
+	context.path.clear();
+	return raycast(ray, &context);
+}
+
+OctreeHit OctreeQuery::sweep(const OctreeSweep &sweep) {
+	context.path.clear();
+	return this->sweep(sweep, &context);
+}
+
+OctreeHit OctreeQuery::closestPoint(const glm::vec3 &pos, float maxDistance) {
+	context.path.clear();
+	return closestPoint(pos, maxDistance, &context);
+}
+
+bool OctreeQuery::overlaps(const OctreeCapsule &capsule) {
+	context.path.clear();
+	return overlaps(capsule, &context);
+}
+
+// Contiguous slices, one per thread, neighbor queries of a packet share their descents.
+// Must not be called from a task of the same pool
+template <typename Q, typename R, typename F> void OctreeQuery::run(const std::vector<Q> &queries, std::vector<R> &results, F query) {
+	results.resize(queries.size());
+	context.path.clear();
+	size_t tasks = std::min(tree->threadPool.threadCount(), (queries.size() + QUERY_TASK_MIN - 1) / QUERY_TASK_MIN);
+	if(tasks <= 1) {
+		for(size_t i = 0; i < queries.size(); ++i) {
+			results[i] = query(queries[i], &context);
+		}
+		return;
+	}
+	size_t slice = (queries.size() + tasks - 1) / tasks;
+	std::vector<std::future<void>> futures;
+	futures.reserve(tasks);
+	for(size_t begin = 0; begin < queries.size(); begin += slice) {
+		size_t end = std::min(begin + slice, queries.size());
+		futures.emplace_back(tree->threadPool.enqueue([this, &queries, &results, &query, begin, end]() {
+			ThreadContext local(*tree);
+			for(size_t i = begin; i < end; ++i) {
+				results[i] = query(queries[i], &local);
+			}
+		}));
+	}
+	for(std::future<void> &f : futures) {
+		f.get();
+	}
+}
+
+void OctreeQuery::raycast(const std::vector<OctreeRay> &rays, std::vector<OctreeHit> &hits) {
+	run(rays, hits, [this](const OctreeRay &ray, ThreadContext * context) {
+		return raycast(ray, context);
+	});
+}
+
+void OctreeQuery::sweep(const std::vector<OctreeSweep> &sweeps, std::vector<OctreeHit> &hits) {
+	run(sweeps, hits, [this](const OctreeSweep &sweep, ThreadContext * context) {
+		return this->sweep(sweep, context);
+	});
+}
+
+void OctreeQuery::closestPoint(const std::vector<glm::vec3> &points, float maxDistance, std::vector<OctreeHit> &hits) {
+	run(points, hits, [this, maxDistance](const glm::vec3 &pos, ThreadContext * context) {
+		return closestPoint(pos, maxDistance, context);
+	});
+}
+
+void OctreeQuery::overlaps(const std::vector<OctreeCapsule> &capsules, std::vector<uint8_t> &results) {
+	run(capsules, results, [this](const OctreeCapsule &capsule, ThreadContext * context) {
+		return (uint8_t) overlaps(capsule, context);
+	});
+}
@@ -0,0 +1,141 @@
+#include "space.hpp"
+#include <chrono>
+
+#define SDF_GRID_SIDE (SDF_GRID_BRICK + 1)
+#define SDF_GRID_SAMPLES (SDF_GRID_SIDE * SDF_GRID_SIDE * SDF_GRID_SIDE)
+
+static int getSampleIndex(const glm::ivec3 &c) {
+	return (c.x * SDF_GRID_SIDE + c.y) * SDF_GRID_SIDE + c.z;
+}
+
+OctreeSdfGrid::OctreeSdfGrid(Octree * tree, const BoundingBox &box, float step, float margin) {
+	auto start = std::chrono::steady_clock::now();
+	this->tree = tree;
+	this->step = step;
+	this->min = glm::floor(box.getMin() / step) * step;
+	glm::vec3 max = glm::ceil(box.getMax() / step) * step;
+	this->cells = glm::max(glm::ivec3(glm::round((max - min) / step)), glm::ivec3(1));
+	this->bricks = (cells + SDF_GRID_BRICK - 1) / SDF_GRID_BRICK;
+
+	// the bounds of the tree tell which bricks are away from the surface
+	size_t count = (size_t) bricks.x * bricks.y * bricks.z;
+	slots.assign(count, UINT_MAX);
+	constants.assign(count, INFINITY);
+	std::vector<uint> dense;
+	float brickLength = step * SDF_GRID_BRICK;
+	for(int x = 0; x < bricks.x; ++x) {
+		for(int y = 0; y < bricks.y; ++y) {
+			for(int z = 0; z < bricks.z; ++z) {
+				uint i = (x * bricks.y + y) * bricks.z + z;
+				glm::vec2 range = tree->getSdfRange(BoundingCube(min + glm::vec3(x, y, z) * brickLength, brickLength));
+				if(range.x > margin) {
+					constants[i] = range.x;
+				} else if(range.y < -margin) {
+					constants[i] = range.y;
+				} else {
+					slots[i] = dense.size() * SDF_GRID_SAMPLES;
+					dense.push_back(i);
+				}
+			}
+		}
+	}
+	samples.assign(dense.size() * SDF_GRID_SAMPLES, INFINITY);
+
+	// every brick walks the nodes over it once and owns its samples, no locking
+	if(tree->root != NULL && !dense.empty()) {
+		size_t tasks = std::min(tree->threadPool.threadCount(), dense.size());
+		size_t slice = (dense.size() + tasks - 1) / tasks;
+		std::vector<std::future<void>> futures;
+		for(size_t begin = 0; begin < dense.size(); begin += slice) {
+			size_t end = std::min(begin + slice, dense.size());
+			futures.emplace_back(tree->threadPool.enqueue([this, &dense, begin, end]() {
+				for(size_t k = begin; k < end; ++k) {
+					uint i = dense[k];
+					glm::ivec3 brick = glm::ivec3(i / (bricks.y * bricks.z), (i / bricks.z) % bricks.y, i % bricks.z);
+					fill(this->tree->root, *this->tree, brick * SDF_GRID_BRICK, &samples[slots[i]]);
+				}
+			}));
+		}
+		for(std::future<void> &f : futures) {
+			f.get();
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::cout << "OctreeSdfGrid " << getStats() << " in " << std::chrono::duration<double, std::milli>(end - start).count() << "ms" << std::endl;
+}
+
+// Samples of the brick at origin that lie in the cube, the ones on its faces included
+bool OctreeSdfGrid::getSamples(const BoundingCube &cube, const glm::ivec3 &origin, glm::ivec3 &from, glm::ivec3 &to) const {
+	glm::vec3 low = (cube.getMin() - min) / step - glm::vec3(origin);
+	glm::vec3 high = (cube.getMax() - min) / step - glm::vec3(origin);
+	from = glm::max(glm::ivec3(glm::ceil(low - 1e-3f)), glm::ivec3(0));
+	to = glm::min(glm::ivec3(glm::floor(high + 1e-3f)), glm::ivec3(SDF_GRID_BRICK));
+	return glm::all(glm::lessThanEqual(from, to));
+}
+
+// Same field as getSdfAt: the deepest node over a sample, a missing child takes its parent's
+// corners. Children go in order, so a sample on a shared face keeps the upper one like getSdfAt.
+void OctreeSdfGrid::fill(OctreeNode * node, const BoundingCube &cube, const glm::ivec3 &origin, float * values) const {
+	glm::ivec3 from, to;
+	if(!getSamples(cube, origin, from, to)) {
+		return;
+	}
+	tree->ensureLoaded(node, cube);
+	float sdf[8];
+	node->getSDF(*tree->allocator, sdf);
+	ChildBlock * block = node->getBlock(*tree->allocator);
+	if(block == NULL) {
+		write(cube, cube, sdf, origin, values);
+		return;
+	}
+	for(int i = 0; i < 8; ++i) {
+		BoundingCube childCube = cube.getChild(i);
+		OctreeNode * child = block->get(i, *tree->allocator);
+		if(child != NULL) {
+			fill(child, childCube, origin, values);
+		} else {
+			write(childCube, cube, sdf, origin, values);
+		}
+	}
+}
+
+void OctreeSdfGrid::write(const BoundingCube &cube, const BoundingCube &sdfCube, const float sdf[8], const glm::ivec3 &origin, float * values) const {
+	glm::ivec3 from, to;
+	if(!getSamples(cube, origin, from, to)) {
+		return;
+	}
+	for(int x = from.x; x <= to.x; ++x) {
+		for(int y = from.y; y <= to.y; ++y) {
+			for(int z = from.z; z <= to.z; ++z) {
+				glm::ivec3 c = glm::ivec3(x, y, z);
+				glm::vec3 pos = min + glm::vec3(origin + c) * step;
+				values[getSampleIndex(c)] = SDF::interpolate(sdf, pos, sdfCube);
+			}
+		}
+	}
+}
+
+float OctreeSdfGrid::distance(const glm::vec3 &pos) const {
+	glm::vec3 local = (pos - min) / step;
+	if(glm::any(glm::lessThan(local, glm::vec3(0.0f))) || glm::any(glm::greaterThan(local, glm::vec3(cells)))) {
+		return tree->getSdfAt(pos);
+	}
+	glm::ivec3 cell = glm::min(glm::ivec3(local), cells - 1);
+	glm::ivec3 brick = cell / SDF_GRID_BRICK;
+	uint i = (brick.x * bricks.y + brick.y) * bricks.z + brick.z;
+	if(slots[i] == UINT_MAX) {
+		return constants[i];
+	}
+	const float * values = &samples[slots[i]];
+	glm::ivec3 c = cell - brick * SDF_GRID_BRICK;
+	float sdf[8];
+	for(int j = 0; j < 8; ++j) {
+		sdf[j] = values[getSampleIndex(c + glm::ivec3((j >> 2) & 1, (j >> 1) & 1, j & 1))];
+	}
+	return SDF::interpolate(sdf, pos, BoundingCube(min + glm::vec3(cell) * step, step));
+}
+
+std::string OctreeSdfGrid::getStats() const {
+	size_t dense = samples.size() / SDF_GRID_SAMPLES;
+	return "bricks=" + std::to_string(slots.size()) + ", dense=" + std::to_string(dense) + " (" + std::to_string((samples.size() * sizeof(float)) >> 20) + "MB)";
+}
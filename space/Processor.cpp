@@ -1,7 +1,7 @@
 #include "space.hpp"
 
 
-Processor::Processor(long * count, ThreadPool &threadPool, ThreadContext * context, std::vector<OctreeNodeTriangleHandler*> * handlers): threadPool(threadPool), context(context), handlers(handlers) {
+Processor::Processor(long * count, ThreadPool &threadPool, ThreadContext * context, std::vector<OctreeNodeTriangleHandler*> * handlers, const ChunkMesh * mesh, uint64_t blocks): threadPool(threadPool), context(context), handlers(handlers), mesh(mesh), blocks(blocks) {
 
 }
 
@@ -10,6 +10,10 @@ bool Processor::test(const Octree &tree, OctreeNodeData &params) {
         return false;
     }
     else {	
+        // clean sub-blocks keep their triangles
+        if(mesh != NULL && (mesh->getBlocks(params.cube) & blocks) == 0) {
+            return false;
+        }
         if(params.node->isLeaf()) {
             params.context = params.node;
         }
@@ -24,8 +28,16 @@ void Processor::before(const Octree &tree, OctreeNodeData &params) {
 //std::mutex processorMutex;
 void Processor::after(const Octree &tree, OctreeNodeData &params) {
     if(params.context != NULL) {
+        if(mesh != NULL && !(blocks & (((uint64_t) 1) << mesh->getBlockIndex(params.cube.getCenter())))) {
+            return;
+        }
+        for(OctreeNodeTriangleHandler * handler : *handlers) {
+            handler->beginCell(params.cube);
+        }
         bool nodeIterated = false;
-        tree.iterateBorder(params.node, params.cube, params.sdf, params.level, tree.root, tree, tree.root->sdf, 0, nodeIterated,
+        float rootSDF[8];
+        tree.root->getSDF(*tree.allocator, rootSDF);
+        tree.iterateBorder(params.node, params.cube, params.sdf, params.level, tree.root, tree, rootSDF, 0, nodeIterated,
             [this, &tree, params](const BoundingCube &cube, const float sdf[8], uint level){
                 tree.handleQuadNodes(cube, level, sdf, handlers, true, context);
             }, context
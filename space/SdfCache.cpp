@@ -0,0 +1,85 @@
+#include "space.hpp"
+
+SdfCache::SdfCache(const BoundingCube &cube) {
+	this->min = cube.getMin();
+	this->unit = cube.getLengthX() / (1u << SDF_CACHE_BITS);
+}
+
+SdfCache::Shard &SdfCache::getShard(uint64_t key) {
+	return shards[(key * 0x9E3779B97F4A7C15ull) >> 58];
+}
+
+// Keys of the 8 corners of a node of the tree for the operation at index, false when it is deeper than the lattice.
+// Coordinates go up to 2^SDF_CACHE_BITS inclusive, hence the extra bit per axis, the index takes the bits left.
+// The node min is snapped to a multiple of its own size, so the float error of the
+// cube never moves a corner and neighbors always agree on the shared ones.
+bool SdfCache::getKeys(const BoundingCube &cube, uint index, uint64_t keys[8]) const {
+	float size = glm::round(cube.getLengthX() / unit);
+	if(size < 1.0f) {
+		return false;
+	}
+	glm::vec3 cell = glm::round((cube.getMin() - min) / (unit * size));
+	float limit = (float) (1u << SDF_CACHE_BITS);
+	if(glm::any(glm::lessThan(cell, glm::vec3(0.0f))) || glm::any(glm::greaterThan(cell * size + size, glm::vec3(limit)))) {
+		return false;
+	}
+	glm::uvec3 corner = glm::uvec3(cell * size);
+	uint s = (uint) size;
+	for(int i = 0; i < 8; ++i) {
+		glm::uvec3 c = corner + glm::uvec3((i >> 2) & 1, (i >> 1) & 1, i & 1) * s;
+		keys[i] = ((uint64_t) c.x) | (((uint64_t) c.y) << (SDF_CACHE_BITS + 1)) | (((uint64_t) c.z) << (2 * SDF_CACHE_BITS + 2)) | (((uint64_t) index) << (3 * SDF_CACHE_BITS + 3));
+	}
+	return true;
+}
+
+SdfCacheLookup SdfCache::claim(uint64_t key, float * value) {
+	Shard &shard = getShard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.entries.find(key);
+	if(it == shard.entries.end()) {
+		shard.entries[key] = { 0.0f, false };
+		++shard.misses;
+		return SDF_CACHE_CLAIMED;
+	}
+	if(!it->second.ready) {
+		++shard.waits;
+		return SDF_CACHE_PENDING;
+	}
+	++shard.hits;
+	*value = it->second.value;
+	return SDF_CACHE_HIT;
+}
+
+void SdfCache::publish(uint64_t key, float value) {
+	Shard &shard = getShard(key);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	shard.entries[key] = { value, true };
+}
+
+// Only called after the caller published its own claims, so two threads can't wait on each other
+float SdfCache::wait(uint64_t key) {
+	Shard &shard = getShard(key);
+	while(true) {
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(key);
+			if(it != shard.entries.end() && it->second.ready) {
+				return it->second.value;
+			}
+		}
+		std::this_thread::yield();
+	}
+}
+
+std::string SdfCache::getStats() {
+	uint64_t hits = 0, misses = 0, waits = 0;
+	for(Shard &shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		hits += shard.hits;
+		misses += shard.misses;
+		waits += shard.waits;
+	}
+	uint64_t total = hits + misses + waits;
+	int rate = total > 0 ? (int) (100 * (hits + waits) / total) : 0;
+	return "sdf evaluated=" + std::to_string(misses) + ", hits=" + std::to_string(hits) + ", waits=" + std::to_string(waits) + " (" + std::to_string(rate) + "% hit rate)";
+}
@@ -0,0 +1,374 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+
+// Group of tasks that can be waited on as a whole (fork/join)
+class TaskGroup {
+public:
+    std::atomic<int> pending{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    bool done() const {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+struct TaskSchedulerStats {
+    long tasks = 0;
+    long steals = 0;
+};
+
+// Tasks submitted while a batch is current on the submitting thread, and the tasks they submit in
+// turn. Threads outside the scheduler only help with their own batch when they wait, and the
+// stats of a batch only count its tasks, so concurrent batches on the shared scheduler stay apart.
+class TaskBatch {
+public:
+    explicit TaskBatch(size_t workers) : executed(workers + 1), stolen(workers + 1) {}
+    // one slot per worker, the last one for the threads outside
+    std::vector<std::atomic<long>> executed;
+    std::vector<std::atomic<long>> stolen;
+};
+
+// Work-stealing scheduler with a fixed number of workers.
+// Each worker owns a deque: the owner pushes/pops at the back (LIFO, keeps the
+// recursion depth-first and cache friendly) while thieves take from the front.
+// Threads that are not workers submit through a shared injection queue.
+// wait() never blocks idle, the caller keeps executing tasks until its group is done. Workers run
+// any task meanwhile, other threads only the tasks of their TaskBatch (or of the group without one).
+class TaskScheduler {
+public:
+    explicit TaskScheduler(size_t threads);
+    ~TaskScheduler();
+
+    void submit(TaskGroup &group, std::function<void()> task);
+    void wait(TaskGroup &group);
+
+    size_t workerCount() const;
+    // Last entry holds the work done by external threads while waiting
+    std::vector<TaskSchedulerStats> getStats() const;
+    std::vector<TaskSchedulerStats> getStats(const TaskBatch &batch) const;
+    TaskSchedulerStats getTotalStats() const;
+    TaskSchedulerStats getTotalStats(const TaskBatch &batch) const;
+    // One scheduler per process, every tree shapes on the same workers
+    static TaskScheduler &shared();
+
+private:
+    friend class TaskBatchScope;
+
+    struct Task {
+        std::function<void()> function;
+        TaskGroup * group;
+        TaskBatch * batch;
+    };
+
+    struct Worker {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+        std::atomic<long> executed{0};
+        std::atomic<long> stolen{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    Worker external;
+
+    std::atomic<size_t> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable condition;
+    bool stop;
+
+    bool tryRun(int index);
+    bool tryRunOwn(const TaskGroup &group);
+    bool popLocal(int index, Task &task);
+    bool popInjected(Task &task);
+    bool steal(int index, Task &task);
+    bool takeOwn(std::deque<Task> &tasks, std::mutex &mutex, const TaskGroup &group, Task &task);
+    void execute(Task &task, Worker &worker, int index);
+    int currentWorker() const;
+
+    static thread_local TaskScheduler * currentScheduler;
+    static thread_local int currentIndex;
+    static thread_local TaskBatch * currentBatch;
+};
+
+inline thread_local TaskScheduler * TaskScheduler::currentScheduler = nullptr;
+inline thread_local int TaskScheduler::currentIndex = -1;
+inline thread_local TaskBatch * TaskScheduler::currentBatch = nullptr;
+
+// Makes batch current on this thread until the end of the scope
+class TaskBatchScope {
+public:
+    explicit TaskBatchScope(TaskBatch &batch) : previous(TaskScheduler::currentBatch) {
+        TaskScheduler::currentBatch = &batch;
+    }
+    ~TaskBatchScope() {
+        TaskScheduler::currentBatch = previous;
+    }
+    TaskBatchScope(const TaskBatchScope &) = delete;
+    TaskBatchScope &operator=(const TaskBatchScope &) = delete;
+private:
+    TaskBatch * previous;
+};
+
+inline TaskScheduler::TaskScheduler(size_t threads)
+    : stop(false)
+{
+    if(threads == 0) {
+        threads = 1;
+    }
+    for(size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(std::make_unique<Worker>());
+    }
+    for(size_t i = 0; i < threads; ++i) {
+        this->threads.emplace_back([this, i] {
+            currentScheduler = this;
+            currentIndex = (int) i;
+            for(;;) {
+                if(tryRun((int) i)) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(this->sleepMutex);
+                this->condition.wait(lock, [this]{ return this->stop || this->queued.load() > 0; });
+                if(this->stop && this->queued.load() == 0) {
+                    return;
+                }
+            }
+        });
+    }
+}
+
+inline TaskScheduler::~TaskScheduler()
+{
+    {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for(auto &thread : threads) {
+        if(thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+inline TaskScheduler &TaskScheduler::shared() {
+    static TaskScheduler scheduler(std::thread::hardware_concurrency());
+    return scheduler;
+}
+
+inline int TaskScheduler::currentWorker() const {
+    return currentScheduler == this ? currentIndex : -1;
+}
+
+inline size_t TaskScheduler::workerCount() const {
+    return workers.size();
+}
+
+inline void TaskScheduler::submit(TaskGroup &group, std::function<void()> task) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    int index = currentWorker();
+    Worker &target = index >= 0 ? *workers[index] : external;
+    {
+        std::lock_guard<std::mutex> lock(target.mutex);
+        target.tasks.push_back(Task{std::move(task), &group, currentBatch});
+    }
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    condition.notify_one();
+}
+
+inline void TaskScheduler::wait(TaskGroup &group) {
+    int index = currentWorker();
+    while(!group.done()) {
+        bool ran = index >= 0 ? tryRun(index) : tryRunOwn(group);
+        if(!ran) {
+            std::this_thread::yield();
+        }
+    }
+    if(group.error) {
+        std::exception_ptr error = group.error;
+        group.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+inline bool TaskScheduler::popLocal(int index, Task &task) {
+    Worker &worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if(worker.tasks.empty()) {
+        return false;
+    }
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+inline bool TaskScheduler::popInjected(Task &task) {
+    std::lock_guard<std::mutex> lock(external.mutex);
+    if(external.tasks.empty()) {
+        return false;
+    }
+    task = std::move(external.tasks.front());
+    external.tasks.pop_front();
+    return true;
+}
+
+inline bool TaskScheduler::steal(int index, Task &task) {
+    size_t count = workers.size();
+    size_t start = index >= 0 ? (size_t) index + 1 : 0;
+    for(size_t k = 0; k < count; ++k) {
+        size_t victim = (start + k) % count;
+        if((int) victim == index) {
+            continue;
+        }
+        Worker &worker = *workers[victim];
+        std::unique_lock<std::mutex> lock(worker.mutex, std::try_to_lock);
+        if(!lock.owns_lock() || worker.tasks.empty()) {
+            continue;
+        }
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+inline bool TaskScheduler::tryRun(int index) {
+    if(queued.load() == 0) {
+        return false;
+    }
+    Task task;
+    Worker &self = index >= 0 ? *workers[index] : external;
+    if(index >= 0 && popLocal(index, task)) {
+        queued.fetch_sub(1);
+        execute(task, self, index);
+        return true;
+    }
+    if(popInjected(task)) {
+        queued.fetch_sub(1);
+        execute(task, self, index);
+        return true;
+    }
+    if(steal(index, task)) {
+        queued.fetch_sub(1);
+        self.stolen.fetch_add(1, std::memory_order_relaxed);
+        if(task.batch != nullptr) {
+            task.batch->stolen[index >= 0 ? (size_t) index : workers.size()].fetch_add(1, std::memory_order_relaxed);
+        }
+        execute(task, self, index);
+        return true;
+    }
+    return false;
+}
+
+// Oldest task of the waiter's batch (or of the group itself without a batch), a thread outside
+// the workers must not pick up the subtree of someone else's edit
+inline bool TaskScheduler::takeOwn(std::deque<Task> &tasks, std::mutex &mutex, const TaskGroup &group, Task &task) {
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if(!lock.owns_lock()) {
+        return false;
+    }
+    for(auto it = tasks.begin(); it != tasks.end(); ++it) {
+        if(currentBatch != nullptr ? it->batch == currentBatch : it->group == &group) {
+            task = std::move(*it);
+            tasks.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool TaskScheduler::tryRunOwn(const TaskGroup &group) {
+    if(queued.load() == 0) {
+        return false;
+    }
+    Task task;
+    bool found = takeOwn(external.tasks, external.mutex, group, task);
+    for(size_t i = 0; !found && i < workers.size(); ++i) {
+        found = takeOwn(workers[i]->tasks, workers[i]->mutex, group, task);
+        if(found) {
+            external.stolen.fetch_add(1, std::memory_order_relaxed);
+            if(task.batch != nullptr) {
+                task.batch->stolen[workers.size()].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    if(!found) {
+        return false;
+    }
+    queued.fetch_sub(1);
+    execute(task, external, -1);
+    return true;
+}
+
+inline void TaskScheduler::execute(Task &task, Worker &worker, int index) {
+    // whatever the task submits belongs to its batch
+    TaskBatch * previous = currentBatch;
+    currentBatch = task.batch;
+    try {
+        task.function();
+    } catch(...) {
+        std::lock_guard<std::mutex> lock(task.group->errorMutex);
+        if(!task.group->error) {
+            task.group->error = std::current_exception();
+        }
+    }
+    currentBatch = previous;
+    worker.executed.fetch_add(1, std::memory_order_relaxed);
+    if(task.batch != nullptr) {
+        task.batch->executed[index >= 0 ? (size_t) index : workers.size()].fetch_add(1, std::memory_order_relaxed);
+    }
+    task.group->pending.fetch_sub(1, std::memory_order_release);
+}
+
+inline std::vector<TaskSchedulerStats> TaskScheduler::getStats() const {
+    std::vector<TaskSchedulerStats> stats;
+    stats.reserve(workers.size() + 1);
+    for(const auto &worker : workers) {
+        stats.push_back(TaskSchedulerStats{worker->executed.load(), worker->stolen.load()});
+    }
+    stats.push_back(TaskSchedulerStats{external.executed.load(), external.stolen.load()});
+    return stats;
+}
+
+inline std::vector<TaskSchedulerStats> TaskScheduler::getStats(const TaskBatch &batch) const {
+    std::vector<TaskSchedulerStats> stats;
+    stats.reserve(batch.executed.size());
+    for(size_t i = 0; i < batch.executed.size(); ++i) {
+        stats.push_back(TaskSchedulerStats{batch.executed[i].load(), batch.stolen[i].load()});
+    }
+    return stats;
+}
+
+inline TaskSchedulerStats TaskScheduler::getTotalStats() const {
+    TaskSchedulerStats total;
+    for(const TaskSchedulerStats &s : getStats()) {
+        total.tasks += s.tasks;
+        total.steals += s.steals;
+    }
+    return total;
+}
+
+inline TaskSchedulerStats TaskScheduler::getTotalStats(const TaskBatch &batch) const {
+    TaskSchedulerStats total;
+    for(const TaskSchedulerStats &s : getStats(batch)) {
+        total.tasks += s.tasks;
+        total.steals += s.steals;
+    }
+    return total;
+}
+
+#endif
@@ -1,8 +1,14 @@
 #include "space.hpp"
 
 
-Tesselator::Tesselator(long * count, ThreadContext * context): OctreeNodeTriangleHandler(count), context(context) {
-    this->geometry = new Geometry(false);
+Tesselator::Tesselator(long * count, ThreadContext * context, ChunkMesh * mesh): OctreeNodeTriangleHandler(count), context(context), mesh(mesh) {
+    this->geometry = mesh == NULL ? new Geometry(false) : NULL;
+}
+
+void Tesselator::beginCell(const BoundingCube &cube) {
+    if(mesh != NULL) {
+        geometry = mesh->getGeometry(mesh->getBlockIndex(cube.getCenter()));
+    }
 }
 
 
@@ -5,18 +5,24 @@
 #include <future>
 #include <tsl/robin_map.h>
 #include <unordered_set>
+#include <list>
+#include <deque>
 #include <utility>
 #include <shared_mutex>
 #include "../math/math.hpp"
 #include "../sdf/SDF.hpp"
 #define SQRT_3_OVER_2 0.866025404f
-#include "ThreadPool.hpp"
+#define SDF_BATCH_SIZE 32
+#include "../math/ThreadPool.hpp"
+#include "TaskScheduler.hpp"
 #include "Allocator.hpp"
 
 class Octree;
 class OctreeNode;
 class OctreeAllocator;
 class Simplifier;
+class OctreePager;
+class OctreeJournal;
 struct ChildBlock;
 
 const float INFINITY_ARRAY [8] = {INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY,INFINITY};
@@ -24,6 +30,8 @@ const uint UINT_MAX_ARRAY [8] = {UINT_MAX,UINT_MAX,UINT_MAX,UINT_MAX,UINT_MAX,UI
 
 typedef std::function<void(const BoundingCube &childCube, const float sdf[8], uint level)> IterateBorderHandler;
 
+int getNodeIndex(const glm::vec3 &vec, const BoundingCube &cube);
+
 #pragma pack(16)  // Ensure 16-byte alignment for UBO
 struct OctreeSerialized {
     public:
@@ -79,20 +87,58 @@ class OctreeChangeHandler {
 	virtual void create(OctreeNode* nodeId) = 0;
 	virtual void update(OctreeNode* nodeId) = 0;
 	virtual void erase(OctreeNode* nodeId) = 0;
+	// region of a chunk touched by an edit, reported once per chunk sub-block (ChunkMesh)
+	virtual void dirty(const BoundingCube &chunk, const BoundingCube &region) {}
 };
 
+// corners are kept as int16 scaled by the cube length, comment out to keep full floats
+#define OCTREE_QUANTIZED_SDF 1
+// quantized corners further than this many cube lengths are clamped, the sign is kept
+#define OCTREE_SDF_RANGE 4.0f
+
+// int16 corner distances, +-QUANTIZED_SDF_INFINITY keep the infinities
+#define QUANTIZED_SDF_INFINITY 32767
+#define QUANTIZED_SDF_MAX 32766
+int16_t quantizeSDF(float value, float scale);
+float dequantizeSDF(int16_t value, float scale);
+
+// Cold part of a node, only read when meshing or editing. Lives in OctreeAllocator::payloadAllocator
+// at the same index as its node so traversals, that only need bits and children, stay in the small records.
+struct OctreeNodePayload {
+	glm::vec3 position;
+	uint normal; // 10 bits per axis
+	glm::vec2 texCoord;
+	int brushIndex;
+#ifdef OCTREE_QUANTIZED_SDF
+	float scale;
+	int16_t sdf[8];
+	int16_t bounds[2]; // min and max of the subtree, rounded outwards
+#else
+	float sdf[8];
+	float bounds[2];
+#endif
+
+	Vertex getVertex() const;
+	void setVertex(const Vertex &vertex);
+	void getSDF(float out[8]) const;
+	void setSDF(const float value[8], float length);
+	void getBounds(float out[2]) const;
+	void setBounds(float min, float max);
+};
+
+// OctreeNode::paging, only ever accessed atomically: traversals read it while the pager loads
+#define OCTREE_NODE_UNLOADED 0x1
+#define OCTREE_NODE_LOADING 0x2
+#define OCTREE_NODE_REFERENCED 0x4
+
 class OctreeNode {
 
 	public: 
-		Vertex vertex;
 		uint id;
 		uint8_t bits;
-		float sdf[8];
+		uint8_t paging;
 
-		OctreeNode();
-		OctreeNode(Vertex vertex);
-		~OctreeNode();
-		OctreeNode * init(Vertex vertex);
+		OctreeNode * init(OctreeAllocator &allocator, Vertex vertex);
 		ChildBlock * clear(OctreeAllocator &allocator, OctreeChangeHandler * handler, ChildBlock * block);
 		ChildBlock * getBlock(OctreeAllocator &allocator) const;
 		ChildBlock * allocate(OctreeAllocator &allocator);
@@ -113,9 +159,23 @@ class OctreeNode {
 		bool isLeaf() const ;
 		void setLeaf(bool value);
 
+		// chunk whose subtree only exists on disk (OctreePager), or is being read
+		bool isUnloaded() const ;
+		void setUnloaded(bool value);
+		bool beginLoading();
+		void endLoading();
+		void waitLoading() const;
+		void setReferenced();
+		bool takeReferenced();
+
 		SpaceType getType() const ;
 
-		void setSDF(float value[8]);
+		OctreeNodePayload * getPayload(OctreeAllocator &allocator) const;
+		Vertex getVertex(OctreeAllocator &allocator) const;
+		void getSDF(OctreeAllocator &allocator, float out[8]) const;
+		void setSDF(OctreeAllocator &allocator, const float value[8], float length);
+		void getBounds(OctreeAllocator &allocator, float out[2]) const;
+		void updateBounds(OctreeAllocator &allocator);
 		uint exportSerialization(OctreeAllocator &allocator, std::vector<OctreeNodeCubeSerialized> * nodes, int * leafNodes, BoundingCube cube, BoundingCube chunk, uint level);
 		OctreeNode * compress(OctreeAllocator &allocator, BoundingCube * cube, BoundingCube chunk);
 };
@@ -134,6 +194,15 @@ struct OctreeNodeLevel
     }
 };
 
+// One point of Octree::locate, node and level as getNodeAt gives them and the field of that
+// node at the point. Points outside of the tree get no node and an infinite sdf.
+struct OctreePointLocation
+{
+    OctreeNode* node;
+    uint level;
+    float sdf;
+};
+
 struct ChildBlock {
 	uint children[8]; 
 
@@ -186,6 +255,8 @@ class OctreeNodeTriangleHandler {
 	long * count;
 	OctreeNodeTriangleHandler(long * count);
 	virtual void handle(Vertex &v0, Vertex &v1, Vertex &v2, bool sign) = 0;
+	// called before the triangles of each cell
+	virtual void beginCell(const BoundingCube &cube) {}
 };
 
 
@@ -194,7 +265,11 @@ class OctreeAllocator {
 	public: 
 	Allocator<OctreeNode> nodeAllocator = Allocator<OctreeNode>(131072);
 	Allocator<ChildBlock> childAllocator = Allocator<ChildBlock>(131072);
+	// parallel to nodeAllocator, never allocated from, indexed like the nodes
+	Allocator<OctreeNodePayload> payloadAllocator = Allocator<OctreeNodePayload>(131072);
 	OctreeNode * allocate();
+	OctreeNodePayload * getPayload(const OctreeNode * node);
+	void reset();
 	OctreeNode * get(uint index);
 	OctreeNode * deallocate(OctreeNode * node);
 
@@ -263,6 +338,45 @@ struct NodeOperationResult {
     };
 };
 
+#define SDF_CACHE_SHARDS 64
+#define SDF_CACHE_BITS 18
+
+enum SdfCacheLookup {
+	SDF_CACHE_HIT,     // value is set
+	SDF_CACHE_CLAIMED, // the caller evaluates it and calls publish()
+	SDF_CACHE_PENDING  // another thread is evaluating it, wait() for it
+};
+
+// Shape distances of one add/del/apply, shared by all the threads of the operation.
+// Corners are keyed by their integer position on a lattice of SDF_CACHE_BITS levels
+// below the tree cube and the index of the operation in the batch, so a corner
+// reached from several nodes or threads is only evaluated once.
+class SdfCache {
+	struct Entry {
+		float value;
+		bool ready;
+	};
+	struct alignas(64) Shard {
+		std::mutex mutex;
+		tsl::robin_map<uint64_t, Entry> entries;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t waits = 0;
+	};
+	glm::vec3 min;
+	float unit;
+	Shard shards[SDF_CACHE_SHARDS];
+	Shard &getShard(uint64_t key);
+
+	public:
+	SdfCache(const BoundingCube &cube);
+	bool getKeys(const BoundingCube &cube, uint index, uint64_t keys[8]) const;
+	SdfCacheLookup claim(uint64_t key, float * value);
+	void publish(uint64_t key, float value);
+	float wait(uint64_t key);
+	std::string getStats();
+};
+
 struct ShapeArgs {
     float (*operation)(float, float);
     WrappedSignedDistanceFunction * function; 
@@ -273,6 +387,8 @@ struct ShapeArgs {
     Simplifier &simplifier; 
     OctreeChangeHandler * changeHandler;
 	float minSize;
+	SdfCache * cache = NULL;
+	uint index = 0; // in the batch
 
     ShapeArgs(
         float (*operation)(float, float),
@@ -303,10 +419,34 @@ struct ShapeArgs {
 };
 
 
+#define SHAPE_BATCH_SIZE 64
+
+// One brush of Octree::apply, the batch is applied in order like that many add/del calls
+struct ShapeOperation {
+	float (*operation)(float, float);
+	WrappedSignedDistanceFunction * function;
+	const TexturePainter * painter;
+	Transformation model;
+	glm::vec4 translate;
+	glm::vec4 scale;
+	float minSize;
+};
+
+struct OctreePathEntry {
+	OctreeNode * node;
+	BoundingCube cube;
+	int child; // taken towards the next entry
+};
+
 class ThreadContext {
 	public:
-	tsl::robin_map<glm::vec3, float> shapeSdfCache;
+	// points without a SdfCache key, from nodes deeper than the lattice or operations without one,
+	// keyed by point and index of the operation in the batch
+	tsl::robin_map<glm::vec4, float> shapeSdfCache;
 	tsl::robin_map<glm::vec4, OctreeNodeLevel> nodeCache;
+	// last descent of getNodeAt, the next lookup starts from the deepest node shared with it
+	std::vector<OctreePathEntry> path;
+	bool pathSimplification;
     std::shared_mutex mutex;
 	BoundingCube cube;
 	
@@ -315,6 +455,8 @@ class ThreadContext {
 		shapeSdfCache.reserve(1024);
 		nodeCache.clear();
 		nodeCache.reserve(1024);
+		path.reserve(32);
+		pathSimplification = false;
 	}
 };
 
@@ -324,25 +466,33 @@ class Octree: public BoundingCube {
 		float chunkSize;
 		OctreeNode * root;
 		OctreeAllocator * allocator;
-		int threadsCreated = 0;
-		std::shared_ptr<std::atomic<int>> shapeCounter = std::make_shared<std::atomic<int>>(0);
 		tsl::robin_map<glm::vec3, ThreadContext> chunks;
-		ThreadPool threadPool = ThreadPool(std::thread::hardware_concurrency());
+		// shared by every tree of the process, a pool or scheduler per tree oversubscribes the cores
+		ThreadPool &threadPool = ThreadPool::shared();
+		TaskScheduler &scheduler = TaskScheduler::shared();
 		std::mutex mutex;
+		OctreePager * pager = NULL;
+		OctreeJournal * journal = NULL;
 		Octree(BoundingCube minCube, float chunkSize);
 		Octree();
 		
 		void expand(const ShapeArgs &args);
 		void add(WrappedSignedDistanceFunction *function, const Transformation model, glm::vec4 translate, glm::vec4 scale, const TexturePainter &painter, float minSize, Simplifier &simplifier, OctreeChangeHandler * changeHandler);
 		void del(WrappedSignedDistanceFunction *function, const Transformation model, glm::vec4 translate, glm::vec4 scale, const TexturePainter &painter, float minSize, Simplifier &simplifier, OctreeChangeHandler * changeHandler);
+		void apply(const std::vector<ShapeOperation> &operations, Simplifier &simplifier, OctreeChangeHandler * changeHandler);
 		void reset();
-		NodeOperationResult shape(OctreeNodeFrame frame, const ShapeArgs &args, ThreadContext * threadContext);
+		size_t compact();
+		NodeOperationResult shape(OctreeNodeFrame frame, const std::vector<ShapeArgs> &args, uint64_t active, ThreadContext * threadContext);
 		void iterate(IteratorHandler &handler);
 		void iterateFlat(IteratorHandler &handler);
 		void iterateParallel(IteratorHandler &handler);
 		OctreeNodeLevel getNodeAt(const glm::vec3 &pos, int level, bool simplification) const;
+		OctreeNodeLevel getNodeAt(const glm::vec3 &pos, int level, bool simplification, ThreadContext * context) const;
 		OctreeNode* getNodeAt(const glm::vec3 &pos, bool simplification) const;
 		float getSdfAt(const glm::vec3 &pos);
+		void locate(const std::vector<glm::vec3> &points, int level, bool simplification, std::vector<OctreePointLocation> &result) const;
+		glm::vec2 getSdfRange(const BoundingCube &cube) const;
+		void updateBounds(OctreeNode * node, bool aboveChunks);
 		void handleQuadNodes(const BoundingCube &cube, uint level, const float sdf[8], std::vector<OctreeNodeTriangleHandler*> * handlers, bool simplification, ThreadContext * context) const;
 		OctreeNodeLevel fetch(glm::vec3 pos, uint level, bool simplification, ThreadContext * context) const;
 		void iterateBorder(
@@ -358,12 +508,20 @@ class Octree: public BoundingCube {
             const IterateBorderHandler &func,
 			ThreadContext * context) const;
 		bool isChunkNode(float length) const;
+		void ensureLoaded(const OctreeNode * node, const BoundingCube &cube) const;
 		bool isThreadNode(float length, float minSize, int threadSize) const;
 		void exportOctreeSerialization(OctreeSerialized * octree);
 		void exportNodesSerialization(std::vector<OctreeNodeCubeSerialized> * nodes);
+		std::string getSchedulerStats(const TaskBatch &batch) const;
 	private:
-		void buildSDF(const ShapeArgs &args, BoundingCube &cube, float shapeSDF[8], float resultSDF[8], float existingResultSDF[8], ThreadContext * threadContext) const;
-		float evaluateSDF(const ShapeArgs &args, tsl::robin_map<glm::vec3, float> * threadContext, glm::vec3 p) const;
+		void shapeBatch(std::vector<ShapeArgs> &args, const std::string &label);
+		void shapeStep(std::vector<ShapeArgs> &args, const std::string &label);
+		void expandFor(const std::vector<ShapeArgs> &args);
+		void record(const OctreeNodeFrame &frame, bool whole, bool skipped);
+		void buildSDF(const std::vector<ShapeArgs> &args, uint64_t active, BoundingCube &cube, float shapeSDF[8], float resultSDF[8], float existingResultSDF[8], int * painter, ThreadContext * threadContext) const;
+		void evaluateSDF(const ShapeArgs &args, ThreadContext * threadContext, const glm::vec3 * points, const uint64_t * keys, float * result, uint count) const;
+		void prefetchSDF(const ShapeArgs &args, const BoundingCube &cube, ThreadContext * threadContext) const;
+		void locate(OctreeNode * node, const BoundingCube &cube, uint depth, int level, bool simplification, const std::vector<glm::vec3> &points, uint * indices, uint * scratch, size_t count, std::vector<OctreePointLocation> &result) const;
 	};
 
 class Simplifier {
@@ -428,6 +586,44 @@ struct DebugInstanceData {
     }
 };
 
+#define CHUNK_MESH_DIVISIONS 4
+#define CHUNK_MESH_BLOCKS (CHUNK_MESH_DIVISIONS*CHUNK_MESH_DIVISIONS*CHUNK_MESH_DIVISIONS)
+#define CHUNK_MESH_ALL (~((uint64_t) 0))
+
+// Triangles and vegetation of a chunk kept per sub-block (4x4x4), so that an edit only
+// re-tesselates the sub-blocks it touched and the rest is spliced back as it was.
+// A cell belongs to the sub-block holding its center.
+class ChunkMesh {
+	BoundingCube cube;
+	float blockLength;
+	Geometry * geometries[CHUNK_MESH_BLOCKS];
+	std::vector<InstanceData> instances[CHUNK_MESH_BLOCKS];
+	std::atomic<uint64_t> dirty;
+	public:
+		ChunkMesh(const BoundingCube &cube);
+		~ChunkMesh();
+		int getBlockIndex(const glm::vec3 &point) const;
+		uint64_t getBlocks(const BoundingCube &region) const;
+		void markDirty(const BoundingCube &region);
+		uint64_t takeDirty();
+		void clear(uint64_t blocks);
+		Geometry * getGeometry(int block);
+		std::vector<InstanceData> * getInstances(int block);
+		Geometry * buildGeometry() const;
+		std::vector<InstanceData> buildInstances() const;
+};
+
+class ChunkMeshLayer {
+	tsl::robin_map<glm::vec3, ChunkMesh*> meshes;
+	std::mutex mutex;
+	public:
+		~ChunkMeshLayer();
+		ChunkMesh * get(const BoundingCube &chunk);
+		void markDirty(const BoundingCube &chunk, const BoundingCube &region);
+		void erase(const BoundingCube &chunk);
+		void clear();
+};
+
 template <typename T> class GeometryBuilder {
     public:
     virtual InstanceGeometry<T> * build(Octree * tree, OctreeNodeData &params, ThreadContext * context) = 0;
@@ -492,11 +688,13 @@ template <typename T> class InstanceBuilder : public IteratorHandler{
 
 class Tesselator : public OctreeNodeTriangleHandler{
 	ThreadContext * context;
+	ChunkMesh * mesh;
 
 	public:
-		Geometry * geometry;
-		Tesselator(long * count, ThreadContext * context);
+		Geometry * geometry; // with a ChunkMesh, the geometry of the current cell's sub-block
+		Tesselator(long * count, ThreadContext * context, ChunkMesh * mesh = NULL);
 		void handle(Vertex &v0, Vertex &v1, Vertex &v2, bool sign) override;
+		void beginCell(const BoundingCube &cube) override;
 
 };
 
@@ -505,9 +703,11 @@ class Processor : public IteratorHandler {
 	ThreadContext * context;
 	std::vector<OctreeNodeTriangleHandler*> * handlers;
     std::unordered_set<BoundingCube,BoundingCubeHasher> iteratedCubes;
+	const ChunkMesh * mesh;
+	uint64_t blocks; // sub-blocks of mesh to tesselate
 
 	public:
-		Processor(long * count, ThreadPool &threadPool, ThreadContext * context, std::vector<OctreeNodeTriangleHandler*> * handlers);
+		Processor(long * count, ThreadPool &threadPool, ThreadContext * context, std::vector<OctreeNodeTriangleHandler*> * handlers, const ChunkMesh * mesh = NULL, uint64_t blocks = CHUNK_MESH_ALL);
 		void iterate(const Octree &tree, OctreeNodeData &params);
 		void before(const Octree &tree, OctreeNodeData &params) override;
 		void after(const Octree &tree, OctreeNodeData &params) override;
@@ -519,6 +719,15 @@ class Processor : public IteratorHandler {
 
 
 
+// max chunk buffers being encoded/decoded at the same time
+#define OCTREE_FILE_IN_FLIGHT 16
+
+struct OctreeFileChunk {
+	OctreeNode * node;
+	BoundingCube cube;
+	std::string path;
+};
+
 class OctreeFile {
 	Octree * tree;
     std::string filename;
@@ -527,23 +736,312 @@ class OctreeFile {
         void save(std::string baseFolder, float chunkSize);
         void load(std::string baseFolder, float chunkSize);
 		AbstractBoundingBox& getBox();
-		OctreeNode * loadRecursive(int i, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder);
-		uint saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder);
+		OctreeNode * loadRecursive(int i, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder, std::vector<OctreeFileChunk> * chunks);
+		uint saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes, float chunkSize, std::string filename, BoundingCube cube, std::string baseFolder, std::vector<OctreeFileChunk> * chunks);
+
+};
+
+#define OCTREE_IMAGE_MAGIC "LITHOIMG"
+#define OCTREE_IMAGE_VERSION 2
+#define OCTREE_IMAGE_COMPRESSED 0x1
+#define OCTREE_IMAGE_ALIGNMENT 4096
+
+// One allocator inside an image: a table of blocks plus a bitmap of the slots in use
+struct OctreeImageSection {
+	uint recordSize;     // sizeof(T), images from another build are refused
+	uint blockSize;      // records per block
+	uint64_t blockCount;
+	uint64_t tableOffset; // blockCount OctreeImageBlock
+	uint64_t usedOffset;  // (blockCount*blockSize+63)/64 words
+};
 
+struct OctreeImageBlock {
+	uint64_t offset;     // aligned to OCTREE_IMAGE_ALIGNMENT
+	uint64_t storedSize; // == blockSize*recordSize when not compressed
+};
+
+struct OctreeImageHeader {
+	char magic[8];
+	uint version;
+	uint flags;
+	OctreeSerialized tree;
+	uint root;
+	OctreeImageSection nodes;
+	OctreeImageSection children;
+	OctreeImageSection payloads; // same indices and used bitmap as nodes
+};
+
+// Versioned image of the allocator blocks, node and child block records are stored as they are in memory.
+// Uncompressed images are mmap'd straight into the allocators (copy on write) so loading only touches
+// the pages that are actually used. Compressed images trade that for size, blocks are inflated on load.
+class OctreeImage {
+	Octree * tree;
+	std::string filename;
+	public:
+		OctreeImage(Octree * tree, std::string filename);
+		std::string getPath(std::string baseFolder) const;
+		bool exists(std::string baseFolder) const;
+		bool save(std::string baseFolder, bool compress);
+		bool load(std::string baseFolder);
+};
+
+#define OCTREE_LATTICE_MAGIC 0x54414c4f4854494cull // "LITHOLAT", older chunk files start with the node count
+#define OCTREE_LATTICE_VERSION 2 // 1 had the overrides on the lattice step
+#define OCTREE_LATTICE_DEPTH 20 // levels below the chunk that fit in a corner key, 21 bits per axis
+
+// Chunk file node, its corners are looked up in the lattice by position
+struct OctreeLatticeNode {
+	uint children[8];
+	int brushIndex;
+	uint8_t bits;
+	uint8_t shared; // 0 when the corners are in the overrides
+};
+
+// Corners of a node that disagree with the lattice, are too deep for it or lose precision on its step.
+// Quantized with the step of the node itself
+struct OctreeLatticeOverride {
+	uint node;
+	int16_t sdf[8];
+};
+
+struct OctreeLatticeHeader {
+	uint64_t magic;
+	uint version;
+	float scale; // distance of one lattice step, the one of the deepest node
+	uint64_t nodes;
+	uint64_t corners; // sorted uint64 keys followed by their int16 values
+	uint64_t overrides;
+};
+
+// Corner distances shared between the nodes of a chunk, keyed by lattice position
+struct OctreeCornerLattice {
+	uint version;
+	float scale;
+	tsl::robin_map<uint64_t, int16_t> corners;
+	std::vector<OctreeLatticeNode> nodes;
+	std::vector<OctreeLatticeOverride> overrides;
+
+	static uint64_t getKey(const glm::uvec3 &corner);
+	static glm::uvec3 getCorner(const glm::uvec3 &min, uint size, int i);
 };
 
 class OctreeNodeFile {
 	OctreeNode * node;
     std::string filename;
 	Octree * tree;
+		OctreeNode * loadLegacy(OctreeNode * node, int i, BoundingCube &cube, std::vector<OctreeNodeSerialized> * nodes);
+		OctreeNode * loadRecursive(OctreeNode * node, uint i, BoundingCube &cube, glm::uvec3 min, uint depth, OctreeCornerLattice &lattice, tsl::robin_map<uint, uint> &overrides);
+		uint saveRecursive(OctreeNode * node, const BoundingCube &cube, glm::uvec3 min, uint depth, OctreeCornerLattice &lattice);
     public: 
 		OctreeNodeFile(Octree * tree, OctreeNode * node, std::string filename);
-        void save(std::string baseFolder);
-        void load(std::string baseFolder, BoundingCube &cube);
-		OctreeNode * loadRecursive(OctreeNode * node, int i, BoundingCube &cube, std::vector<OctreeNodeSerialized> * nodes);
-		uint saveRecursive(OctreeNode * node, std::vector<OctreeNodeSerialized> * nodes);
+        bool save(std::string baseFolder, const BoundingCube &cube);
+        bool load(std::string baseFolder, BoundingCube &cube);
+};
+
+
+std::string getChunkName(BoundingCube cube);
+
+// Keeps chunk subtrees out of memory, backed by their OctreeNodeFile.
+// Unloaded chunk nodes keep their own sdf/type/bits, only the subtree is missing, traversals
+// fault it in through Octree::ensureLoaded. Evicted chunks that were modified are written to a
+// swap folder first, the save folder only changes on OctreeFile::save.
+// trim() frees memory and must be called when nothing is traversing the tree. The LRU is only
+// reordered there, visits just mark the chunk (OctreeNode::paging) and marked chunks get a second chance.
+class OctreePager {
+	struct Entry {
+		size_t bytes;
+		bool modified;
+		BoundingCube cube;
+		std::list<OctreeNode*>::iterator lru;
+	};
+	Octree * tree;
+	std::string baseFolder;
+	std::string swapFolder;
+	std::string filename;
+	size_t budget;
+	size_t residentBytes;
+	tsl::robin_map<OctreeNode*, Entry> resident;
+	std::unordered_set<OctreeNode*> swapped;
+	std::list<OctreeNode*> lru; // most recent first
+	std::mutex mutex;
+	long faults;
+	long evictions;
+	long writes;
+
+	size_t measure(OctreeNode * node);
+	bool writeBack(OctreeNode * node, Entry &entry);
+	public:
+		OctreePager(Octree * tree, std::string baseFolder, std::string filename, size_t budget);
+		~OctreePager();
+		std::string getPath(const OctreeNode * node, const BoundingCube &cube);
+		void setBudget(size_t budget);
+		void fault(OctreeNode * node, const BoundingCube &cube);
+		void touch(OctreeNode * node);
+		void markModified(OctreeNode * node, const BoundingCube &cube);
+		void forget(OctreeNode * node);
+		void trim();
+		void clear();
+		size_t getResidentBytes();
+		std::string getStats();
+};
+
+// A slot of the tree, keyed by its cube, as it was before a journal step.
+// Deep entries own a detached copy of the whole subtree (UINT_MAX for an empty slot), the
+// undo swaps it with the index in the parent block and keeps what was there for the redo.
+// Shallow entries are nodes that the shape went through, chunks and below included, only
+// their own record is swapped, the children come back through their own entries.
+struct OctreeJournalEntry {
+	BoundingCube cube;
+	bool deep;
+	uint node;
+	bool exists;
+	bool hasBlock;
+	uint8_t bits;
+	OctreeNodePayload payload;
+};
+
+struct OctreeJournalStep {
+	std::vector<OctreeJournalEntry> entries;
+	size_t bytes = 0;
+};
+
+// Undo/redo of the edits of a tree, one step per Octree::add, del or apply.
+// Edits record into it from any thread between begin() and end(),
+// undo() and redo() only run when nothing else uses the tree.
+class OctreeJournal {
+	Octree * tree;
+	size_t budget;
+	std::deque<OctreeJournalStep> steps;
+	size_t current; // steps before it can be undone, the ones after redone
+	OctreeJournalStep recording;
+	bool open;
+	std::mutex mutex;
+
+	uint copy(OctreeNode * node, const BoundingCube &cube, size_t * bytes);
+	void release(uint node);
+	void release(OctreeJournalStep &step);
+	void notify(OctreeNode * node, const BoundingCube &cube, OctreeChangeHandler * handler, bool incoming);
+	void swap(uint &slot, const BoundingCube &cube, tsl::robin_map<glm::vec4, uint> &entries, OctreeJournalStep &step, OctreeChangeHandler * handler);
+	void swap(OctreeJournalStep &step, OctreeChangeHandler * handler);
+	void enforceBudget();
+
+	public:
+	OctreeJournal(Octree * tree, size_t budget);
+	~OctreeJournal();
+	void setBudget(size_t budget);
+	void begin();
+	void end();
+	bool isOpen() const;
+	void recordNode(OctreeNode * node, const BoundingCube &cube);
+	void recordSubtree(OctreeNode * node, const BoundingCube &cube);
+	bool undo(OctreeChangeHandler * handler);
+	bool redo(OctreeChangeHandler * handler);
+	bool canUndo();
+	bool canRedo();
+	void clear(bool release);
+	std::string getStats();
+};
+
+struct OctreeRay {
+	glm::vec3 origin;
+	glm::vec3 direction; // unit length
+	float length;
 };
 
+// a sphere when a == b
+struct OctreeCapsule {
+	glm::vec3 a;
+	glm::vec3 b;
+	float radius;
+};
+
+struct OctreeSweep {
+	OctreeCapsule capsule;
+	glm::vec3 direction; // unit length
+	float length;
+};
+
+struct OctreeHit {
+	bool hit;
+	float distance; // travelled along the ray or sweep, to the surface for closest points
+	glm::vec3 position;
+	glm::vec3 normal;
+	OctreeNode * node;
+};
+
+// Deepest node over a point, a missing child is a cube without surface that takes the
+// corners of its parent
+struct OctreeQueryCell {
+	OctreeNode * node;
+	BoundingCube cube;
+	float sdf[8];
+	SpaceType type;
+};
+
+// Gameplay queries against the stored SDF. Consecutive queries of a ThreadContext resume the
+// descent of the previous one, so coherent queries (the steps of a ray, rays of a packet) only
+// walk the last levels. Packets are split across the thread pool of the tree.
+// It only reads the tree, nothing may edit it while a query runs. A ThreadContext passed in
+// keeps pointers to nodes, it can't be reused after an edit.
+class OctreeQuery {
+	Octree * tree;
+	ThreadContext context; // single queries, main thread
+
+	void locate(const glm::vec3 &pos, ThreadContext * context, OctreeQueryCell * cell) const;
+	float distance(const glm::vec3 &pos, ThreadContext * context, OctreeQueryCell * cell, glm::vec3 * gradient) const;
+	float clearance(const OctreeCapsule &capsule, const glm::vec3 &offset, ThreadContext * context, float * reach, OctreeHit * contact) const;
+	float refine(const OctreeRay &ray, float inside, float outside, ThreadContext * context) const;
+	template <typename Q, typename R, typename F> void run(const std::vector<Q> &queries, std::vector<R> &results, F query);
+
+	public:
+	float epsilon;
+	uint maxSteps;
+
+	OctreeQuery(Octree * tree, float epsilon = 0.01f, uint maxSteps = 256);
+
+	OctreeHit raycast(const OctreeRay &ray, ThreadContext * context) const;
+	OctreeHit sweep(const OctreeSweep &sweep, ThreadContext * context) const;
+	OctreeHit closestPoint(const glm::vec3 &pos, float maxDistance, ThreadContext * context) const;
+	bool overlaps(const OctreeCapsule &capsule, ThreadContext * context) const;
+
+	OctreeHit raycast(const OctreeRay &ray);
+	OctreeHit sweep(const OctreeSweep &sweep);
+	OctreeHit closestPoint(const glm::vec3 &pos, float maxDistance);
+	bool overlaps(const OctreeCapsule &capsule);
+
+	void raycast(const std::vector<OctreeRay> &rays, std::vector<OctreeHit> &hits);
+	void sweep(const std::vector<OctreeSweep> &sweeps, std::vector<OctreeHit> &hits);
+	void closestPoint(const std::vector<glm::vec3> &points, float maxDistance, std::vector<OctreeHit> &hits);
+	void overlaps(const std::vector<OctreeCapsule> &capsules, std::vector<uint8_t> &results);
+};
+
+// cells per side of a brick of OctreeSdfGrid, a brick keeps (SDF_GRID_BRICK+1)^3 samples
+#define SDF_GRID_BRICK 8
+
+// Snapshot of the stored field of a tree over a box, sampled on a lattice of the given step
+// aligned to the world so the corners of nodes of that size fall on samples. Bricks further
+// than margin from the surface (by the node bounds) keep a single value, the bound closest to
+// zero, the others all of their samples. Points outside of the box go to the tree.
+// It doesn't follow edits of the tree made after it was built.
+class OctreeSdfGrid {
+	Octree * tree;
+	glm::vec3 min;
+	float step;
+	glm::ivec3 cells;
+	glm::ivec3 bricks;
+	std::vector<uint> slots; // start of each brick in samples, UINT_MAX keeps its constant
+	std::vector<float> constants;
+	std::vector<float> samples;
+
+	bool getSamples(const BoundingCube &cube, const glm::ivec3 &origin, glm::ivec3 &from, glm::ivec3 &to) const;
+	void fill(OctreeNode * node, const BoundingCube &cube, const glm::ivec3 &origin, float * values) const;
+	void write(const BoundingCube &cube, const BoundingCube &sdfCube, const float sdf[8], const glm::ivec3 &origin, float * values) const;
+
+	public:
+	OctreeSdfGrid(Octree * tree, const BoundingBox &box, float step, float margin);
+	float distance(const glm::vec3 &pos) const;
+	std::string getStats() const;
+};
 
 class OctreeVisibilityChecker : public IteratorHandler{
 	Frustum frustum;
@@ -29,20 +29,26 @@ BrushContext::BrushContext(Settings * settings, Camera * camera) : settings(sett
 
 }
 
-void BrushContext::apply(Octree &space, OctreeChangeHandler * handler, bool preview) {
-    if(currentEffect) {
+BrushStroke BrushContext::getStroke() {
+    // only set when it changes, a stroke running in the worker may read the effect
+    if(currentEffect && currentEffect->getFunction() != currentFunction) {
         currentEffect->setFunction(currentFunction);
     }
+    float safeDetail = glm::ceil(currentFunction->getLength(this->model, detail) * settings->safetyDetailRatio);
+    if(detail < safeDetail) {
+        detail = safeDetail;
+        std::cout << "BrushContext::getStroke: detail increased to " << std::to_string(detail) << std::endl;
+    }
+    return { currentEffect ? currentEffect : currentFunction, this->model, translate, scale, detail, brushIndex, mode };
+}
+
+void BrushContext::apply(Octree &space, OctreeChangeHandler * handler, bool preview) {
     if(currentFunction) {
-        float safeDetail = glm::ceil(currentFunction->getLength(this->model, detail) * settings->safetyDetailRatio);
-        if(detail < safeDetail) {
-            detail = safeDetail;
-            std::cout << "BrushContext::apply: detail increased to " << std::to_string(detail) << std::endl;
-        }
-        if(preview  || mode == BrushMode::ADD) {
-            space.add(currentEffect ? currentEffect : currentFunction, this->model, translate, scale, SimpleBrush(brushIndex), detail, *simplifier, handler);
+        BrushStroke stroke = getStroke();
+        if(preview  || stroke.mode == BrushMode::ADD) {
+            space.add(stroke.function, stroke.model, stroke.translate, stroke.scale, SimpleBrush(stroke.brushIndex), stroke.detail, *simplifier, handler);
         } else {
-            space.del(currentEffect ? currentEffect : currentFunction, this->model, translate, scale, SimpleBrush(brushIndex), detail, *simplifier, handler);
+            space.del(stroke.function, stroke.model, stroke.translate, stroke.scale, SimpleBrush(stroke.brushIndex), stroke.detail, *simplifier, handler);
         }
     }
 }
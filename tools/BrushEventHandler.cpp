@@ -63,6 +63,10 @@ template<typename T> void BrushEventHandler<T>::handle(T * event) {
     case PAGE_SDF0:
         if(context.currentFunction == context.functions[2]) {
             CapsuleDistanceFunction * function = (CapsuleDistanceFunction*) context.currentFunction;
+            // queued strokes share the function, they go in with the shape they were painted with
+            if(event->getType() == EVENT_VECTOR_3D_0 || event->getType() == EVENT_VECTOR_3D_2 || event->getType() == EVENT_FLOAT_1_X) {
+                scene.flushBrushStrokes();
+            }
             if(event->getType() == EVENT_VECTOR_3D_0) {
                 Axis3dEvent * e = (Axis3dEvent*) event;
                 TranslateHandler(context.camera, &(function->a)).handle(e);
@@ -85,7 +89,10 @@ template<typename T> void BrushEventHandler<T>::handle(T * event) {
     
     if(event->getType() == EVENT_PAINT_BRUSH) {
         std::cout << "EVENT_PAINT_BRUSH" << std::endl;
-        context.apply(scene.solidSpace, scene.solidSpaceChangeHandler, false);
+        // applied in the background, the scene shows it once the whole stroke is in
+        if(context.currentFunction) {
+            scene.brushWorker.push(context.getStroke());
+        }
     }
 
     if(event->getType() == EVENT_NEXT_TAB) {
@@ -103,8 +110,9 @@ template<typename T> void BrushEventHandler<T>::handle(T * event) {
 
     if(changed) {
         Octree * space = &scene.brushSpace;
+        scene.remesher.wait();
         space->root->clear(*space->allocator, scene.brushSpaceChangeHandler, NULL);
-        space->root->init(space->root->vertex);
+        space->root->init(*space->allocator, space->root->getVertex(*space->allocator));
         //space->reset();
         //scene.brushInfo.info.clear();
         context.apply(*space, scene.brushSpaceChangeHandler, true);
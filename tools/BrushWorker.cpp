@@ -0,0 +1,111 @@
+#include "tools.hpp"
+
+bool BrushStroke::operator==(const BrushStroke &other) const {
+	return function == other.function && model.scale == other.model.scale && model.translate == other.model.translate &&
+		model.quaternion == other.model.quaternion && translate == other.translate && scale == other.scale &&
+		detail == other.detail && brushIndex == other.brushIndex && mode == other.mode;
+}
+
+BrushWorker::BrushWorker(Octree * tree, Simplifier * simplifier) {
+	this->tree = tree;
+	this->simplifier = simplifier;
+	this->running = false;
+	this->finished = false;
+	this->stop = false;
+	this->thread = std::thread(&BrushWorker::run, this);
+}
+
+BrushWorker::~BrushWorker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+void BrushWorker::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while(true) {
+		wake.wait(lock, [this]{ return stop || !job.empty(); });
+		if(stop) {
+			return;
+		}
+		std::vector<BrushStroke> strokes;
+		strokes.swap(job);
+		lock.unlock();
+		apply(strokes);
+		lock.lock();
+		running = false;
+		finished = true;
+		done.notify_all();
+	}
+}
+
+// Everything queued since the last job goes in one batch, a single walk of the tree
+void BrushWorker::apply(const std::vector<BrushStroke> &strokes) {
+	std::vector<SimpleBrush> painters;
+	painters.reserve(strokes.size());
+	std::vector<ShapeOperation> operations;
+	operations.reserve(strokes.size());
+	for(const BrushStroke &stroke : strokes) {
+		painters.emplace_back(stroke.brushIndex);
+		float (*operation)(float, float) = stroke.mode == BrushMode::ADD ? SDF::opUnion : SDF::opSubtraction;
+		operations.push_back({operation, stroke.function, &painters.back(), stroke.model, stroke.translate, stroke.scale, stroke.detail});
+	}
+	std::cout << "BrushWorker::apply(" << std::to_string(strokes.size()) << ")" << std::endl;
+	tree->apply(operations, *simplifier, &changes);
+}
+
+// Repeating the last stroke at the same place changes nothing, rapid clicks are dropped
+void BrushWorker::push(const BrushStroke &stroke) {
+	if(!pending.empty() && pending.back() == stroke) {
+		return;
+	}
+	pending.push_back(stroke);
+}
+
+bool BrushWorker::hasPending() {
+	return !pending.empty();
+}
+
+// Main thread, only while nothing else reads the tree
+bool BrushWorker::start() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(pending.empty() || running || finished) {
+		return false;
+	}
+	job.swap(pending);
+	running = true;
+	wake.notify_one();
+	return true;
+}
+
+// Main thread, the changes of the finished job reach the layers all at once
+bool BrushWorker::publish(OctreeChangeHandler * handler) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(!finished) {
+			return false;
+		}
+		finished = false;
+	}
+	size_t count = changes.replay(handler);
+	std::cout << "BrushWorker::publish " << std::to_string(count) << " changes" << std::endl;
+	return true;
+}
+
+// The tree is being changed or holds changes the renderer wasn't told about yet
+bool BrushWorker::isEditing() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return running || finished;
+}
+
+bool BrushWorker::isBusy() {
+	return hasPending() || isEditing();
+}
+
+void BrushWorker::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this]{ return !running; });
+}
@@ -0,0 +1,45 @@
+#include "tools.hpp"
+
+#define DEFERRED_CREATE 0
+#define DEFERRED_UPDATE 1
+#define DEFERRED_ERASE 2
+#define DEFERRED_DIRTY 3
+
+void DeferredChangeHandler::create(OctreeNode* node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.push_back({DEFERRED_CREATE, node, BoundingCube(), BoundingCube()});
+};
+
+void DeferredChangeHandler::update(OctreeNode* node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.push_back({DEFERRED_UPDATE, node, BoundingCube(), BoundingCube()});
+};
+
+void DeferredChangeHandler::erase(OctreeNode* node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.push_back({DEFERRED_ERASE, node, BoundingCube(), BoundingCube()});
+};
+
+void DeferredChangeHandler::dirty(const BoundingCube &chunk, const BoundingCube &region) {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.push_back({DEFERRED_DIRTY, NULL, chunk, region});
+};
+
+// Erased nodes may already be reused by the time this runs, the order keeps
+// an erase of the old node before the create of the new one
+size_t DeferredChangeHandler::replay(OctreeChangeHandler * handler) {
+    std::vector<Change> list;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        list.swap(changes);
+    }
+    for(Change &change : list) {
+        switch(change.type) {
+            case DEFERRED_CREATE: handler->create(change.node); break;
+            case DEFERRED_UPDATE: handler->update(change.node); break;
+            case DEFERRED_ERASE: handler->erase(change.node); break;
+            default: handler->dirty(change.chunk, change.region); break;
+        }
+    }
+    return list.size();
+}
@@ -1,6 +1,13 @@
 #include "tools.hpp"
 
-OctreeDifferenceFunction::OctreeDifferenceFunction(Octree * tree, BoundingBox box, float bias):tree(tree), box(box), bias(bias) {
+static BoundingBox getGridBox(const BoundingBox &box, float bias, float step) {
+    return BoundingBox(box.getMin() - glm::vec3(bias + step), box.getMax() + glm::vec3(bias + step));
+}
+
+// The tree is sampled once on a grid of the given step, the corners the liquid pass evaluates
+// read it instead of going down the tree. Only the band around the water line is kept dense.
+OctreeDifferenceFunction::OctreeDifferenceFunction(Octree * tree, BoundingBox box, float bias, float step):tree(tree), box(box), bias(bias),
+    grid(tree, getGridBox(box, bias, step), step, bias + step * SDF_GRID_BRICK) {
 
 }
 
@@ -9,7 +16,21 @@ float OctreeDifferenceFunction::distance(const glm::vec3 &p, const Transformatio
     glm::vec3 pos = p - box.getCenter()+model.translate;
     return SDF::opSubtraction(
         SDF::box(pos, len),
-        tree->getSdfAt(p)+bias
+        grid.distance(p)+bias
+    );
+}
+
+// the box bounds one side, the stored bounds of the tree the other, cubes under
+// the ground are skipped and cubes in open air filled without going down
+glm::vec2 OctreeDifferenceFunction::getDistanceRange(const BoundingCube &cube, const Transformation &model) {
+    glm::vec3 len = box.getLength()*0.5f;
+    glm::vec3 pos = cube.getCenter() - box.getCenter()+model.translate;
+    float radius = glm::length(cube.getLength()) * 0.5f;
+    float boxDistance = SDF::box(pos, len);
+    glm::vec2 range = tree->getSdfRange(cube);
+    return glm::vec2(
+        glm::max(boxDistance - radius, -(range.y + bias)),
+        glm::max(boxDistance + radius, -(range.x + bias))
     );
 }
 
@@ -0,0 +1,87 @@
+#include "tools.hpp"
+#include <chrono>
+
+RemeshScheduler::RemeshScheduler() {
+	this->inFlight = 0;
+	for(int i = 0; i < REMESH_LAYERS; ++i) {
+		// first guess until some jobs finish
+		averageMillis[i] = 4.0f;
+	}
+}
+
+void RemeshScheduler::offer(const OctreeNodeData &data, int layer, const glm::vec3 &camera) {
+	if(queued[layer].find(data.node) != queued[layer].end()) {
+		return;
+	}
+	// projected size, length over distance
+	float distance = glm::max(glm::distance(camera, data.cube.getCenter()), 1.0f);
+	candidates.push_back({data, layer, data.cube.getLengthX() / distance});
+}
+
+int RemeshScheduler::drain() {
+	std::vector<RemeshResult> results;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		results.swap(completed);
+	}
+	int loadCount = 0;
+	for(RemeshResult &result : results) {
+		queued[result.layer].erase(result.node);
+		averageMillis[result.layer] = averageMillis[result.layer] * 0.9f + result.millis * 0.1f;
+		if(result.loaded) {
+			++loadCount;
+		}
+	}
+	return loadCount;
+}
+
+void RemeshScheduler::submit(ThreadPool &threadPool, float budgetMillis, uint maxInFlight, std::function<bool(OctreeNodeData&, int)> process) {
+	std::sort(candidates.begin(), candidates.end(), [](const RemeshJob &a, const RemeshJob &b) {
+		return a.priority > b.priority;
+	});
+	if(maxInFlight == 0) {
+		maxInFlight = threadPool.threadCount() * 2;
+	}
+
+	// the budget is per pool thread, estimated from what the last jobs took
+	float budget = budgetMillis * threadPool.threadCount();
+	float spent = 0.0f;
+	for(RemeshJob &job : candidates) {
+		if(spent >= budget) {
+			break;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(inFlight >= maxInFlight) {
+				break;
+			}
+			++inFlight;
+		}
+		queued[job.layer].insert(job.data.node);
+		spent += averageMillis[job.layer];
+
+		threadPool.enqueue([this, job, process]() mutable {
+			auto start = std::chrono::steady_clock::now();
+			bool loaded = process(job.data, job.layer);
+			float millis = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			completed.push_back({job.data.node, job.layer, loaded, millis});
+			if(--inFlight == 0) {
+				idle.notify_all();
+			}
+		});
+	}
+	candidates.clear();
+}
+
+// Blocks until every submitted job is done, edits can't run under a job
+void RemeshScheduler::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]{ return inFlight == 0; });
+}
+
+uint RemeshScheduler::getInFlight() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return inFlight;
+}
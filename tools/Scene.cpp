@@ -11,6 +11,7 @@ Scene::Scene(Settings * settings, BrushContext * brushContext):
 	brushSpace(BoundingCube(glm::vec3(0,0,0), 30.0), glm::pow(2, 9)),
   	brushTrianglesCount(0),
 	trianglesCount(0),
+	brushWorker(&solidSpace, brushContext->simplifier),
 	brushContext(brushContext)
  {
 	this->settings = settings;
@@ -31,7 +32,8 @@ Scene::Scene(Settings * settings, BrushContext * brushContext):
 	}
 
 	liquidSpaceChangeHandler = new LiquidSpaceChangeHandler(&liquidInfo);
-	solidSpaceChangeHandler = new SolidSpaceChangeHandler(&vegetationInfo, &octreeWireframeInfo);
+	solidSpaceChangeHandler = new SolidSpaceChangeHandler(&vegetationInfo, &octreeWireframeInfo, &solidMeshes);
+	solidSpace.journal = new OctreeJournal(&solidSpace, ((size_t) settings->journalBudget) << 20);
 	brushSpaceChangeHandler = new BrushSpaceChangeHandler(&brushInfo);
 	vegetationGeometry = new Vegetation3d(1.0);
 }
@@ -99,21 +101,36 @@ bool Scene::processSolid(OctreeNodeData &data, Octree * tree) {
 
 	bool result = false;
 	ThreadContext context = ThreadContext(data.cube);
-	Tesselator tesselator(&trianglesCount, &context);
-	std::vector<InstanceData> vegetationInstances; 
+
+	// only the sub-blocks touched since the last time are tesselated again
+	ChunkMesh * mesh = solidMeshes.get(data.cube);
+	uint64_t blocks = mesh->takeDirty();
+	if(blocks == 0) {
+		// dirty without an edit (loaded, generated...)
+		blocks = CHUNK_MESH_ALL;
+	}
+	mesh->clear(blocks);
+
+	Tesselator tesselator(&trianglesCount, &context, mesh);
 	long count = 0;
-	VegetationInstanceBuilder vegetationBuilder(tree, &count, &vegetationInstances, 0.01, 4);
+	VegetationInstanceBuilder vegetationBuilder(tree, &count, NULL, 0.01, 4, mesh);
 
 	std::vector<OctreeNodeTriangleHandler*> triangleHandlers;
 	triangleHandlers.emplace_back(&tesselator);
 	triangleHandlers.emplace_back(&vegetationBuilder);
 	//std::cout << "\tprocessor" << std::endl;
-	Processor triangleProcessor(&trianglesCount, threadPool, &context, &triangleHandlers);
+	Processor triangleProcessor(&trianglesCount, threadPool, &context, &triangleHandlers, mesh, blocks);
 	//std::cout << "\tprocessor.iterateFlatIn" << std::endl;
 	triangleProcessor.iterateFlatIn(*tree, data);
 
- 	if(tesselator.geometry->indices.size() > 0) {
-        InstanceGeometry<InstanceData> * pre = new InstanceGeometry<InstanceData>(tesselator.geometry);
+	Geometry * geometry = mesh->buildGeometry();
+	std::vector<InstanceData> vegetationInstances = mesh->buildInstances();
+	if(geometry->indices.size() == 0 && vegetationInstances.size() == 0) {
+		solidMeshes.erase(data.cube);
+	}
+
+ 	if(geometry->indices.size() > 0) {
+        InstanceGeometry<InstanceData> * pre = new InstanceGeometry<InstanceData>(geometry);
         pre->instances.emplace_back(InstanceData(0, glm::mat4(1.0), 0.0f));
 		//std::cout << "\tloadSpace(solidInfo) " << tesselator.geometry->indices.size() <<  std::endl;
 
@@ -122,6 +139,7 @@ bool Scene::processSolid(OctreeNodeData &data, Octree * tree) {
 		}
 
 	} else {
+		delete geometry;
 		if(data.node != NULL && loadSpace(tree, data, &solidInfo, (InstanceGeometry<InstanceData>*) NULL)) {
 			result = true;
 		}
@@ -203,14 +221,16 @@ bool Scene::processSpace() {
 	std::unordered_set<uint> visibleNodeIds;
 	std::vector<OctreeNodeData*> allVisibleNodes;
 
+	// the solid lists are left from before the edit, the nodes they point to may be gone
+	bool editing = brushWorker.isEditing();
 	for(OctreeNodeData &data : solidRenderer->visibleNodes) {
-		if(data.node && data.node->id != UINT_MAX && visibleNodeIds.find(data.node->id) == visibleNodeIds.end()) {
+		if(!editing && data.node && data.node->id != UINT_MAX && visibleNodeIds.find(data.node->id) == visibleNodeIds.end()) {
 			allVisibleNodes.emplace_back(&data);
 			visibleNodeIds.insert(data.node->id);
 		}
 	}
 
-	for(uint i =0 ; i < SHADOW_MATRIX_COUNT ; ++i) {
+	for(uint i =0 ; !editing && i < SHADOW_MATRIX_COUNT ; ++i) {
 		std::vector<OctreeNodeData> &vec = shadowRenderer[i]->visibleNodes;
 		for(OctreeNodeData &data : vec) {
 			if(data.node && data.node->id != UINT_MAX && visibleNodeIds.find(data.node->id) == visibleNodeIds.end()) {
@@ -220,55 +240,111 @@ bool Scene::processSpace() {
 		}
 	}
 
-	int loadCount = 0;
-	//std::cout << "process " << std::to_string((long)allVisibleNodes.size()) <<  std::endl;
-
-    std::vector<std::future<bool>> futures;
-	futures.reserve(36);
+	// collect what the jobs finished since the last frame, never blocks
+	int loadCount = remesher.drain();
 
-	// Thread pool zone
-	int workCount = 12;	
+	glm::vec3 camera = solidRenderer->sortPosition;
 	for (OctreeNodeData* data : allVisibleNodes) {
-		if (data->node && data->node->isDirty() && --workCount>=0) {
-			futures.emplace_back(threadPool.enqueue([this, data]() {
-				return processSolid(*data, &solidSpace);
-			}));
+		if (data->node && data->node->isDirty()) {
+			remesher.offer(*data, REMESH_SOLID, camera);
 		}
 	}
-	workCount = 12;
 	for (OctreeNodeData& brush : brushRenderer->visibleNodes) {
-		if (brush.node && brush.node->isDirty() && --workCount>=0) {
-			futures.emplace_back(threadPool.enqueue([this, &brush]() {
-				return processBrush(brush, &brushSpace);
-			}));
+		if (brush.node && brush.node->isDirty()) {
+			remesher.offer(brush, REMESH_BRUSH, camera);
 		}
 	}
-	workCount = 12;
 	for (OctreeNodeData& liquid : liquidRenderer->visibleNodes) {
-		if (liquid.node && liquid.node->isDirty() && --workCount>=0) {
-			futures.emplace_back(threadPool.enqueue([this, &liquid]() {
-				return processLiquid(liquid, &liquidSpace);
-			}));
+		if (liquid.node && liquid.node->isDirty()) {
+			remesher.offer(liquid, REMESH_LIQUID, camera);
 		}
 	}
-	for(auto &t : futures) {
-		bool ret = t.get();
-		if(ret) {
-			++loadCount;
+
+	// the pager can only evict while no job is traversing the trees, so
+	// stop feeding the pool until it drains once a tree is over budget
+	size_t pagingBudget = ((size_t) settings->pagingBudget) << 20;
+	Octree * pagedSpaces[2] = { &solidSpace, &liquidSpace };
+	bool evict = false;
+	for(Octree * tree : pagedSpaces) {
+		if(tree->pager != NULL) {
+			tree->pager->setBudget(pagingBudget);
+			evict |= pagingBudget > 0 && tree->pager->getResidentBytes() > pagingBudget;
 		}
 	}
 
-	return loadCount > 0;
+	// painted strokes wait for the jobs to drain too, they can't start under a job
+	bool paused = evict || (!editing && brushWorker.hasPending());
+	remesher.submit(threadPool, paused ? 0.0f : settings->remeshBudget, settings->remeshInFlight, [this](OctreeNodeData &data, int layer) {
+		switch(layer) {
+			case REMESH_SOLID: return processSolid(data, &solidSpace);
+			case REMESH_BRUSH: return processBrush(data, &brushSpace);
+			default: return processLiquid(data, &liquidSpace);
+		}
+	});
+
+	solidSpace.journal->setBudget(((size_t) settings->journalBudget) << 20);
+
+	uint inFlight = remesher.getInFlight();
+	if(inFlight == 0 && !editing) {
+		for(Octree * tree : pagedSpaces) {
+			if(tree->pager != NULL) {
+				tree->pager->trim();
+			}
+		}
+		brushWorker.start();
+	}
+
+	return loadCount > 0 || inFlight > 0 || brushWorker.isBusy();
+}
+
+// Applies the painted strokes right away, for whatever needs the tree as the user sees it
+void Scene::flushBrushStrokes() {
+	remesher.wait();
+	brushWorker.wait();
+	brushWorker.publish(solidSpaceChangeHandler);
+	if(brushWorker.start()) {
+		brushWorker.wait();
+		brushWorker.publish(solidSpaceChangeHandler);
+	}
+}
+
+// The journal swaps nodes in and out of the tree, nothing can be reading it
+bool Scene::undo() {
+	flushBrushStrokes();
+	return solidSpace.journal->undo(solidSpaceChangeHandler);
+}
+
+bool Scene::redo() {
+	flushBrushStrokes();
+	return solidSpace.journal->redo(solidSpaceChangeHandler);
+}
+
+// Relocation changes the slots below the chunks, the jobs and strokes reading them go first
+void Scene::compact() {
+	flushBrushStrokes();
+	solidSpace.compact();
+	liquidSpace.compact();
+	brushSpace.compact();
 }
 
 void Scene::setVisibility(glm::mat4 viewProjection, std::vector<std::pair<glm::mat4, glm::vec3>> lightProjection ,Camera &camera) {
-	setVisibleNodes(&solidSpace, viewProjection, camera.position, solidRenderer);
+	// a finished edit shows up all at once, the lists are rebuilt on it right below.
+	// While one runs the solid lists keep the last published nodes, drawing only
+	// uses them as keys of the layers, which don't change until the publish
+	brushWorker.publish(solidSpaceChangeHandler);
+	bool editing = brushWorker.isEditing();
+	if(!editing) {
+		setVisibleNodes(&solidSpace, viewProjection, camera.position, solidRenderer);
+	}
 	setVisibleNodes(&liquidSpace, viewProjection, camera.position, liquidRenderer);
 	setVisibleNodes(&brushSpace, viewProjection, camera.position, brushRenderer);
 
 	int i =0;
 	for(std::pair<glm::mat4, glm::vec3> pair :  lightProjection){
-		setVisibleNodes(&solidSpace, pair.first, pair.second, shadowRenderer[i++]);
+		if(!editing) {
+			setVisibleNodes(&solidSpace, pair.first, pair.second, shadowRenderer[i]);
+		}
+		++i;
 	}
 }
 
@@ -379,7 +455,9 @@ void Scene::draw3dNodes(std::vector<std::pair<BoundingCube, OctreeNode*>> * list
 		glm::mat4 mat(1.0);
 		mat = glm::translate(mat, c.getMin());
 		mat = glm::scale(mat, c.getLength());
-		instances.push_back(DebugInstanceData(mat, n->sdf, 0));
+		float sdf[8];
+		n->getSDF(*solidSpace.allocator, sdf);
+		instances.push_back(DebugInstanceData(mat, sdf, 0));
 	}
 	long count = 0;
 	DrawableInstanceGeometry<DebugInstanceData> * drawable = new DrawableInstanceGeometry<DebugInstanceData>(geometry, &instances, &handler);
@@ -399,7 +477,7 @@ void Scene::draw3dNodes2(const OctreeVisibilityChecker * checker, Geometry * geo
 		glm::mat4 mat(1.0);
 		mat = glm::translate(mat, n.cube.getMin());
 		mat = glm::scale(mat, n.cube.getLength());
-		instances.push_back(DebugInstanceData(mat, n.node->sdf, n.node->vertex.brushIndex));
+		instances.push_back(DebugInstanceData(mat, n.sdf, n.node->getPayload(*solidSpace.allocator)->brushIndex));
 	}
 	long count = 0;
 	DrawableInstanceGeometry<DebugInstanceData> * drawable = new DrawableInstanceGeometry<DebugInstanceData>(geometry, &instances, &handler);
@@ -409,8 +487,22 @@ void Scene::draw3dNodes2(const OctreeVisibilityChecker * checker, Geometry * geo
 }
 
 
+// prints every 10% while the heightmap cache is filled
+static void printHeightMapProgress(int done, int total) {
+	if(done == total || (done * 10) / total != ((done - 1) * 10) / total) {
+		std::cout << "\t\tCachedHeightMapSurface " << (done * 100) / total << "%" << std::endl;
+	}
+}
+
 void Scene::generate(Camera &camera) {
 	std::cout << "Scene::generate() " << std::endl;
+	// remesh jobs and painted strokes use the trees we're about to change
+	flushBrushStrokes();
+	solidMeshes.clear();
+	// a generated world can't be undone, nor what came before it
+	OctreeJournal * journal = solidSpace.journal;
+	journal->clear(true);
+	solidSpace.journal = NULL;
 	double startTime = glfwGetTime(); // Get elapsed time in seconds
 	//WrappedSignedDistanceFunction::resetCalls();
 	int sizePerTile = 30;
@@ -425,45 +517,43 @@ void Scene::generate(Camera &camera) {
 	//camera.position.y = mapBox.getMaxY();
 	//camera.position.z = mapBox.getCenter().z;
 
-	{
-		Transformation model = Transformation();
-		std::cout << "\tGradientPerlinSurface"<< std::endl;
-		GradientPerlinSurface heightFunction = GradientPerlinSurface(height, 1.0/(256.0f*sizePerTile), -64);
-		std::cout << "\tCachedHeightMapSurface"<< std::endl;
-		CachedHeightMapSurface cache = CachedHeightMapSurface(heightFunction, mapBox, sizePerTile);
-		std::cout << "\tHeightMap"<< std::endl;
-		HeightMap heightMap = HeightMap(cache, mapBox, sizePerTile);
-		std::cout << "\tHeightMapDistanceFunction"<< std::endl;
-		HeightMapDistanceFunction function = HeightMapDistanceFunction(&heightMap);
-		std::cout << "\tWrappedHeightMap"<< std::endl;
-		WrappedHeightMap wrappedFunction = WrappedHeightMap(&function);
-		//wrappedFunction.cacheEnabled = true;
-		
-		std::cout << "\tsolidSpace.add(heightmap)"<< std::endl;
-		solidSpace.add(&wrappedFunction, model, translate, scale, LandBrush(), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
+	// the solid brushes go in one Octree::apply, everything they use has to outlive it
+	std::vector<ShapeOperation> solidOperations;
+	LandBrush landBrush;
+	SimpleBrush simpleBrush9(9), simpleBrush7(7), simpleBrush5(5), simpleBrush2(2), simpleBrush1(1);
 
+	std::cout << "\tGradientPerlinSurface"<< std::endl;
+	GradientPerlinSurface heightFunction = GradientPerlinSurface(height, 1.0/(256.0f*sizePerTile), -64);
+	std::cout << "\tCachedHeightMapSurface"<< std::endl;
+	CachedHeightMapSurface cache = CachedHeightMapSurface(heightFunction, mapBox, sizePerTile, &solidSpace.threadPool, printHeightMapProgress);
+	std::cout << "\tHeightMap"<< std::endl;
+	HeightMap heightMap = HeightMap(cache, mapBox, sizePerTile);
+	HeightMapDistanceFunction heightMapFunction = HeightMapDistanceFunction(&heightMap);
+	WrappedHeightMap wrappedHeightMap = WrappedHeightMap(&heightMapFunction);
+	//wrappedHeightMap.cacheEnabled = true;
+	std::cout << "\tsolidSpace.add(heightmap)"<< std::endl;
+	solidOperations.push_back({SDF::opUnion, &wrappedHeightMap, &landBrush, Transformation(), translate, scale, minSize});
+
+	BoxDistanceFunction boxFunction = BoxDistanceFunction();
+	WrappedBox wrappedBox = WrappedBox(&boxFunction);
 	{
 		std::cout << "\tsolidSpace.add(box)"<< std::endl;
 		glm::vec3 min = glm::vec3(1500,0,500);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingBox box = BoundingBox(min,min+len);
-		BoxDistanceFunction function = BoxDistanceFunction();
 		Transformation model = Transformation(box.getLength()*0.5f, box.getCenter(), 0, 0, 0);
-		WrappedBox wrappedFunction = WrappedBox(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(9), minSize*2.0f, *brushContext->simplifier, solidSpaceChangeHandler);
+		solidOperations.push_back({SDF::opUnion, &wrappedBox, &simpleBrush9, model, translate, scale, minSize*2.0f});
 	}
 
+	SphereDistanceFunction sphereFunction = SphereDistanceFunction();
+	WrappedSphere wrappedSphere = WrappedSphere(&sphereFunction);
 	{
 		std::cout << "\tsolidSpace.add(sphere)"<< std::endl;
 		glm::vec3 min = glm::vec3(1500,0,500);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingSphere sphere = BoundingSphere(min+3.0f*len/4.0f, 256);
-		SphereDistanceFunction function = SphereDistanceFunction();
 		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(7), minSize*0.5f, *brushContext->simplifier, solidSpaceChangeHandler);
+		solidOperations.push_back({SDF::opUnion, &wrappedSphere, &simpleBrush7, model, translate, scale, minSize*0.5f});
 	}
 
 	{
@@ -471,10 +561,8 @@ void Scene::generate(Camera &camera) {
 		glm::vec3 min = glm::vec3(1500,0,500);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingSphere sphere = BoundingSphere(min+len, 128);
-		SphereDistanceFunction function;
 		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		solidSpace.del(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize*0.25f, *brushContext->simplifier, solidSpaceChangeHandler);
+		solidOperations.push_back({SDF::opSubtraction, &wrappedSphere, &simpleBrush5, model, translate, scale, minSize*0.25f});
 	}
 
 	{
@@ -482,164 +570,71 @@ void Scene::generate(Camera &camera) {
 		glm::vec3 min = glm::vec3(1500,0,500);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingSphere sphere = BoundingSphere(min+3.0f*len/4.0f, 128);
-		SphereDistanceFunction function = SphereDistanceFunction();
 		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		solidSpace.del(&wrappedFunction, model, translate, scale, SimpleBrush(2), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-	
-	{
-		Transformation model = Transformation();
-		std::cout << "\tsolidSpace.del(capsule)"<< std::endl;
-		glm::vec3 a = glm::vec3(0,0, -3000);
-		glm::vec3 b = glm::vec3(0,500,0);
-		float r = 256.0f;
-		CapsuleDistanceFunction function(a, b, r);
-		WrappedCapsule wrappedFunction = WrappedCapsule(&function);
-		WrappedPerlinDistortDistanceEffect distortedFunction = WrappedPerlinDistortDistanceEffect(&wrappedFunction, 64.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
-		solidSpace.del(&distortedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tliquidSpace.add(sphere)"<< std::endl;
-		glm::vec3 min = glm::vec3(1500,0,500);
-		glm::vec3 len = glm::vec3(512.0f);
-		BoundingSphere sphere = BoundingSphere(min+len, 64);
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		liquidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(1), minSize*0.1f, *brushContext->simplifier, liquidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tsolidSpace.add(octahedron)"<< std::endl;
-		glm::vec3 center = glm::vec3(0,512, 512*0);
-		float radius = 256.0f;
-		OctahedronDistanceFunction function = OctahedronDistanceFunction();
-		Transformation model = Transformation(glm::vec3(radius), center, 0, 0, 0);
-		WrappedOctahedron wrappedFunction = WrappedOctahedron(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tsolidSpace.add(pyramid)"<< std::endl;
-		glm::vec3 center = glm::vec3(0,512, 512*1);
-		float radius = 256.0f;
-		PyramidDistanceFunction function = PyramidDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedPyramid wrappedFunction = WrappedPyramid(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tsolidSpace.add(torus)"<< std::endl;
-		glm::vec3 center = glm::vec3(0,512, 512*2);
-		float radius = 256.0f;
-		TorusDistanceFunction function = TorusDistanceFunction(glm::vec2(0.5, 0.25));
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedTorus wrappedFunction = WrappedTorus(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-
-	{
-		std::cout << "\tsolidSpace.add(cone)"<< std::endl;
-		glm::vec3 center = glm::vec3(0,512, 512*3);
-		float radius = 256.0f;
-		ConeDistanceFunction function = ConeDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedCone wrappedFunction = WrappedCone(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tsolidSpace.add(cylinder)"<< std::endl;
-		glm::vec3 center = glm::vec3(0,512, 512*4);
-		float radius = 256.0f;
-		CylinderDistanceFunction function = CylinderDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedCylinder wrappedFunction = WrappedCylinder(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(5), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-
-	{
-		std::cout << "\tsolidSpace.add(perlinDistort)"<< std::endl;
-		glm::vec3 center = glm::vec3(512,512, 512*0);
-		float radius = 200.0f;
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		WrappedPerlinDistortDistanceEffect distortedFunction = WrappedPerlinDistortDistanceEffect(&wrappedFunction, 48.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
-		//distortedFunction.cacheEnabled = true;
-		solidSpace.add(&distortedFunction, model, translate, scale, SimpleBrush(5), minSize*0.25f, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-
-	{
-		std::cout << "\tsolidSpace.add(perlinCarve)"<< std::endl;
-		glm::vec3 center = glm::vec3(512,512, 512*1);
-		float radius = 200.0f;
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		WrappedPerlinCarveDistanceEffect carvedFunction = WrappedPerlinCarveDistanceEffect(&wrappedFunction, 64.0f, 0.1f/32.0f, 0.1f, glm::vec3(0), 0.0f, 1.0f);
-		//carvedFunction.cacheEnabled = true;
-		solidSpace.add(&carvedFunction, model, translate, scale, SimpleBrush(5), minSize*0.2f, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-	{
-		std::cout << "\tsolidSpace.add(sineDistort)"<< std::endl;
-		glm::vec3 center = glm::vec3(512,512, 512*2);
-		float radius = 200.0f;
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		WrappedSineDistortDistanceEffect carvedFunction = WrappedSineDistortDistanceEffect(&wrappedFunction, 32.0f, 0.1f/2.0f, glm::vec3(0));
-		//carvedFunction.cacheEnabled = true;
-		solidSpace.add(&carvedFunction, model, translate, scale, SimpleBrush(5), minSize*0.25f, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-	{
-		std::cout << "\tsolidSpace.add(voronoiDistort)"<< std::endl;
-		glm::vec3 center = glm::vec3(512,512, 512*3);
-		float radius = 200.0f;
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		WrappedVoronoiCarveDistanceEffect distortFunction = WrappedVoronoiCarveDistanceEffect(&wrappedFunction, 64.0f, 64.0f, glm::vec3(0), 0.0f, 1.0f);
-		solidSpace.add(&distortFunction, model, translate, scale, SimpleBrush(5), minSize*0.25f, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-	{
-		std::cout << "\tsolidSpace.add(voronoiDistort)"<< std::endl;
-		glm::vec3 center = glm::vec3(512,512, 512*4);
-		float radius = 200.0f;
-		SphereDistanceFunction function = SphereDistanceFunction();
-		Transformation model(glm::vec3(radius), center, 0,0,0);
-		WrappedSphere wrappedFunction = WrappedSphere(&function);
-		WrappedVoronoiCarveDistanceEffect distortFunction = WrappedVoronoiCarveDistanceEffect(&wrappedFunction, 64.0f, 64.0f, glm::vec3(0), 0.0f, -1.0f);
-		solidSpace.add(&distortFunction, model, translate, scale, SimpleBrush(5), minSize*0.25f, *brushContext->simplifier, solidSpaceChangeHandler);
-	}
-	{
-		Transformation model = Transformation();
-		std::cout << "\tliquidSpace.add(water)"<< std::endl;
-		BoundingBox waterBox = mapBox;
-		waterBox.setMax(mapBox.getMax() - glm::vec3(minSize*2.0f));
-		waterBox.setMin(mapBox.getMin() + glm::vec3(minSize*2.0f));
-		waterBox.setMaxY(0);
-		waterBox.setMinY(mapBox.getMinY()*0.5f);
-		OctreeDifferenceFunction function(&solidSpace, waterBox, minSize*2.0f);
-		WrappedOctreeDifference wrappedFunction = WrappedOctreeDifference(&function);
-		//wrappedFunction.cacheEnabled = true;
-		liquidSpace.add(&wrappedFunction, model, translate, scale, WaterBrush(1), minSize, *brushContext->simplifier, liquidSpaceChangeHandler);
-	}
+		solidOperations.push_back({SDF::opSubtraction, &wrappedSphere, &simpleBrush2, model, translate, scale, minSize});
+	}
+
+	std::cout << "\tsolidSpace.del(capsule)"<< std::endl;
+	CapsuleDistanceFunction capsuleFunction(glm::vec3(0,0, -3000), glm::vec3(0,500,0), 256.0f);
+	WrappedCapsule wrappedCapsule = WrappedCapsule(&capsuleFunction);
+	WrappedPerlinDistortDistanceEffect distortedCapsule = WrappedPerlinDistortDistanceEffect(&wrappedCapsule, 64.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
+	solidOperations.push_back({SDF::opSubtraction, &distortedCapsule, &simpleBrush5, Transformation(), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(octahedron)"<< std::endl;
+	OctahedronDistanceFunction octahedronFunction = OctahedronDistanceFunction();
+	WrappedOctahedron wrappedOctahedron = WrappedOctahedron(&octahedronFunction);
+	solidOperations.push_back({SDF::opUnion, &wrappedOctahedron, &simpleBrush5, Transformation(glm::vec3(256.0f), glm::vec3(0,512, 512*0), 0, 0, 0), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(pyramid)"<< std::endl;
+	PyramidDistanceFunction pyramidFunction = PyramidDistanceFunction();
+	WrappedPyramid wrappedPyramid = WrappedPyramid(&pyramidFunction);
+	solidOperations.push_back({SDF::opUnion, &wrappedPyramid, &simpleBrush5, Transformation(glm::vec3(256.0f), glm::vec3(0,512, 512*1), 0,0,0), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(torus)"<< std::endl;
+	TorusDistanceFunction torusFunction = TorusDistanceFunction(glm::vec2(0.5, 0.25));
+	WrappedTorus wrappedTorus = WrappedTorus(&torusFunction);
+	solidOperations.push_back({SDF::opUnion, &wrappedTorus, &simpleBrush5, Transformation(glm::vec3(256.0f), glm::vec3(0,512, 512*2), 0,0,0), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(cone)"<< std::endl;
+	ConeDistanceFunction coneFunction = ConeDistanceFunction();
+	WrappedCone wrappedCone = WrappedCone(&coneFunction);
+	solidOperations.push_back({SDF::opUnion, &wrappedCone, &simpleBrush5, Transformation(glm::vec3(256.0f), glm::vec3(0,512, 512*3), 0,0,0), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(cylinder)"<< std::endl;
+	CylinderDistanceFunction cylinderFunction = CylinderDistanceFunction();
+	WrappedCylinder wrappedCylinder = WrappedCylinder(&cylinderFunction);
+	solidOperations.push_back({SDF::opUnion, &wrappedCylinder, &simpleBrush5, Transformation(glm::vec3(256.0f), glm::vec3(0,512, 512*4), 0,0,0), translate, scale, minSize});
+
+	std::cout << "\tsolidSpace.add(perlinDistort)"<< std::endl;
+	WrappedPerlinDistortDistanceEffect perlinDistort = WrappedPerlinDistortDistanceEffect(&wrappedSphere, 48.0f, 0.1f/32.0f, glm::vec3(0), 0.0f, 1.0f);
+	//perlinDistort.cacheEnabled = true;
+	solidOperations.push_back({SDF::opUnion, &perlinDistort, &simpleBrush5, Transformation(glm::vec3(200.0f), glm::vec3(512,512, 512*0), 0,0,0), translate, scale, minSize*0.25f});
+
+	std::cout << "\tsolidSpace.add(perlinCarve)"<< std::endl;
+	WrappedPerlinCarveDistanceEffect perlinCarve = WrappedPerlinCarveDistanceEffect(&wrappedSphere, 64.0f, 0.1f/32.0f, 0.1f, glm::vec3(0), 0.0f, 1.0f);
+	//perlinCarve.cacheEnabled = true;
+	solidOperations.push_back({SDF::opUnion, &perlinCarve, &simpleBrush5, Transformation(glm::vec3(200.0f), glm::vec3(512,512, 512*1), 0,0,0), translate, scale, minSize*0.2f});
+
+	std::cout << "\tsolidSpace.add(sineDistort)"<< std::endl;
+	WrappedSineDistortDistanceEffect sineDistort = WrappedSineDistortDistanceEffect(&wrappedSphere, 32.0f, 0.1f/2.0f, glm::vec3(0));
+	//sineDistort.cacheEnabled = true;
+	solidOperations.push_back({SDF::opUnion, &sineDistort, &simpleBrush5, Transformation(glm::vec3(200.0f), glm::vec3(512,512, 512*2), 0,0,0), translate, scale, minSize*0.25f});
+
+	std::cout << "\tsolidSpace.add(voronoiDistort)"<< std::endl;
+	WrappedVoronoiCarveDistanceEffect voronoiCarve = WrappedVoronoiCarveDistanceEffect(&wrappedSphere, 64.0f, 64.0f, glm::vec3(0), 0.0f, 1.0f);
+	solidOperations.push_back({SDF::opUnion, &voronoiCarve, &simpleBrush5, Transformation(glm::vec3(200.0f), glm::vec3(512,512, 512*3), 0,0,0), translate, scale, minSize*0.25f});
+
+	std::cout << "\tsolidSpace.add(voronoiDistort)"<< std::endl;
+	WrappedVoronoiCarveDistanceEffect voronoiInverse = WrappedVoronoiCarveDistanceEffect(&wrappedSphere, 64.0f, 64.0f, glm::vec3(0), 0.0f, -1.0f);
+	solidOperations.push_back({SDF::opUnion, &voronoiInverse, &simpleBrush5, Transformation(glm::vec3(200.0f), glm::vec3(512,512, 512*4), 0,0,0), translate, scale, minSize*0.25f});
 
 	{
 		std::cout << "\tsolidSpace.add(box)"<< std::endl;
 		glm::vec3 min = glm::vec3(1500,0,-1000);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingBox box = BoundingBox(min,min+len);
-		BoxDistanceFunction function = BoxDistanceFunction();
 		Transformation model = Transformation(box.getLength()*0.5f, box.getCenter(), 0, 0, 0);
-		WrappedBox wrappedFunction = WrappedBox(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(9), minSize*4, *brushContext->simplifier, solidSpaceChangeHandler);
+		solidOperations.push_back({SDF::opUnion, &wrappedBox, &simpleBrush9, model, translate, scale, minSize*4});
 	}
 
 	{
@@ -647,21 +642,52 @@ void Scene::generate(Camera &camera) {
 		glm::vec3 min = glm::vec3(2500,0,-1000);
 		glm::vec3 len = glm::vec3(512.0f);
 		BoundingBox box = BoundingBox(min,min+len);
-		BoxDistanceFunction function = BoxDistanceFunction();
 		Transformation model = Transformation(box.getLength()*0.5f, box.getCenter(), 0, 0, 0);
-		WrappedBox wrappedFunction = WrappedBox(&function);
-		solidSpace.add(&wrappedFunction, model, translate, scale, SimpleBrush(9), minSize*0.25, *brushContext->simplifier, solidSpaceChangeHandler);
+		solidOperations.push_back({SDF::opUnion, &wrappedBox, &simpleBrush9, model, translate, scale, minSize*0.25f});
+	}
+
+	solidSpace.apply(solidOperations, *brushContext->simplifier, solidSpaceChangeHandler);
+
+	// water needs the final solid space
+	std::vector<ShapeOperation> liquidOperations;
+	{
+		std::cout << "\tliquidSpace.add(sphere)"<< std::endl;
+		glm::vec3 min = glm::vec3(1500,0,500);
+		glm::vec3 len = glm::vec3(512.0f);
+		BoundingSphere sphere = BoundingSphere(min+len, 64);
+		Transformation model = Transformation(glm::vec3(sphere.radius), sphere.center, 0, 0, 0);
+		liquidOperations.push_back({SDF::opUnion, &wrappedSphere, &simpleBrush1, model, translate, scale, minSize*0.1f});
 	}
 
+	std::cout << "\tliquidSpace.add(water)"<< std::endl;
+	BoundingBox waterBox = mapBox;
+	waterBox.setMax(mapBox.getMax() - glm::vec3(minSize*2.0f));
+	waterBox.setMin(mapBox.getMin() + glm::vec3(minSize*2.0f));
+	waterBox.setMaxY(0);
+	waterBox.setMinY(mapBox.getMinY()*0.5f);
+	// sampled at the leaf size of the water, its corners fall on the grid
+	OctreeDifferenceFunction waterFunction(&solidSpace, waterBox, minSize*2.0f, minSize);
+	WrappedOctreeDifference wrappedWater = WrappedOctreeDifference(&waterFunction);
+	//wrappedWater.cacheEnabled = true;
+	WaterBrush waterBrush(1);
+	liquidOperations.push_back({SDF::opUnion, &wrappedWater, &waterBrush, Transformation(), translate, scale, minSize});
+
+	liquidSpace.apply(liquidOperations, *brushContext->simplifier, liquidSpaceChangeHandler);
+
 	double endTime = glfwGetTime(); // Get elapsed time in seconds
 	//std::cout << "Scene::callsToSDF " << std::to_string(WrappedSignedDistanceFunction::_calls)   << std::endl;
 
 	std::cout << "Scene::generate Ok! " << std::to_string(endTime-startTime) << "s"  << std::endl;
 	brushContext->model.scale = glm::vec3(256.0f);
+	solidSpace.journal = journal;
 }
 
 
 void Scene::import(const std::string &filename, Camera &camera) {
+	flushBrushStrokes();
+	OctreeJournal * journal = solidSpace.journal;
+	journal->clear(true);
+	solidSpace.journal = NULL;
 	int sizePerTile = 30;
 	int tiles= 1024;
 	int height = 2048;
@@ -675,35 +701,79 @@ void Scene::import(const std::string &filename, Camera &camera) {
 	camera.position.y = mapBox.getMaxY();
 	camera.position.z = mapBox.getCenter().z;
 
-	HeightMapTif heightFunction = HeightMapTif(filename, mapBox, sizePerTile,1.0f, -320.0f);
-    CachedHeightMapSurface cache = CachedHeightMapSurface(heightFunction, mapBox, sizePerTile);
-	HeightMap heightMap = HeightMap(cache, mapBox, sizePerTile);
+	// streamed straight into the octree, only the tiles being shaped are kept in memory.
+	// Heights are interpolated bilinearly between samples sizePerTile apart, like the cached surface
+	HeightMapTif heightFunction = HeightMapTif(filename, mapBox, sizePerTile,1.0f, -320.0f, 256u << 20);
+	HeightMap heightMap = HeightMap(heightFunction, mapBox, sizePerTile);
 	HeightMapDistanceFunction function = HeightMapDistanceFunction(&heightMap);
 	WrappedHeightMap wrappedFunction = WrappedHeightMap(&function);
 	solidSpace.add(&wrappedFunction, model, translate, scale, DerivativeLandBrush(), minSize, *brushContext->simplifier, solidSpaceChangeHandler);
+	std::cout << "\tHeightMapTif tile reads " << heightFunction.getTileReads() << std::endl;
 
 	BoundingBox waterBox = mapBox;
 	waterBox.setMaxY(0);
 
 	brushContext->model.scale = glm::vec3(256.0f);	
+	solidSpace.journal = journal;
+}
+
+// paged trees have part of their chunks on disk only, those go through the chunk files.
+// The other format may be left from an earlier save, loadOctree() takes the newest
+static void saveOctree(Octree * tree, std::string name, std::string folderPath) {
+	if(tree->pager != NULL) {
+		OctreeFile saver(tree, name);
+		saver.save(folderPath, tree->chunkSize);
+	} else {
+		OctreeImage saver(tree, name);
+		saver.save(folderPath, false);
+	}
 }
 
 void Scene::save(std::string folderPath, Camera &camera) {
-	OctreeFile saver1(&solidSpace, "solid");
-	OctreeFile saver2(&liquidSpace, "liquid");
+	flushBrushStrokes();
 	SettingsFile settingsFile(settings, "settings");
 	settingsFile.save(folderPath);
-	saver1.save(folderPath, 4096);
-	saver2.save(folderPath, 4096);
+	saveOctree(&solidSpace, "solid", folderPath);
+	saveOctree(&liquidSpace, "liquid", folderPath);
+}
+
+// whichever of the image and the chunk files was saved last, not whichever the current
+// paging budget would write. With a paging budget the chunks stay on disk until needed
+static void loadOctree(Octree * tree, std::string name, std::string folderPath, uint pagingBudget) {
+	if(tree->pager != NULL) {
+		delete tree->pager;
+		tree->pager = NULL;
+	}
+	OctreeImage image(tree, name);
+	std::string indexPath = folderPath + "/" + name + ".bin";
+	bool hasIndex = std::filesystem::exists(indexPath);
+	bool useImage = image.exists(folderPath);
+	if(useImage && hasIndex) {
+		// an unreadable time loses against the other file
+		std::error_code imageError, indexError;
+		auto imageTime = std::filesystem::last_write_time(image.getPath(folderPath), imageError);
+		auto indexTime = std::filesystem::last_write_time(indexPath, indexError);
+		useImage = indexError || (!imageError && imageTime >= indexTime);
+	}
+	if(useImage && image.load(folderPath)) {
+		return;
+	}
+	if(pagingBudget > 0 && hasIndex) {
+		tree->pager = new OctreePager(tree, folderPath, name, ((size_t) pagingBudget) << 20);
+	}
+	OctreeFile loader(tree, name);
+	loader.load(folderPath, 4096);
 }
 
 void Scene::load(std::string folderPath, Camera &camera) {
-	OctreeFile loader1(&solidSpace, "solid");
-	OctreeFile loader2(&liquidSpace, "liquid");
+	flushBrushStrokes();
 	SettingsFile settingsFile(settings, "settings");
 	settingsFile.load(folderPath);
-	loader1.load(folderPath, 4096);
-	loader2.load(folderPath, 4096);
+	// the loaders replace the nodes the history points to, and the meshes kept per chunk
+	solidSpace.journal->clear(true);
+	solidMeshes.clear();
+	loadOctree(&solidSpace, "solid", folderPath, settings->pagingBudget);
+	loadOctree(&liquidSpace, "liquid", folderPath, settings->pagingBudget);
 	//camera.position.x = loader1.getBox().getCenter().x;
 	//camera.position.y = loader1.getBox().getMaxY();
 	//camera.position.z = loader1.getBox().getCenter().z;
@@ -2,10 +2,12 @@
 
 SolidSpaceChangeHandler::SolidSpaceChangeHandler(
     OctreeLayer<InstanceData> * vegetationInfo,
-    OctreeLayer<DebugInstanceData> * octreeWireframeInfo
+    OctreeLayer<DebugInstanceData> * octreeWireframeInfo,
+    ChunkMeshLayer * solidMeshes
 ) {
     this->vegetationInfo = vegetationInfo;
     this->octreeWireframeInfo = octreeWireframeInfo;
+    this->solidMeshes = solidMeshes;
 };
 
 void SolidSpaceChangeHandler::create(OctreeNode* node) {
@@ -26,3 +28,7 @@ void SolidSpaceChangeHandler::erase(OctreeNode* node) {
         #endif
     }
 };
+
+void SolidSpaceChangeHandler::dirty(const BoundingCube &chunk, const BoundingCube &region) {
+    solidMeshes->markDirty(chunk, region);
+};
@@ -40,10 +40,17 @@ glm::vec3 randomPointInTriangle(const glm::vec3& A, const glm::vec3& B, const gl
 }
 
 
-VegetationInstanceBuilder::VegetationInstanceBuilder(Octree * tree, long * count,std::vector<InstanceData> * instances, float pointsPerArea, float scale) : OctreeNodeTriangleHandler(count){
+VegetationInstanceBuilder::VegetationInstanceBuilder(Octree * tree, long * count,std::vector<InstanceData> * instances, float pointsPerArea, float scale, ChunkMesh * mesh) : OctreeNodeTriangleHandler(count){
     this->instances = instances;
     this->pointsPerArea = pointsPerArea;
     this->scale = scale;
+    this->mesh = mesh;
+}
+
+void VegetationInstanceBuilder::beginCell(const BoundingCube &cube) {
+    if(mesh != NULL) {
+        instances = mesh->getInstances(mesh->getBlockIndex(cube.getCenter()));
+    }
 }
 
 void VegetationInstanceBuilder::handle(Vertex &v0, Vertex &v1, Vertex &v2, bool sign){    
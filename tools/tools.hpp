@@ -13,6 +13,9 @@
 #include <algorithm>
 #include <random>
 #include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <condition_variable>
 
 
 enum Tab {
@@ -112,10 +115,12 @@ class VegetationInstanceBuilder : public OctreeNodeTriangleHandler {
 	std::vector<InstanceData> * instances;
     float pointsPerArea;
 	float scale;
+	ChunkMesh * mesh;
 	
 	using OctreeNodeTriangleHandler::OctreeNodeTriangleHandler;
-	VegetationInstanceBuilder(Octree * tree, long * count,std::vector<InstanceData> * instances, float pointsPerArea, float scale);
+	VegetationInstanceBuilder(Octree * tree, long * count,std::vector<InstanceData> * instances, float pointsPerArea, float scale, ChunkMesh * mesh = NULL);
 	void handle(Vertex &v0, Vertex &v1, Vertex &v2, bool signn) override;
+	void beginCell(const BoundingCube &cube) override;
 };
 
 
@@ -195,16 +200,19 @@ class LiquidSpaceChangeHandler : public OctreeChangeHandler {
 class SolidSpaceChangeHandler : public OctreeChangeHandler {
 	OctreeLayer<InstanceData> * vegetationInfo;
     OctreeLayer<DebugInstanceData> * octreeWireframeInfo;
+	ChunkMeshLayer * solidMeshes;
 
 	public:
 	SolidSpaceChangeHandler(
 		OctreeLayer<InstanceData> * vegetationInfo,
-	    OctreeLayer<DebugInstanceData> * octreeWireframeInfo
+	    OctreeLayer<DebugInstanceData> * octreeWireframeInfo,
+		ChunkMeshLayer * solidMeshes
 	);
 
 	void create(OctreeNode* nodeId) override;
 	void update(OctreeNode* nodeId) override;
 	void erase(OctreeNode* nodeId) override;
+	void dirty(const BoundingCube &chunk, const BoundingCube &region) override;
 };
 
 class BrushSpaceChangeHandler : public OctreeChangeHandler {
@@ -219,6 +227,19 @@ class BrushSpaceChangeHandler : public OctreeChangeHandler {
 	void erase(OctreeNode* nodeId) override;
 };
 
+// One paint of the brush, keeps a copy of what the controls move while it waits for the worker
+struct BrushStroke {
+	WrappedSignedDistanceFunction * function;
+	Transformation model;
+	glm::vec4 translate;
+	glm::vec4 scale;
+	float detail;
+	int brushIndex;
+	BrushMode mode;
+
+	bool operator==(const BrushStroke &other) const;
+};
+
 class BrushContext {
 	public:
 	BrushMode mode;
@@ -239,9 +260,102 @@ class BrushContext {
 
 	BrushContext(Settings * settings, Camera * camera);
 	void apply(Octree &space, OctreeChangeHandler * handler, bool preview);
+	BrushStroke getStroke();
 };
 
+// Records the changes of an edit running beside the renderer, they are
+// replayed in order on the main thread when the edit gets published
+class DeferredChangeHandler : public OctreeChangeHandler {
+	struct Change {
+		int type;
+		OctreeNode * node;
+		BoundingCube chunk;
+		BoundingCube region;
+	};
+	std::vector<Change> changes;
+	std::mutex mutex;
+
+	public:
+	void create(OctreeNode* nodeId) override;
+	void update(OctreeNode* nodeId) override;
+	void erase(OctreeNode* nodeId) override;
+	void dirty(const BoundingCube &chunk, const BoundingCube &region) override;
+	size_t replay(OctreeChangeHandler * handler);
+};
 
+// Applies painted strokes to a tree on its own thread. Nothing of the edit is seen
+// by the renderer until publish(), which the main thread calls between frames.
+// The main thread only starts a job once no remesh job reads the tree.
+class BrushWorker {
+	Octree * tree;
+	Simplifier * simplifier;
+	DeferredChangeHandler changes;
+	std::vector<BrushStroke> pending; // main thread only
+	std::vector<BrushStroke> job;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool running;
+	bool finished; // applied but not published
+	bool stop;
+
+	void run();
+	void apply(const std::vector<BrushStroke> &strokes);
+
+	public:
+	BrushWorker(Octree * tree, Simplifier * simplifier);
+	~BrushWorker();
+
+	void push(const BrushStroke &stroke);
+	bool hasPending();
+	bool start();
+	bool publish(OctreeChangeHandler * handler);
+	bool isEditing();
+	bool isBusy();
+	void wait();
+};
+
+
+
+#define REMESH_SOLID 0
+#define REMESH_LIQUID 1
+#define REMESH_BRUSH 2
+#define REMESH_LAYERS 3
+
+struct RemeshJob {
+	OctreeNodeData data; // a copy, the visible lists are rebuilt every frame
+	int layer;
+	float priority;
+};
+
+struct RemeshResult {
+	OctreeNode * node;
+	int layer;
+	bool loaded;
+	float millis;
+};
+
+// Hands dirty visible nodes to the thread pool without waiting for them.
+// Bigger and closer nodes go first, a node is never queued twice and
+// finished jobs are collected by the render thread with drain().
+class RemeshScheduler {
+	std::vector<RemeshJob> candidates;
+	std::unordered_set<OctreeNode*> queued[REMESH_LAYERS];
+	std::vector<RemeshResult> completed;
+	float averageMillis[REMESH_LAYERS];
+	uint inFlight;
+	std::mutex mutex;
+	std::condition_variable idle;
+
+	public:
+	RemeshScheduler();
+	void offer(const OctreeNodeData &data, int layer, const glm::vec3 &camera);
+	int drain();
+	void submit(ThreadPool &threadPool, float budgetMillis, uint maxInFlight, std::function<bool(OctreeNodeData&, int)> process);
+	void wait();
+	uint getInFlight();
+};
 
 class Scene {
     public: 
@@ -270,6 +384,9 @@ class Scene {
 	OctreeLayer<InstanceData> solidInfo;
 	OctreeLayer<DebugInstanceData> octreeWireframeInfo;
 	OctreeLayer<InstanceData> vegetationInfo;
+	ChunkMeshLayer solidMeshes;
+	RemeshScheduler remesher;
+	BrushWorker brushWorker;
 
 	LiquidSpaceChangeHandler * liquidSpaceChangeHandler;
 	SolidSpaceChangeHandler * solidSpaceChangeHandler;
@@ -283,11 +400,15 @@ class Scene {
 	Settings * settings;
 	BrushContext * brushContext;
 	Vegetation3d * vegetationGeometry;
-	ThreadPool threadPool = ThreadPool(std::thread::hardware_concurrency());
+	ThreadPool &threadPool = ThreadPool::shared();
 
 	Scene(Settings * settings, BrushContext * brushContext);
 
 	bool processSpace();
+	void flushBrushStrokes();
+	bool undo();
+	bool redo();
+	void compact();
 	bool processLiquid(OctreeNodeData &data, Octree * tree);
 	bool processSolid(OctreeNodeData &data, Octree * tree);
 	bool processBrush(OctreeNodeData &data, Octree * tree);
@@ -376,8 +497,10 @@ class OctreeDifferenceFunction : public SignedDistanceFunction {
     Octree * tree;
     BoundingBox box;
 	float bias;
-    OctreeDifferenceFunction(Octree * tree, BoundingBox box, float bias);
+	OctreeSdfGrid grid;
+    OctreeDifferenceFunction(Octree * tree, BoundingBox box, float bias, float step);
     float distance(const glm::vec3 &p, const Transformation &model) override;
+    glm::vec2 getDistanceRange(const BoundingCube &cube, const Transformation &model) override;
 	SdfType getType() const override;
 	glm::vec3 getCenter(const Transformation &model) const override;
 
@@ -66,6 +66,12 @@ void BrushEditor::draw2d(float time){
         }
     }
 
+    // the worker reads the shape and the effect while strokes are applied
+    bool locked = scene->brushWorker.isBusy();
+    if(locked) {
+        ImGui::BeginDisabled();
+    }
+
     ImGui::Text("Shape: ");
 
     if (ImGui::BeginCombo("##selectedFunction", brushContext->currentFunction->getLabel())) {
@@ -295,6 +301,10 @@ void BrushEditor::draw2d(float time){
     }
 
 
+    if(locked) {
+        ImGui::EndDisabled();
+    }
+
     ImGui::Separator();
 
     if(changed) {
@@ -8,10 +8,12 @@ void OctreeExplorer::recursiveDraw(OctreeNode * node, BoundingCube cube, uint le
     std::string blockId ="blockId = " + std::to_string(node->id);
     ImGui::Text(blockId.c_str());
     openNodes.push_back({cube, node});
+    OctreeNodePayload * payload = node->getPayload(*tree->allocator);
+    float nodeSDF[8];
+    payload->getSDF(nodeSDF);
 
     {
         SpaceType type = node->getType();
-        glm::vec3 rgb = Math::brushColor(node->vertex.brushIndex);
         ImVec4 color(type == SpaceType::Solid ? 1.0 : 0.5, type == SpaceType::Empty ? 1.0 : 0.5, node->isChunk() ? 1.0 : 0.5, 1.0f);
         std::string flags ="";
         flags += node->isDirty() ? "*":"_"; 
@@ -30,7 +32,7 @@ void OctreeExplorer::recursiveDraw(OctreeNode * node, BoundingCube cube, uint le
             if(i>0) {
                 sdf += ", ";
             }
-            float s = node->sdf[i];
+            float s = nodeSDF[i];
             sdf += s == INFINITY ? "inf" : std::to_string(s);
         }
         sdf += "]";
@@ -38,10 +40,10 @@ void OctreeExplorer::recursiveDraw(OctreeNode * node, BoundingCube cube, uint le
         ImGui::Text(text.c_str());
     }
     {
-        glm::vec3 rgb = Math::brushColor(node->vertex.brushIndex);
+        glm::vec3 rgb = Math::brushColor(payload->brushIndex);
         ImVec4 color(rgb.r, rgb.g, rgb.b, 1.0f);
         ImGui::PushStyleColor(ImGuiCol_Text, color); // Red text
-        std::string text ="brush = " + std::to_string(node->vertex.brushIndex);
+        std::string text ="brush = " + std::to_string(payload->brushIndex);
         ImGui::Text(text.c_str());
         ImGui::PopStyleColor();
     }
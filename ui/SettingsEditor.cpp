@@ -16,6 +16,8 @@ void SettingsEditor::draw2d(float time){
     unsigned int min_value = 0;
     unsigned int max_range = 4096;
     unsigned int max_override = 32;
+    unsigned int max_budget = 65536;
+    unsigned int max_in_flight = 256;
     int int_value = 0;
 
 
@@ -103,6 +105,21 @@ void SettingsEditor::draw2d(float time){
     #endif
     ImGui::DragFloat("Safety Detail Ratio", &settings->safetyDetailRatio, 0.000001f, 0.0f, 1.0f, "%.6f");
 
+    int_value = static_cast<int>(settings->pagingBudget);
+    if(ImGui::DragScalar("Paging budget (MB)", ImGuiDataType_U32, &int_value, 16.0f, &min_value, &max_budget,"%u")) {
+        settings->pagingBudget = static_cast<unsigned int>(int_value);
+    }
+
+    ImGui::DragFloat("Remesh budget (ms)", &settings->remeshBudget, 0.1f, 0.1f, 100.0f, "%.1f");
+    int_value = static_cast<int>(settings->remeshInFlight);
+    if(ImGui::DragScalar("Remesh jobs in flight", ImGuiDataType_U32, &int_value, 1.0f, &min_value, &max_in_flight,"%u")) {
+        settings->remeshInFlight = static_cast<unsigned int>(int_value);
+    }
+    int_value = static_cast<int>(settings->journalBudget);
+    if(ImGui::DragScalar("Undo budget (MB)", ImGuiDataType_U32, &int_value, 16.0f, &min_value, &max_budget,"%u")) {
+        settings->journalBudget = static_cast<unsigned int>(int_value);
+    }
+
 
     ImGui::Checkbox("Show brush volume", &settings->showBrushVolume);
 